@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+/*
+ * Microbenchmark of the FirstOrderBuildingsAwarePropagationLossModel.
+ *
+ * For each layout and number of buildings, the benchmark places the buildings, draws links of
+ * at most 100 m between points of the streets, and times:
+ * - GetLoss on the LOS links and on the NLOS links, without noise and with the default caches,
+ * - the toolbox calls GetBuildingsBetween, GetCorner and Getreflectionpoint on the same links,
+ * - the reflection search and the noise draw, from the latency statistics of the model
+ *   (see LossStatistics), which include the cost of reading the clock.
+ *
+ * Each benchmark runs once to warm up, then --repetitions times; the ns/call of the repetitions
+ * are summarized by their minimum, median, mean and standard deviation. The results are printed
+ * as CSV, and written to --csv and --json when given, to compare builds.
+ *
+ *     ./ns3 run "foba-bench --buildings=16,64,256 --layouts=grid,random --json=bench.json"
+ */
+
+#include "ns3/building-list.h"
+#include "ns3/building.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/core-module.h"
+#include "ns3/first-order-buildings-aware-propagation-loss-model.h"
+#include "ns3/foba-city-snapshot.h"
+#include "ns3/foba-loss-stats.h"
+#include "ns3/foba-toolbox.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("FobaBench");
+
+/// Summary of the repetitions of a benchmark
+struct BenchResult
+{
+    std::string layout;    ///< layout of the buildings
+    uint32_t buildings;    ///< number of buildings
+    std::string benchmark; ///< timed call
+    uint64_t calls;        ///< calls per repetition
+    double minNs;          ///< fastest repetition (ns/call)
+    double medianNs;       ///< median repetition (ns/call)
+    double meanNs;         ///< mean of the repetitions (ns/call)
+    double stddevNs;       ///< standard deviation of the repetitions (ns/call)
+};
+
+/**
+ * Split a comma separated list
+ *
+ * @param list the list
+ * @return the items of the list
+ */
+std::vector<std::string>
+SplitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+/**
+ * Place the buildings of a layout, one building per 50 m block of a square city
+ *
+ * @param layout "grid" for 30 m buildings in the middle of their block, "random" for buildings of
+ * random size and position within their block
+ * @param count the number of buildings
+ * @param rng the random generator
+ * @return the edge length of the city (in m)
+ */
+double
+PlaceBuildings(const std::string& layout, uint32_t count, std::mt19937& rng)
+{
+    const double block = 50.0;
+    const uint32_t side = std::ceil(std::sqrt(static_cast<double>(count)));
+    std::uniform_real_distribution<double> size(10.0, 40.0);
+    std::uniform_real_distribution<double> height(6.0, 30.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        double x = (k % side) * block;
+        double y = (k / side) * block;
+        Box box(x + 10.0, x + 40.0, y + 10.0, y + 40.0, 0.0, 12.0);
+        if (layout == "random")
+        {
+            double dx = size(rng);
+            double dy = size(rng);
+            double ox = x + 5.0 + unit(rng) * (block - 10.0 - dx);
+            double oy = y + 5.0 + unit(rng) * (block - 10.0 - dy);
+            box = Box(ox, ox + dx, oy, oy + dy, 0.0, height(rng));
+        }
+        else
+        {
+            NS_ABORT_MSG_UNLESS(layout == "grid", "Unknown layout " << layout);
+        }
+        Ptr<Building> building = CreateObject<Building>();
+        building->SetBoundaries(box);
+    }
+    return side * block;
+}
+
+/**
+ * Summarize the ns/call of the repetitions of a benchmark
+ *
+ * @param samples the ns/call of each repetition, not empty
+ * @param result given the minimum, median, mean and standard deviation of the samples
+ */
+void
+Summarize(std::vector<double> samples, BenchResult& result)
+{
+    std::sort(samples.begin(), samples.end());
+    result.minNs = samples.front();
+    result.medianNs = samples[samples.size() / 2];
+    double sum = 0.0;
+    for (double sample : samples)
+    {
+        sum += sample;
+    }
+    result.meanNs = sum / samples.size();
+    double squares = 0.0;
+    for (double sample : samples)
+    {
+        squares += (sample - result.meanNs) * (sample - result.meanNs);
+    }
+    result.stddevNs = std::sqrt(squares / samples.size());
+}
+
+/**
+ * Time the repetitions of a benchmark
+ *
+ * @param repetitions the number of timed repetitions, after one warm up run
+ * @param calls the number of calls of a repetition
+ * @param run runs the calls of a repetition
+ * @param result given the summary of the repetitions
+ */
+void
+TimeBenchmark(uint32_t repetitions,
+              uint64_t calls,
+              const std::function<void()>& run,
+              BenchResult& result)
+{
+    std::vector<double> samples;
+    run();
+    for (uint32_t r = 0; r < repetitions; ++r)
+    {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto stop = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count() /
+                          std::max<uint64_t>(calls, 1));
+    }
+    result.calls = calls;
+    Summarize(samples, result);
+}
+
+/**
+ * Write the results as CSV
+ *
+ * @param os the output stream
+ * @param results the results
+ */
+void
+WriteCsv(std::ostream& os, const std::vector<BenchResult>& results)
+{
+    os << "layout,buildings,benchmark,calls,min_ns,median_ns,mean_ns,stddev_ns\n";
+    for (const auto& r : results)
+    {
+        os << r.layout << "," << r.buildings << "," << r.benchmark << "," << r.calls << ","
+           << r.minNs << "," << r.medianNs << "," << r.meanNs << "," << r.stddevNs << "\n";
+    }
+}
+
+/**
+ * Write the results as JSON
+ *
+ * @param os the output stream
+ * @param results the results
+ * @param repetitions the number of repetitions of each benchmark
+ * @param seed the seed of the layouts and links
+ */
+void
+WriteJson(std::ostream& os,
+          const std::vector<BenchResult>& results,
+          uint32_t repetitions,
+          uint32_t seed)
+{
+    os << "{\n  \"repetitions\": " << repetitions << ",\n  \"seed\": " << seed
+       << ",\n  \"results\": [\n";
+    for (size_t k = 0; k < results.size(); ++k)
+    {
+        const auto& r = results[k];
+        os << "    {\"layout\": \"" << r.layout << "\", \"buildings\": " << r.buildings
+           << ", \"benchmark\": \"" << r.benchmark << "\", \"calls\": " << r.calls
+           << ", \"min_ns\": " << r.minNs << ", \"median_ns\": " << r.medianNs
+           << ", \"mean_ns\": " << r.meanNs << ", \"stddev_ns\": " << r.stddevNs << "}"
+           << ((k + 1 < results.size()) ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::string buildingCounts = "16,64,256";
+    std::string layouts = "grid,random";
+    uint32_t links = 2000;
+    uint32_t repetitions = 5;
+    uint32_t seed = 1;
+    std::string csvPath;
+    std::string jsonPath;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("buildings", "Comma separated numbers of buildings", buildingCounts);
+    cmd.AddValue("layouts", "Comma separated layouts of the buildings (grid, random)", layouts);
+    cmd.AddValue("links", "Number of LOS and of NLOS links of each scenario", links);
+    cmd.AddValue("repetitions", "Number of timed repetitions of each benchmark", repetitions);
+    cmd.AddValue("seed", "Seed of the layouts and links", seed);
+    cmd.AddValue("csv", "CSV file of the results, empty for none", csvPath);
+    cmd.AddValue("json", "JSON file of the results, empty for none", jsonPath);
+    cmd.Parse(argc, argv);
+    NS_ABORT_MSG_UNLESS(repetitions > 0, "At least one repetition");
+
+    std::vector<BenchResult> results;
+    double checksum = 0.0;
+    for (const auto& layout : SplitList(layouts))
+    {
+        for (const auto& countItem : SplitList(buildingCounts))
+        {
+            const uint32_t count = std::stoul(countItem);
+            std::mt19937 rng(seed);
+            double extent = PlaceBuildings(layout, count, rng);
+
+            Ptr<CitySnapshot> city = CreateObject<CitySnapshot>();
+            city->Update();
+            std::vector<uint32_t> slots(city->GetNBuildings());
+            for (uint32_t slot = 0; slot < slots.size(); ++slot)
+            {
+                slots[slot] = slot;
+            }
+
+            // Links of at most 100 m between points of the streets
+            std::uniform_real_distribution<double> coordinate(-20.0, extent + 20.0);
+            std::uniform_real_distribution<double> offset(-70.0, 70.0);
+            auto inStreet = [&city](const Vector& p) {
+                for (uint32_t slot = 0; slot < city->GetNBuildings(); ++slot)
+                {
+                    if (city->GetBounds(slot).IsInside(p))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            std::vector<std::pair<Vector, Vector>> losLinks;
+            std::vector<std::pair<Vector, Vector>> nlosLinks;
+            for (uint32_t attempt = 0;
+                 (attempt < 100 * links) && (losLinks.size() < links || nlosLinks.size() < links);
+                 ++attempt)
+            {
+                Vector tx(coordinate(rng), coordinate(rng), 1.5);
+                Vector rx(tx.x + offset(rng), tx.y + offset(rng), 1.5);
+                if (CalculateDistance(tx, rx) > 100.0 || !inStreet(tx) || !inStreet(rx))
+                {
+                    continue;
+                }
+                auto& kind = city->GetIntersected(rx, tx).empty() ? losLinks : nlosLinks;
+                if (kind.size() < links)
+                {
+                    kind.emplace_back(rx, tx);
+                }
+            }
+
+            auto mobility = [](const Vector& position) {
+                Ptr<MobilityModel> mob = CreateObject<ConstantPositionMobilityModel>();
+                mob->SetPosition(position);
+                return mob;
+            };
+            std::vector<std::pair<Ptr<MobilityModel>, Ptr<MobilityModel>>> losMobs;
+            std::vector<std::pair<Ptr<MobilityModel>, Ptr<MobilityModel>>> nlosMobs;
+            for (const auto& [rx, tx] : losLinks)
+            {
+                losMobs.emplace_back(mobility(rx), mobility(tx));
+            }
+            for (const auto& [rx, tx] : nlosLinks)
+            {
+                nlosMobs.emplace_back(mobility(rx), mobility(tx));
+            }
+
+            Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+                CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+            model->SetAttribute("NoiseEnabled", BooleanValue(false));
+            Ptr<NLOSassess> assess = CreateObject<NLOSassess>();
+
+            auto bench = [&](const std::string& name,
+                             uint64_t calls,
+                             const std::function<void()>& run) {
+                BenchResult result{layout, count, name, 0, 0.0, 0.0, 0.0, 0.0};
+                TimeBenchmark(repetitions, calls, run, result);
+                results.push_back(result);
+            };
+            bench("GetLoss_LOS", losMobs.size(), [&]() {
+                for (const auto& [rx, tx] : losMobs)
+                {
+                    checksum += model->GetLoss(rx, tx);
+                }
+            });
+            bench("GetLoss_NLOS", nlosMobs.size(), [&]() {
+                for (const auto& [rx, tx] : nlosMobs)
+                {
+                    checksum += model->GetLoss(rx, tx);
+                }
+            });
+            bench("GetBuildingsBetween", nlosLinks.size(), [&]() {
+                for (const auto& [rx, tx] : nlosLinks)
+                {
+                    checksum += assess->GetBuildingsBetween(rx, tx, *city, slots).size();
+                }
+            });
+
+            // The corners of the buildings crossed by the NLOS links
+            std::vector<std::pair<uint32_t, uint32_t>> crossed;
+            for (uint32_t k = 0; k < nlosLinks.size(); ++k)
+            {
+                for (uint32_t slot : city->GetIntersected(nlosLinks[k].first, nlosLinks[k].second))
+                {
+                    crossed.emplace_back(k, slot);
+                }
+            }
+            bench("GetCorner", crossed.size(), [&]() {
+                for (const auto& [k, slot] : crossed)
+                {
+                    NLOSassess::Endpoint rx{nlosLinks[k].first};
+                    NLOSassess::Endpoint tx{nlosLinks[k].second};
+                    checksum += assess->GetCorner(*city, slot, rx, tx).size();
+                }
+            });
+            bench("Getreflectionpoint", nlosLinks.size(), [&]() {
+                for (uint32_t k = 0; k < nlosLinks.size(); ++k)
+                {
+                    NLOSassess::Endpoint rx{nlosLinks[k].first};
+                    NLOSassess::Endpoint tx{nlosLinks[k].second};
+                    auto point = assess->Getreflectionpoint(*city, k % slots.size(), rx, tx);
+                    checksum += point ? point->x : 0.0;
+                }
+            });
+
+            // The reflection search and the noise draw are private, they are timed by the model
+            Ptr<FirstOrderBuildingsAwarePropagationLossModel> timed =
+                CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+            timed->SetAttribute("StatsEnabled", BooleanValue(true));
+            Ptr<LossStatistics> stats = timed->GetStatistics();
+            for (auto phase : {LossStatistics::REFLECTION_PHASE, LossStatistics::NOISE_PHASE})
+            {
+                std::vector<double> samples;
+                uint64_t calls = 0;
+                for (uint32_t r = 0; r <= repetitions; ++r)
+                {
+                    stats->Reset();
+                    for (const auto& [rx, tx] : nlosMobs)
+                    {
+                        checksum += timed->GetLoss(rx, tx);
+                    }
+                    calls = stats->GetPhaseCount(phase);
+                    if (r > 0)
+                    {
+                        samples.push_back(static_cast<double>(stats->GetPhaseTotal(phase)) /
+                                          std::max<uint64_t>(calls, 1));
+                    }
+                }
+                BenchResult result{layout, count, "", calls, 0.0, 0.0, 0.0, 0.0};
+                result.benchmark =
+                    (phase == LossStatistics::REFLECTION_PHASE) ? "ReflectionLoss" : "Noise";
+                Summarize(samples, result);
+                results.push_back(result);
+            }
+
+            NS_LOG_INFO(layout << " " << count << " buildings: " << losLinks.size() << " LOS and "
+                               << nlosLinks.size() << " NLOS links");
+            Simulator::Destroy();
+        }
+    }
+
+    WriteCsv(std::cout, results);
+    // Keeps the timed calls from being optimized out
+    std::cerr << "checksum " << checksum << std::endl;
+    if (!csvPath.empty())
+    {
+        std::ofstream csv(csvPath);
+        WriteCsv(csv, results);
+    }
+    if (!jsonPath.empty())
+    {
+        std::ofstream json(jsonPath);
+        WriteJson(json, results, repetitions, seed);
+    }
+    return 0;
+}
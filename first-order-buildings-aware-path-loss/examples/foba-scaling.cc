@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+/*
+ * Scaling benchmark of the FirstOrderBuildingsAwarePropagationLossModel on synthetic cities.
+ *
+ * For each number of buildings, a city is generated by FobaScenarioHelper with the chosen layout;
+ * for each number of nodes, nodes are placed in its streets and the losses of their links are
+ * timed with each propagation loss model. All the n * (n - 1) links are timed when there are at
+ * most --links of them, else --links links drawn at random.
+ *
+ * The output has the columns of time_perf.ods, one row per number of nodes and of buildings. A
+ * cell is the time of a whole run (in s), one loss for each of the n * (n - 1) links: the median
+ * over --repetitions runs of the mean time of a loss, after a warm up run filling the caches of
+ * the models, times the number of links. Unlike the runs of time_perf.ods, it only counts the
+ * losses, not the rest of the simulation:
+ * - FOBA (ITUR1411 only): ItuR1411LosPropagationLossModel;
+ * - FOBA (ITUR1411+noise): the model with noise, timed once the buildings are cleared, so that it
+ *   only computes the ITU-R 1411 loss and the noise;
+ * - FOBA (ITUR1411+NLOS): n/a, the model cannot evaluate the NLOS paths without the LOS
+ *   diffraction;
+ * - FOBA (ITUR1411+NLOS+LOSdiff): the model without noise;
+ * - Friis: FriisPropagationLossModel.
+ *
+ *     ./ns3 run "foba-scaling --layout=canyon --buildings=100,1000,10000 --nodes=100,1000"
+ *
+ * The zone cache of the model keeps one byte per node and building, so it is left disabled unless
+ * --zoneCache=1 is given.
+ */
+
+#include "ns3/building-list.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/core-module.h"
+#include "ns3/first-order-buildings-aware-propagation-loss-model.h"
+#include "ns3/foba-scenario-helper.h"
+#include "ns3/itu-r-1411-los-propagation-loss-model.h"
+#include "ns3/propagation-loss-model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("FobaScaling");
+
+/**
+ * Parse a comma separated list of numbers
+ *
+ * @param list the list
+ * @return the numbers of the list
+ */
+std::vector<uint32_t>
+ParseCounts(const std::string& list)
+{
+    std::vector<uint32_t> counts;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            counts.push_back(std::stoul(item));
+        }
+    }
+    return counts;
+}
+
+/**
+ * Time the losses of links with a model
+ *
+ * @param model the propagation loss model
+ * @param links the links, as (receiver, source)
+ * @param repetitions the number of timed runs, after one warm up run
+ * @param checksum given the sum of the received powers
+ * @return the median of the mean time of a loss (in us)
+ */
+double
+TimeLinks(Ptr<PropagationLossModel> model,
+          const std::vector<std::pair<Ptr<MobilityModel>, Ptr<MobilityModel>>>& links,
+          uint32_t repetitions,
+          double& checksum)
+{
+    std::vector<double> samples;
+    for (uint32_t r = 0; r <= repetitions; ++r)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& [rx, tx] : links)
+        {
+            checksum += model->CalcRxPower(0.0, tx, rx);
+        }
+        auto stop = std::chrono::steady_clock::now();
+        if (r > 0)
+        {
+            samples.push_back(std::chrono::duration<double, std::micro>(stop - start).count() /
+                              std::max<size_t>(links.size(), 1));
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+/**
+ * Timings of the links of a number of nodes, the noise one being done once the buildings are
+ * cleared
+ */
+struct Row
+{
+    uint32_t nodes;                                                       ///< Number of nodes
+    std::vector<std::pair<Ptr<MobilityModel>, Ptr<MobilityModel>>> links; ///< Timed links
+    double itu;   ///< Time of a ItuR1411LosPropagationLossModel loss (in us)
+    double foba;  ///< Time of a loss of the model without noise (in us)
+    double friis; ///< Time of a FriisPropagationLossModel loss (in us)
+};
+
+int
+main(int argc, char* argv[])
+{
+    std::string layoutName = "manhattan";
+    std::string buildingCounts = "1,10,100,1000,10000";
+    std::string nodeCounts = "10,100,1000";
+    uint32_t maxLinks = 10000;
+    uint32_t repetitions = 3;
+    uint32_t seed = 1;
+    double frequency = 2160e6;
+    bool zoneCache = false;
+    std::string csvPath;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("layout", "Layout of the buildings (manhattan, random, mixed-height, canyon)",
+                 layoutName);
+    cmd.AddValue("buildings", "Comma separated numbers of buildings", buildingCounts);
+    cmd.AddValue("nodes", "Comma separated numbers of nodes", nodeCounts);
+    cmd.AddValue("links", "Maximum number of links timed for each row", maxLinks);
+    cmd.AddValue("repetitions", "Number of timed runs of each cell", repetitions);
+    cmd.AddValue("seed", "Seed of the buildings, nodes and links", seed);
+    cmd.AddValue("frequency", "Frequency of the models (in Hz)", frequency);
+    cmd.AddValue("zoneCache", "Enable the zone cache of the model", zoneCache);
+    cmd.AddValue("csv", "CSV file of the results, empty for none", csvPath);
+    cmd.Parse(argc, argv);
+    NS_ABORT_MSG_UNLESS(repetitions > 0, "At least one repetition");
+
+    FobaScenarioHelper scenario;
+    if (layoutName == "manhattan")
+    {
+        scenario.SetLayout(FobaScenarioHelper::MANHATTAN);
+    }
+    else if (layoutName == "random")
+    {
+        scenario.SetLayout(FobaScenarioHelper::RANDOM_FOOTPRINT);
+    }
+    else if (layoutName == "mixed-height")
+    {
+        scenario.SetLayout(FobaScenarioHelper::MIXED_HEIGHT);
+    }
+    else if (layoutName == "canyon")
+    {
+        scenario.SetLayout(FobaScenarioHelper::STREET_CANYON);
+    }
+    else
+    {
+        NS_ABORT_MSG("Unknown layout " << layoutName);
+    }
+    scenario.SetSeed(seed);
+
+    std::ostringstream table;
+    table << "Nodes,Buildings,FOBA (ITUR1411 only),FOBA (ITUR1411+noise),FOBA (ITUR1411+NLOS),"
+          << "FOBA (ITUR1411+NLOS+LOSdiff),Friis\n";
+    double checksum = 0.0;
+    for (uint32_t buildings : ParseCounts(buildingCounts))
+    {
+        std::vector<Row> rows;
+        scenario.CreateBuildings(buildings);
+        for (uint32_t nodes : ParseCounts(nodeCounts))
+        {
+            std::vector<Ptr<MobilityModel>> mobilities;
+            for (const auto& position : scenario.GetNodePositions(nodes))
+            {
+                Ptr<MobilityModel> mobility = CreateObject<ConstantPositionMobilityModel>();
+                mobility->SetPosition(position);
+                mobilities.push_back(mobility);
+            }
+
+            std::vector<std::pair<Ptr<MobilityModel>, Ptr<MobilityModel>>> links;
+            if (static_cast<uint64_t>(nodes) * (nodes - 1) <= maxLinks)
+            {
+                for (uint32_t i = 0; i < nodes; ++i)
+                {
+                    for (uint32_t j = 0; j < nodes; ++j)
+                    {
+                        if (i != j)
+                        {
+                            links.emplace_back(mobilities[i], mobilities[j]);
+                        }
+                    }
+                }
+            }
+            else
+            {
+                std::mt19937 generator(seed);
+                std::uniform_int_distribution<uint32_t> node(0, nodes - 1);
+                while (links.size() < maxLinks)
+                {
+                    uint32_t i = node(generator);
+                    uint32_t j = node(generator);
+                    if (i != j)
+                    {
+                        links.emplace_back(mobilities[i], mobilities[j]);
+                    }
+                }
+            }
+
+            Ptr<ItuR1411LosPropagationLossModel> itu =
+                CreateObject<ItuR1411LosPropagationLossModel>();
+            itu->SetAttribute("Frequency", DoubleValue(frequency));
+            Ptr<FirstOrderBuildingsAwarePropagationLossModel> foba =
+                CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+            foba->SetAttribute("Frequency", DoubleValue(frequency));
+            foba->SetAttribute("NoiseEnabled", BooleanValue(false));
+            foba->SetAttribute("ZoneCache", BooleanValue(zoneCache));
+            Ptr<FriisPropagationLossModel> friis = CreateObject<FriisPropagationLossModel>();
+            friis->SetAttribute("Frequency", DoubleValue(frequency));
+
+            Row row{nodes, std::move(links), 0.0, 0.0, 0.0};
+            row.itu = TimeLinks(itu, row.links, repetitions, checksum);
+            row.foba = TimeLinks(foba, row.links, repetitions, checksum);
+            row.friis = TimeLinks(friis, row.links, repetitions, checksum);
+            NS_LOG_INFO(buildings << " buildings, " << nodes << " nodes: " << row.links.size()
+                                  << " links timed");
+            rows.push_back(std::move(row));
+        }
+        // Clears the BuildingList before the noise timings and the next city
+        Simulator::Destroy();
+
+        // Without buildings the model only adds the noise to the ITU-R 1411 loss
+        for (const auto& row : rows)
+        {
+            Ptr<FirstOrderBuildingsAwarePropagationLossModel> noisy =
+                CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+            noisy->SetAttribute("Frequency", DoubleValue(frequency));
+            noisy->SetAttribute("NoiseEnabled", BooleanValue(true));
+            // Time of a run over all the links, from the time of a loss (in us)
+            const double run = static_cast<double>(row.nodes) * (row.nodes - 1) * 1e-6;
+            table << row.nodes << "," << buildings << "," << row.itu * run << ","
+                  << TimeLinks(noisy, row.links, repetitions, checksum) * run << ",n/a,"
+                  << row.foba * run << "," << row.friis * run << "\n";
+        }
+        Simulator::Destroy();
+    }
+
+    std::cout << table.str();
+    // Keeps the timed losses from being optimized out
+    std::cerr << "checksum " << checksum << std::endl;
+    if (!csvPath.empty())
+    {
+        std::ofstream csv(csvPath);
+        csv << table.str();
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-loss-matrix-helper.h"
+
+#include "ns3/foba-loss-file.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("FobaLossMatrixHelper");
+
+FobaLossMatrixHelper::FobaLossMatrixHelper()
+    : m_threadCount(std::max(1U, std::thread::hardware_concurrency())),
+      m_tileSize(32)
+{
+}
+
+void
+FobaLossMatrixHelper::SetThreadCount(uint32_t count)
+{
+    NS_LOG_FUNCTION(this << count);
+    NS_ASSERT_MSG(count > 0, "At least the calling thread computes the matrix");
+    m_threadCount = count;
+}
+
+void
+FobaLossMatrixHelper::SetTileSize(uint32_t size)
+{
+    NS_LOG_FUNCTION(this << size);
+    NS_ASSERT_MSG(size > 0, "Empty tiles");
+    m_tileSize = size;
+}
+
+std::vector<Ptr<MobilityModel>>
+FobaLossMatrixHelper::GetMobilityModels(NodeContainer nodes)
+{
+    std::vector<Ptr<MobilityModel>> models;
+    models.reserve(nodes.GetN());
+    for (auto it = nodes.Begin(); it != nodes.End(); ++it)
+    {
+        Ptr<MobilityModel> mobility = (*it)->GetObject<MobilityModel>();
+        NS_ABORT_MSG_UNLESS(mobility, "Node " << (*it)->GetId() << " has no MobilityModel");
+        models.push_back(mobility);
+    }
+    return models;
+}
+
+std::vector<double>
+FobaLossMatrixHelper::Compute(Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                              NodeContainer nodes) const
+{
+    NS_LOG_FUNCTION(this << model << nodes.GetN());
+    return Compute(model, GetMobilityModels(nodes));
+}
+
+std::vector<double>
+FobaLossMatrixHelper::Compute(Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                              const std::vector<Ptr<MobilityModel>>& mobility) const
+{
+    std::vector<double> losses(mobility.size() * mobility.size());
+
+    // The threads of the model are only borrowed for the matrix
+    uint32_t threadCount = model->GetThreadCount();
+    model->SetThreadCount(m_threadCount);
+    model->GetDeterministicLossMatrix(mobility, losses, m_tileSize);
+    model->SetThreadCount(threadCount);
+    return losses;
+}
+
+void
+FobaLossMatrixHelper::Install(Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                              NodeContainer nodes) const
+{
+    NS_LOG_FUNCTION(this << model << nodes.GetN());
+    std::vector<Ptr<MobilityModel>> mobility = GetMobilityModels(nodes);
+    std::vector<double> losses = Compute(model, mobility);
+
+    // Both directions of a link share an entry of the cache
+    const uint64_t n = mobility.size();
+    const uint64_t links = n * (n - 1) / 2;
+    model->SetLinkCacheEnabled(true);
+    if (model->GetLinkCacheMaxEntries() < links)
+    {
+        model->SetLinkCacheMaxEntries(
+            std::min<uint64_t>(links, std::numeric_limits<uint32_t>::max()));
+    }
+    Ptr<LinkLossCache> cache = model->GetLinkCache();
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        for (uint64_t j = 0; j < n; ++j)
+        {
+            if (i != j)
+            {
+                cache->Insert(mobility[i], mobility[j], losses[i * n + j]);
+            }
+        }
+    }
+}
+
+Ptr<MatrixPropagationLossModel>
+FobaLossMatrixHelper::CreateMatrixModel(Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                                        NodeContainer nodes) const
+{
+    NS_LOG_FUNCTION(this << model << nodes.GetN());
+    std::vector<Ptr<MobilityModel>> mobility = GetMobilityModels(nodes);
+    std::vector<double> losses = Compute(model, mobility);
+
+    Ptr<MatrixPropagationLossModel> matrix = CreateObject<MatrixPropagationLossModel>();
+    const uint64_t n = mobility.size();
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        for (uint64_t j = 0; j < n; ++j)
+        {
+            if (i != j)
+            {
+                // Both models give the loss of (a, b) to CalcRxPower(txPowerDbm, a, b)
+                matrix->SetLoss(mobility[i], mobility[j], losses[i * n + j], false);
+            }
+        }
+    }
+    return matrix;
+}
+
+void
+FobaLossMatrixHelper::WriteFile(const std::string& path,
+                                Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                                NodeContainer nodes) const
+{
+    NS_LOG_FUNCTION(this << path << model << nodes.GetN());
+    std::vector<double> losses = Compute(model, GetMobilityModels(nodes));
+    LossMatrixFile::Write(path,
+                          nodes,
+                          losses,
+                          model->GetFrequency(),
+                          model->GetGain(),
+                          model->GetDiffractionMode());
+}
+
+} // namespace ns3
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_LOSS_MATRIX_HELPER_H
+#define FOBA_LOSS_MATRIX_HELPER_H
+
+#include "ns3/first-order-buildings-aware-propagation-loss-model.h"
+#include "ns3/matrix-propagation-loss-model.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/ptr.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Precompute the losses between all the pairs of a static set of nodes
+ *
+ * The n * (n - 1) losses are computed once, by tiles of sources and destinations spread over a
+ * pool of threads, instead of on the first use of each link. They can then be served by the link
+ * cache of the model (Install), which keeps the noise and drops the links of the nodes that
+ * move, by a MatrixPropagationLossModel (CreateMatrixModel), which does not depend on the model
+ * nor on the buildings anymore, or by a loss file for the next runs (WriteFile).
+ *
+ * The nodes must have a MobilityModel aggregated.
+ */
+class FobaLossMatrixHelper
+{
+  public:
+    FobaLossMatrixHelper();
+
+    /**
+     * @brief Set the number of threads computing the matrix
+     * @param count the number of threads, the calling thread included (default: the number of
+     * hardware threads)
+     */
+    void SetThreadCount(uint32_t count);
+
+    /**
+     * @brief Set the size of the tiles of the matrix computed by a thread at once
+     * @param size the number of sources and of destinations of a tile (default 32)
+     */
+    void SetTileSize(uint32_t size);
+
+    /**
+     * @brief Compute the losses without the noise between all the pairs of nodes
+     *
+     * @param model the model computing the losses
+     * @param nodes the nodes
+     * @return GetDeterministicLoss(mobility of node i, mobility of node j) (in dB) at
+     * i * nodes.GetN() + j, 0 for i = j
+     */
+    std::vector<double> Compute(Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                                NodeContainer nodes) const;
+
+    /**
+     * @brief Compute the losses between all the pairs of nodes, and store them in the link cache
+     * of the model
+     *
+     * The link cache of the model is enabled, and grown to hold all the pairs if needed. The
+     * noise is still drawn on each call to the model.
+     *
+     * @param model the model computing then serving the losses
+     * @param nodes the nodes
+     */
+    void Install(Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                 NodeContainer nodes) const;
+
+    /**
+     * @brief Compute the losses between all the pairs of nodes, and export them
+     *
+     * The losses do not include the noise. The pairs with another node keep the default loss of
+     * the MatrixPropagationLossModel.
+     *
+     * @param model the model computing the losses
+     * @param nodes the nodes
+     * @return a model holding the loss of each ordered pair of nodes
+     */
+    Ptr<MatrixPropagationLossModel> CreateMatrixModel(
+        Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+        NodeContainer nodes) const;
+
+    /**
+     * @brief Compute the losses between all the pairs of nodes, and write them to a loss file
+     *
+     * The file can be served by the LossFile attribute of the models of the next runs of the
+     * same scenario (see LossMatrixFile).
+     *
+     * @param path the file to write
+     * @param model the model computing the losses
+     * @param nodes the nodes
+     */
+    void WriteFile(const std::string& path,
+                   Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                   NodeContainer nodes) const;
+
+  private:
+    /**
+     * @brief Get the mobility models of the nodes
+     * @param nodes the nodes
+     * @return the mobility model of each node
+     */
+    static std::vector<Ptr<MobilityModel>> GetMobilityModels(NodeContainer nodes);
+
+    /**
+     * @brief Compute the losses without the noise between all the pairs of nodes
+     * @param model the model computing the losses
+     * @param mobility the mobility models of the nodes
+     * @return the losses, ordered as by Compute(model, nodes)
+     */
+    std::vector<double> Compute(Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                                const std::vector<Ptr<MobilityModel>>& mobility) const;
+
+    uint32_t m_threadCount; ///< Threads computing the matrix
+    uint32_t m_tileSize;    ///< Sources and destinations of a tile
+};
+
+} // namespace ns3
+
+#endif /* FOBA_LOSS_MATRIX_HELPER_H */
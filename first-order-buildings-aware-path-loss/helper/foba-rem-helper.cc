@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-rem-helper.h"
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("FobaRemHelper");
+
+/// Magic string at the start of the binary maps
+static const char REM_FILE_MAGIC[8] = {'F', 'O', 'B', 'A', 'R', 'E', 'M', '\0'};
+/// Version of the binary map format
+static const uint32_t REM_FILE_VERSION = 1;
+
+/**
+ * @brief Start of the binary maps
+ */
+struct RemFileHeader
+{
+    char magic[8];     ///< "FOBAREM"
+    uint32_t version;  ///< format version
+    uint32_t nx;       ///< number of points along x
+    uint32_t ny;       ///< number of points along y
+    uint32_t reserved; ///< padding, 0
+    double xMin;       ///< x of the first point of the rows (in m)
+    double yMin;       ///< y of the first row (in m)
+    double resolution; ///< distance between two points (in m)
+    double z;          ///< height of the points (in m)
+};
+
+FobaRemHelper::FobaRemHelper()
+    : m_xMin(0.0),
+      m_xMax(100.0),
+      m_yMin(0.0),
+      m_yMax(100.0),
+      m_resolution(1.0),
+      m_z(1.5),
+      m_threadCount(std::max(1U, std::thread::hardware_concurrency())),
+      m_tileSize(64),
+      m_format(CSV)
+{
+}
+
+void
+FobaRemHelper::SetArea(double xMin, double xMax, double yMin, double yMax)
+{
+    NS_LOG_FUNCTION(this << xMin << xMax << yMin << yMax);
+    NS_ASSERT_MSG((xMin <= xMax) && (yMin <= yMax), "Empty area");
+    m_xMin = xMin;
+    m_xMax = xMax;
+    m_yMin = yMin;
+    m_yMax = yMax;
+}
+
+void
+FobaRemHelper::SetResolution(double resolution)
+{
+    NS_LOG_FUNCTION(this << resolution);
+    NS_ASSERT_MSG(resolution > 0, "The points must be apart");
+    m_resolution = resolution;
+}
+
+void
+FobaRemHelper::SetHeight(double z)
+{
+    NS_LOG_FUNCTION(this << z);
+    m_z = z;
+}
+
+void
+FobaRemHelper::SetThreadCount(uint32_t count)
+{
+    NS_LOG_FUNCTION(this << count);
+    NS_ASSERT_MSG(count > 0, "At least the calling thread computes the map");
+    m_threadCount = count;
+}
+
+void
+FobaRemHelper::SetTileSize(uint32_t size)
+{
+    NS_LOG_FUNCTION(this << size);
+    NS_ASSERT_MSG(size > 0, "Empty tiles");
+    m_tileSize = size;
+}
+
+void
+FobaRemHelper::SetOutputFormat(OutputFormat format)
+{
+    NS_LOG_FUNCTION(this << format);
+    m_format = format;
+}
+
+void
+FobaRemHelper::Generate(Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                        Ptr<MobilityModel> tx,
+                        const std::string& path) const
+{
+    NS_LOG_FUNCTION(this << model << tx << path);
+    // The bounds are kept when they are a multiple of the resolution away, despite the rounding
+    const uint32_t nx = std::floor((m_xMax - m_xMin) / m_resolution + 1e-9) + 1;
+    const uint32_t ny = std::floor((m_yMax - m_yMin) / m_resolution + 1e-9) + 1;
+    const uint32_t tiles = (nx + m_tileSize - 1) / m_tileSize;
+
+    std::ios::openmode mode = std::ios::out | std::ios::trunc;
+    if (m_format == BINARY)
+    {
+        mode |= std::ios::binary;
+    }
+    std::ofstream file(path, mode);
+    NS_ABORT_MSG_UNLESS(file, "Cannot write the map " << path);
+    if (m_format == BINARY)
+    {
+        RemFileHeader header;
+        std::memcpy(header.magic, REM_FILE_MAGIC, sizeof(header.magic));
+        header.version = REM_FILE_VERSION;
+        header.nx = nx;
+        header.ny = ny;
+        header.reserved = 0;
+        header.xMin = m_xMin;
+        header.yMin = m_yMin;
+        header.resolution = m_resolution;
+        header.z = m_z;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    else
+    {
+        file << "x,y,loss\n";
+    }
+
+    // The threads of the model are only borrowed for the map
+    uint32_t threadCount = model->GetThreadCount();
+    model->SetThreadCount(m_threadCount);
+
+    std::vector<Vector> positions;
+    std::vector<double> losses;
+    std::vector<float> row(nx);
+    for (uint32_t bandStart = 0; bandStart < ny; bandStart += m_tileSize)
+    {
+        const uint32_t rows = std::min(m_tileSize, ny - bandStart);
+        NS_LOG_INFO("Rows " << bandStart << " to " << bandStart + rows - 1 << " of " << ny);
+
+        // Points ordered tile by tile, so a thread computes whole tiles
+        positions.clear();
+        for (uint32_t tile = 0; tile < tiles; ++tile)
+        {
+            const uint32_t columnStart = tile * m_tileSize;
+            const uint32_t columnEnd = std::min(columnStart + m_tileSize, nx);
+            for (uint32_t j = bandStart; j < bandStart + rows; ++j)
+            {
+                for (uint32_t i = columnStart; i < columnEnd; ++i)
+                {
+                    positions.emplace_back(m_xMin + i * m_resolution,
+                                           m_yMin + j * m_resolution,
+                                           m_z);
+                }
+            }
+        }
+        losses.resize(positions.size());
+        model->GetDeterministicLossBatch(tx, positions, losses);
+
+        for (uint32_t r = 0; r < rows; ++r)
+        {
+            for (uint32_t i = 0; i < nx; ++i)
+            {
+                const uint32_t tile = i / m_tileSize;
+                const uint32_t width = std::min(m_tileSize, nx - tile * m_tileSize);
+                double loss =
+                    losses[tile * m_tileSize * rows + r * width + (i - tile * m_tileSize)];
+                if (m_format == BINARY)
+                {
+                    row[i] = loss;
+                }
+                else
+                {
+                    file << m_xMin + i * m_resolution << ','
+                         << m_yMin + (bandStart + r) * m_resolution << ',' << loss << '\n';
+                }
+            }
+            if (m_format == BINARY)
+            {
+                file.write(reinterpret_cast<const char*>(row.data()), nx * sizeof(float));
+            }
+        }
+    }
+
+    model->SetThreadCount(threadCount);
+    NS_ABORT_MSG_UNLESS(file, "Cannot write the map " << path);
+}
+
+} // namespace ns3
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_REM_HELPER_H
+#define FOBA_REM_HELPER_H
+
+#include "ns3/first-order-buildings-aware-propagation-loss-model.h"
+#include "ns3/mobility-model.h"
+#include "ns3/ptr.h"
+
+#include <cstdint>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * @brief Generate the radio environment map (REM) of a source: the loss without noise from the
+ * source to each point of a horizontal grid, written to a raster file.
+ *
+ * The grid is computed by bands of rows, each band being split in square tiles computed on a pool
+ * of threads with the batch path of the model (see
+ * FirstOrderBuildingsAwarePropagationLossModel::GetDeterministicLossBatch). A band is written as
+ * soon as it is computed, so only one band is held in memory.
+ *
+ * The raster is written as:
+ * - CSV: a "x,y,loss" header line, then one line per point;
+ * - BINARY: a header (magic "FOBAREM", format version, number of points along x and y, lowest x
+ *   and y, resolution and height, in the byte order of the machine), then the losses (in dB) as
+ *   float, by rows of increasing y, each row by increasing x.
+ */
+class FobaRemHelper
+{
+  public:
+    /**
+     * @brief Format of the raster file
+     */
+    enum OutputFormat
+    {
+        CSV,   ///< text, one line per point
+        BINARY ///< header then float losses
+    };
+
+    FobaRemHelper();
+
+    /**
+     * @brief Set the area covered by the map
+     * @param xMin lowest x of the points (in m)
+     * @param xMax highest x of the points (in m)
+     * @param yMin lowest y of the points (in m)
+     * @param yMax highest y of the points (in m)
+     */
+    void SetArea(double xMin, double xMax, double yMin, double yMax);
+
+    /**
+     * @brief Set the distance between two neighbouring points of the map
+     * @param resolution the distance (in m, default 1)
+     */
+    void SetResolution(double resolution);
+
+    /**
+     * @brief Set the height of the points of the map
+     * @param z the height (in m, default 1.5)
+     */
+    void SetHeight(double z);
+
+    /**
+     * @brief Set the number of threads computing the map
+     * @param count the number of threads, the calling thread included (default: the number of
+     * hardware threads)
+     */
+    void SetThreadCount(uint32_t count);
+
+    /**
+     * @brief Set the size of the tiles of the map, and of the bands of rows held in memory
+     * @param size the number of points along an edge of a tile (default 64)
+     */
+    void SetTileSize(uint32_t size);
+
+    /**
+     * @brief Set the format of the raster file
+     * @param format the format (default CSV)
+     */
+    void SetOutputFormat(OutputFormat format);
+
+    /**
+     * @brief Compute the map of a source and write it
+     *
+     * @param model the model computing the losses
+     * @param tx the mobility model of the source
+     * @param path the raster file to write
+     */
+    void Generate(Ptr<FirstOrderBuildingsAwarePropagationLossModel> model,
+                  Ptr<MobilityModel> tx,
+                  const std::string& path) const;
+
+  private:
+    double m_xMin;          ///< Lowest x of the points (in m)
+    double m_xMax;          ///< Highest x of the points (in m)
+    double m_yMin;          ///< Lowest y of the points (in m)
+    double m_yMax;          ///< Highest y of the points (in m)
+    double m_resolution;    ///< Distance between two points (in m)
+    double m_z;             ///< Height of the points (in m)
+    uint32_t m_threadCount; ///< Threads computing the map
+    uint32_t m_tileSize;    ///< Points along an edge of a tile
+    OutputFormat m_format;  ///< Format of the raster file
+};
+
+} // namespace ns3
+
+#endif /* FOBA_REM_HELPER_H */
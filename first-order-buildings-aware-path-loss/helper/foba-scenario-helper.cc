@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-scenario-helper.h"
+
+#include "ns3/assert.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("FobaScenarioHelper");
+
+/// Random stream of the buildings
+static const uint32_t BUILDINGS_STREAM = 0;
+/// Random stream of the nodes
+static const uint32_t NODES_STREAM = 1;
+/// Smallest edge of a RANDOM_FOOTPRINT building, relatively to the block size
+static const double MIN_FOOTPRINT = 0.4;
+
+/**
+ * @brief Create the generator of a random stream of a scenario
+ * @param seed the seed of the scenario
+ * @param stream the stream
+ * @return the generator
+ */
+static std::mt19937
+MakeGenerator(uint32_t seed, uint32_t stream)
+{
+    std::seed_seq sequence{seed, stream};
+    return std::mt19937(sequence);
+}
+
+FobaScenarioHelper::FobaScenarioHelper()
+    : m_layout(MANHATTAN),
+      m_seed(1),
+      m_blockSize(50.0),
+      m_streetWidth(20.0),
+      m_passageWidth(2.0),
+      m_buildingHeight(15.0),
+      m_minHeight(6.0),
+      m_maxHeight(60.0),
+      m_nodeHeight(1.5),
+      m_columns(0),
+      m_rows(0),
+      m_pitchX(0.0),
+      m_pitchY(0.0)
+{
+}
+
+void
+FobaScenarioHelper::SetLayout(Layout layout)
+{
+    NS_LOG_FUNCTION(this << layout);
+    m_layout = layout;
+}
+
+void
+FobaScenarioHelper::SetSeed(uint32_t seed)
+{
+    NS_LOG_FUNCTION(this << seed);
+    m_seed = seed;
+}
+
+void
+FobaScenarioHelper::SetBlockSize(double size)
+{
+    NS_LOG_FUNCTION(this << size);
+    NS_ASSERT_MSG(size > 0, "Empty blocks");
+    m_blockSize = size;
+}
+
+void
+FobaScenarioHelper::SetStreetWidth(double width)
+{
+    NS_LOG_FUNCTION(this << width);
+    NS_ASSERT_MSG(width > 0, "The blocks must be apart");
+    m_streetWidth = width;
+}
+
+void
+FobaScenarioHelper::SetPassageWidth(double width)
+{
+    NS_LOG_FUNCTION(this << width);
+    NS_ASSERT_MSG(width > 0, "The buildings of a row must be apart");
+    m_passageWidth = width;
+}
+
+void
+FobaScenarioHelper::SetBuildingHeight(double height)
+{
+    NS_LOG_FUNCTION(this << height);
+    NS_ASSERT_MSG(height > 0, "Flat buildings");
+    m_buildingHeight = height;
+}
+
+void
+FobaScenarioHelper::SetHeightRange(double minHeight, double maxHeight)
+{
+    NS_LOG_FUNCTION(this << minHeight << maxHeight);
+    NS_ASSERT_MSG((minHeight > 0) && (minHeight <= maxHeight), "Empty range of heights");
+    m_minHeight = minHeight;
+    m_maxHeight = maxHeight;
+}
+
+void
+FobaScenarioHelper::SetNodeHeight(double z)
+{
+    NS_LOG_FUNCTION(this << z);
+    m_nodeHeight = z;
+}
+
+std::vector<Ptr<Building>>
+FobaScenarioHelper::CreateBuildings(uint32_t count)
+{
+    NS_LOG_FUNCTION(this << count);
+    std::mt19937 generator = MakeGenerator(m_seed, BUILDINGS_STREAM);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    m_columns = std::max<uint32_t>(1, std::ceil(std::sqrt(static_cast<double>(count))));
+    m_rows = std::max<uint32_t>(1, (count + m_columns - 1) / m_columns);
+    m_pitchX = m_blockSize + ((m_layout == STREET_CANYON) ? m_passageWidth : m_streetWidth);
+    m_pitchY = m_blockSize + m_streetWidth;
+    const double marginX = (m_pitchX - m_blockSize) / 2;
+    const double marginY = (m_pitchY - m_blockSize) / 2;
+
+    m_boxes.clear();
+    m_boxes.reserve(count);
+    std::vector<Ptr<Building>> buildings;
+    buildings.reserve(count);
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        double xMin = (k % m_columns) * m_pitchX + marginX;
+        double yMin = (k / m_columns) * m_pitchY + marginY;
+        double xSize = m_blockSize;
+        double ySize = m_blockSize;
+        double height = m_buildingHeight;
+        switch (m_layout)
+        {
+        case RANDOM_FOOTPRINT:
+            xSize = m_blockSize * (MIN_FOOTPRINT + (1 - MIN_FOOTPRINT) * unit(generator));
+            ySize = m_blockSize * (MIN_FOOTPRINT + (1 - MIN_FOOTPRINT) * unit(generator));
+            xMin += (m_blockSize - xSize) * unit(generator);
+            yMin += (m_blockSize - ySize) * unit(generator);
+            break;
+        case MIXED_HEIGHT:
+            height = m_minHeight + (m_maxHeight - m_minHeight) * unit(generator);
+            break;
+        default:
+            break;
+        }
+        m_boxes.emplace_back(xMin, xMin + xSize, yMin, yMin + ySize, 0.0, height);
+
+        Ptr<Building> building = CreateObject<Building>();
+        building->SetBoundaries(m_boxes.back());
+        building->SetBuildingType(Building::Residential);
+        building->SetExtWallsType(Building::ConcreteWithWindows);
+        buildings.push_back(building);
+    }
+    return buildings;
+}
+
+std::vector<Vector>
+FobaScenarioHelper::GetNodePositions(uint32_t count) const
+{
+    NS_LOG_FUNCTION(this << count);
+    NS_ASSERT_MSG(m_columns > 0, "No city created");
+    std::mt19937 generator = MakeGenerator(m_seed, NODES_STREAM);
+    Box area = GetArea();
+    std::uniform_real_distribution<double> x(area.xMin, area.xMax);
+    std::uniform_real_distribution<double> y(area.yMin, area.yMax);
+
+    std::vector<Vector> positions;
+    positions.reserve(count);
+    while (positions.size() < count)
+    {
+        Vector position(x(generator), y(generator), m_nodeHeight);
+        if (IsOutdoor(position))
+        {
+            positions.push_back(position);
+        }
+    }
+    return positions;
+}
+
+Box
+FobaScenarioHelper::GetArea() const
+{
+    double zMax = 0.0;
+    for (const auto& box : m_boxes)
+    {
+        zMax = std::max(zMax, box.zMax);
+    }
+    return Box(0.0, m_columns * m_pitchX, 0.0, m_rows * m_pitchY, 0.0, zMax);
+}
+
+bool
+FobaScenarioHelper::IsOutdoor(const Vector& position) const
+{
+    if (m_pitchX <= 0 || position.x < 0 || position.y < 0)
+    {
+        return true;
+    }
+    // A building lies within its block, only the building of the block of the point may hold it
+    uint32_t column = position.x / m_pitchX;
+    uint32_t row = position.y / m_pitchY;
+    if (column >= m_columns)
+    {
+        return true;
+    }
+    uint64_t block = static_cast<uint64_t>(row) * m_columns + column;
+    if (block >= m_boxes.size())
+    {
+        return true;
+    }
+    const Box& box = m_boxes[block];
+    return (position.x < box.xMin) || (position.x > box.xMax) || (position.y < box.yMin) ||
+           (position.y > box.yMax);
+}
+
+} // namespace ns3
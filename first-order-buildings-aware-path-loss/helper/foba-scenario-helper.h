@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_SCENARIO_HELPER_H
+#define FOBA_SCENARIO_HELPER_H
+
+#include "ns3/box.h"
+#include "ns3/building.h"
+#include "ns3/ptr.h"
+#include "ns3/vector.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Generate synthetic cities, and positions of nodes in their streets, from a seed
+ *
+ * The buildings are laid out on a square grid of blocks, one building per block, filled row by
+ * row from the origin. The layout sets the footprint and the height of the buildings:
+ * - MANHATTAN: every block is a building of the same height, separated by the streets;
+ * - RANDOM_FOOTPRINT: a building of random size and position within each block;
+ * - MIXED_HEIGHT: the MANHATTAN footprints, with random heights;
+ * - STREET_CANYON: rows of buildings separated by narrow passages, the rows separated by the
+ *   streets, so that the streets along x are lined by nearly continuous facades.
+ *
+ * The same seed, layout and parameters give the same buildings and nodes. The random draws use
+ * std::mt19937 and not the ns-3 streams, so that the scenario does not depend on the other
+ * random variables of the simulation.
+ */
+class FobaScenarioHelper
+{
+  public:
+    /**
+     * @brief Layout of the buildings
+     */
+    enum Layout
+    {
+        MANHATTAN,        ///< identical blocks
+        RANDOM_FOOTPRINT, ///< random footprint within each block
+        MIXED_HEIGHT,     ///< identical footprints, random heights
+        STREET_CANYON     ///< rows of buildings along x lining narrow streets
+    };
+
+    FobaScenarioHelper();
+
+    /**
+     * @brief Set the layout of the buildings
+     * @param layout the layout (default MANHATTAN)
+     */
+    void SetLayout(Layout layout);
+
+    /**
+     * @brief Set the seed of the buildings and of the nodes
+     * @param seed the seed (default 1)
+     */
+    void SetSeed(uint32_t seed);
+
+    /**
+     * @brief Set the size of the blocks
+     * @param size the edge of a block, the streets excluded (in m, default 50)
+     */
+    void SetBlockSize(double size);
+
+    /**
+     * @brief Set the width of the streets between the blocks
+     * @param width the width (in m, default 20)
+     */
+    void SetStreetWidth(double width);
+
+    /**
+     * @brief Set the width of the passages between the buildings of a row of STREET_CANYON
+     * @param width the width (in m, default 2)
+     */
+    void SetPassageWidth(double width);
+
+    /**
+     * @brief Set the height of the buildings, but for MIXED_HEIGHT
+     * @param height the height (in m, default 15)
+     */
+    void SetBuildingHeight(double height);
+
+    /**
+     * @brief Set the range of the heights of the buildings of MIXED_HEIGHT
+     * @param minHeight the lowest height (in m, default 6)
+     * @param maxHeight the highest height (in m, default 60)
+     */
+    void SetHeightRange(double minHeight, double maxHeight);
+
+    /**
+     * @brief Set the height of the nodes
+     * @param z the height (in m, default 1.5)
+     */
+    void SetNodeHeight(double z);
+
+    /**
+     * @brief Create the buildings of a city, added to the BuildingList
+     *
+     * @param count the number of buildings
+     * @return the buildings, in the order of their blocks
+     */
+    std::vector<Ptr<Building>> CreateBuildings(uint32_t count);
+
+    /**
+     * @brief Draw positions in the streets of the last city created, uniformly over its area
+     *
+     * @param count the number of positions
+     * @return the positions, at the height of the nodes
+     */
+    std::vector<Vector> GetNodePositions(uint32_t count) const;
+
+    /**
+     * @return the area of the last city created, its streets included (the z bounds are those of
+     * the buildings)
+     */
+    Box GetArea() const;
+
+    /**
+     * @brief Check if a point is in the streets of the last city created
+     *
+     * @param position the point, its height ignored
+     * @return true if the point is not within the footprint of a building, walls included
+     */
+    bool IsOutdoor(const Vector& position) const;
+
+  private:
+    Layout m_layout;          ///< Layout of the buildings
+    uint32_t m_seed;          ///< Seed of the buildings and of the nodes
+    double m_blockSize;       ///< Edge of a block (in m)
+    double m_streetWidth;     ///< Width of the streets (in m)
+    double m_passageWidth;    ///< Width of the passages of STREET_CANYON (in m)
+    double m_buildingHeight;  ///< Height of the buildings (in m)
+    double m_minHeight;       ///< Lowest height of MIXED_HEIGHT (in m)
+    double m_maxHeight;       ///< Highest height of MIXED_HEIGHT (in m)
+    double m_nodeHeight;      ///< Height of the nodes (in m)
+    std::vector<Box> m_boxes; ///< Bounds of the buildings of the last city, by block
+    uint32_t m_columns;       ///< Blocks along x of the last city
+    uint32_t m_rows;          ///< Blocks along y of the last city
+    double m_pitchX;          ///< Distance between two blocks along x (in m)
+    double m_pitchY;          ///< Distance between two blocks along y (in m)
+};
+
+} // namespace ns3
+
+#endif /* FOBA_SCENARIO_HELPER_H */
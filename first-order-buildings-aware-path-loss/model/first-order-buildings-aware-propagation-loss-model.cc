@@ -8,18 +8,24 @@
 
 #include "first-order-buildings-aware-propagation-loss-model.h"
 
+#include "ns3/abort.h"
 #include "ns3/building-list.h"
 #include "ns3/building.h"
+#include "ns3/constant-position-mobility-model.h"
 #include "ns3/double.h"
+#include "ns3/enum.h"
 #include "ns3/log.h"
 #include "ns3/mobility-model.h"
 #include "ns3/node-list.h"
+#include "ns3/node.h"
 #include "ns3/pointer.h"
-
-// Loss models
-#include "ns3/itu-r-1411-los-propagation-loss-model.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 
 namespace ns3
@@ -29,14 +35,57 @@ NS_LOG_COMPONENT_DEFINE("FirstOrderBuildingsAwarePropagationLossModel");
 
 NS_OBJECT_ENSURE_REGISTERED(FirstOrderBuildingsAwarePropagationLossModel);
 
+/// Parameters of the diffraction loss as a function of the shadowing angle (see DiffFunct)
+static const double DIFF_A = 0.70;
+static const double DIFF_B = 24.9;  ///< (in deg)
+static const double DIFF_C = 3.555;
+static const double DIFF_D = 31.7;  ///< (in dB)
+/// Entries of each half of the diffraction tables, the error is about 1e-3 dB
+static const uint32_t DIFF_TABLE_SIZE = 256;
+/// Lowest NLOS diffraction loss, DiffFunct of a null shadowing angle (in dB)
+static const double DIFF_MIN = -DIFF_A / std::exp(-DIFF_C) + DIFF_D;
+/// Margin of the lower bounds of the paths, covering their rounding errors (in dB)
+static const double BOUND_MARGIN = 1e-6;
+
+/// Height of the reflection points given by NLOSassess::Getreflectionpoint (in m)
+static const double REFL_HEIGHT = 1.0;
+/// Highest reflection coefficient of the wall types (StoneBlocks, see CitySnapshot)
+static const double REFL_COEF_MAX = 0.9;
+/// Bit of the Philox noise ids of the mobility models without node (see GetNoiseId)
+static const uint32_t NOISE_ID_OTHER = 1U << 31;
+
 FirstOrderBuildingsAwarePropagationLossModel::FirstOrderBuildingsAwarePropagationLossModel()
 {
-    m_ituR1411Los = CreateObject<ItuR1411LosPropagationLossModel>();
     m_assess = CreateObject<NLOSassess>();
     m_frequency = 2160e6;
+    m_lambda = 299792458.0 / m_frequency;
+    m_lambdaSquared = m_lambda * m_lambda;
     txGain = 25;
     m_noiseEnabled = true; // Default: noise enabled
     uni_rdm = CreateObject<UniformRandomVariable>();
+    m_spatialIndex = NO_INDEX;
+    m_gridCellSize = 50.0;
+    m_city = CreateObject<CitySnapshot>();
+    m_zoneCacheEnabled = false;
+    m_zoneCache = CreateObject<NodeZoneCache>();
+    m_linkCacheEnabled = false;
+    m_linkCache = CreateObject<LinkLossCache>();
+    m_pool = CreateObject<WorkStealingPool>();
+    m_lossFileChecked = false;
+    m_snapshotReady = false;
+    m_snapshotBuildings = 0;
+    m_snapshotFirst = nullptr;
+    m_snapshotIndex = NO_INDEX;
+    m_radioMapEnabled = false;
+    m_radioMaps = CreateObject<RadioMapCache>();
+    m_cullingEnabled = false;
+    m_rxSensitivity = -101.0;
+    m_noiseEngine = RNG_STREAM_NOISE;
+    m_diffractionMode = EXACT_DIFFRACTION;
+    m_noiseStream = -1;
+    m_autoNoiseStream = 0;
+    m_stats = CreateObject<LossStatistics>();
+    m_statsDumpScheduled = false;
 }
 
 FirstOrderBuildingsAwarePropagationLossModel::~FirstOrderBuildingsAwarePropagationLossModel()
@@ -55,13 +104,15 @@ FirstOrderBuildingsAwarePropagationLossModel::GetTypeId()
                 "Frequency",
                 "The Frequency  (default is 2.106 GHz).",
                 DoubleValue(2160e6),
-                MakeDoubleAccessor(&FirstOrderBuildingsAwarePropagationLossModel::SetFrequency),
+                MakeDoubleAccessor(&FirstOrderBuildingsAwarePropagationLossModel::SetFrequency,
+                                   &FirstOrderBuildingsAwarePropagationLossModel::GetFrequency),
                 MakeDoubleChecker<double>())
             .AddAttribute(
                 "TxGain",
                 "Emminting Power (default 20 dBm)",
                 DoubleValue(20),
-                MakeDoubleAccessor(&FirstOrderBuildingsAwarePropagationLossModel::SetGain),
+                MakeDoubleAccessor(&FirstOrderBuildingsAwarePropagationLossModel::SetGain,
+                                   &FirstOrderBuildingsAwarePropagationLossModel::GetGain),
                 MakeDoubleChecker<double>())
             .AddAttribute(
                 "NoiseEnabled",
@@ -69,7 +120,203 @@ FirstOrderBuildingsAwarePropagationLossModel::GetTypeId()
                 BooleanValue(true),
                 MakeBooleanAccessor(&FirstOrderBuildingsAwarePropagationLossModel::SetNoiseEnabled,
                                     &FirstOrderBuildingsAwarePropagationLossModel::GetNoiseEnabled),
-                MakeBooleanChecker());
+                MakeBooleanChecker())
+            .AddAttribute(
+                "NoiseEngine",
+                "Generator of the noise draws. RngStream draws from a random variable, in the "
+                "order of the calls. Philox keys each draw by the stream, the nodes of the link "
+                "and the number of draws of the link, so the noise of a link does not depend on "
+                "the order in which the links are evaluated.",
+                EnumValue(FirstOrderBuildingsAwarePropagationLossModel::RNG_STREAM_NOISE),
+                MakeEnumAccessor<NoiseEngineType>(
+                    &FirstOrderBuildingsAwarePropagationLossModel::m_noiseEngine),
+                MakeEnumChecker(FirstOrderBuildingsAwarePropagationLossModel::RNG_STREAM_NOISE,
+                                "RngStream",
+                                FirstOrderBuildingsAwarePropagationLossModel::PHILOX_NOISE,
+                                "Philox"))
+            .AddAttribute(
+                "DiffractionMode",
+                "Evaluation of the diffraction loss of the corners. Exact computes the angle "
+                "between the source, the corner and the destination, then its loss. Table "
+                "interpolates the loss from the dot and cross products of the directions, without "
+                "acos nor exp, within GetDiffractionMaxError (about 1e-3 dB).",
+                EnumValue(FirstOrderBuildingsAwarePropagationLossModel::EXACT_DIFFRACTION),
+                MakeEnumAccessor<DiffractionModeType>(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetDiffractionMode,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetDiffractionMode),
+                MakeEnumChecker(FirstOrderBuildingsAwarePropagationLossModel::EXACT_DIFFRACTION,
+                                "Exact",
+                                FirstOrderBuildingsAwarePropagationLossModel::TABLE_DIFFRACTION,
+                                "Table"))
+            .AddAttribute(
+                "SpatialIndex",
+                "Spatial index used to select the buildings evaluated for a link. With Grid, only "
+                "the buildings of the grid cells crossed by the link are tested, which gives the "
+                "same result as the exhaustive evaluation (None).",
+                EnumValue(FirstOrderBuildingsAwarePropagationLossModel::NO_INDEX),
+                MakeEnumAccessor<SpatialIndexType>(
+                    &FirstOrderBuildingsAwarePropagationLossModel::m_spatialIndex),
+                MakeEnumChecker(FirstOrderBuildingsAwarePropagationLossModel::NO_INDEX,
+                                "None",
+                                FirstOrderBuildingsAwarePropagationLossModel::GRID_INDEX,
+                                "Grid"))
+            .AddAttribute("GridCellSize",
+                          "Edge length (in m) of the cells of the Grid spatial index, taken into "
+                          "account when the index is (re)built.",
+                          DoubleValue(50.0),
+                          MakeDoubleAccessor(
+                              &FirstOrderBuildingsAwarePropagationLossModel::m_gridCellSize),
+                          MakeDoubleChecker<double>(0.0))
+            .AddAttribute(
+                "ZoneCache",
+                "Keep the zones of the static nodes relatively to all the buildings, they are "
+                "computed again once the node changes its course. It takes one byte per building "
+                "for each static node (default false)",
+                BooleanValue(false),
+                MakeBooleanAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetZoneCacheEnabled,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetZoneCacheEnabled),
+                MakeBooleanChecker())
+            .AddAttribute(
+                "ZoneCacheMaxCorners",
+                "Number of corners whose visibility from a static node is kept by the zone "
+                "cache, the visibility of the corners of a node is dropped once it holds more.",
+                UintegerValue(1024),
+                MakeUintegerAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetZoneCacheMaxCorners,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetZoneCacheMaxCorners),
+                MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute(
+                "LinkCache",
+                "Cache the loss (before noise) of the links between static nodes, a link is "
+                "computed again once one of its nodes changes its course (default false)",
+                BooleanValue(false),
+                MakeBooleanAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetLinkCacheEnabled,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetLinkCacheEnabled),
+                MakeBooleanChecker())
+            .AddAttribute(
+                "LinkCacheMaxEntries",
+                "Maximum number of links in the link cache, the least recently used links are "
+                "evicted first.",
+                UintegerValue(100000),
+                MakeUintegerAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetLinkCacheMaxEntries,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetLinkCacheMaxEntries),
+                MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute(
+                "ThreadCount",
+                "Number of threads computing the losses of a GetLossBatch, "
+                "GetDeterministicLossBatch or GetDeterministicLossMatrix call, the calling thread "
+                "included (default 1). GetLoss and CalcRxPower, hence the transmissions of a "
+                "simulation, always run in the calling thread, and the calls made by several "
+                "threads at the same time run one after the other. The losses, noise included, "
+                "do not depend on it.",
+                UintegerValue(1),
+                MakeUintegerAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetThreadCount,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetThreadCount),
+                MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute(
+                "RadioMap",
+                "Interpolate the loss (before noise) of the links between a fixed node, with a "
+                "ConstantPositionMobilityModel, and a node with another mobility model from a "
+                "grid of losses around the fixed node, built lazily (default false)",
+                BooleanValue(false),
+                MakeBooleanAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapEnabled,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapEnabled),
+                MakeBooleanChecker())
+            .AddAttribute(
+                "RadioMapResolution",
+                "Edge length of the cells of the radio maps (in m), it should stay below the "
+                "size of the buildings.",
+                DoubleValue(2.0),
+                MakeDoubleAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapResolution,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapResolution),
+                MakeDoubleChecker<double>(0.01))
+            .AddAttribute(
+                "RadioMapTolerance",
+                "Largest spread of the losses of the vertices of a cell of a radio map for the "
+                "cell to be interpolated (in dB), the other cells are computed exactly. An "
+                "interpolated loss is within the tolerance of the loss of each vertex of its "
+                "cell, not necessarily of the exact loss at its position.",
+                DoubleValue(1.0),
+                MakeDoubleAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapTolerance,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapTolerance),
+                MakeDoubleChecker<double>(0.0))
+            .AddAttribute(
+                "RadioMapLayerHeight",
+                "Distance between the horizontal layers of the radio maps (in m), the heights "
+                "between two layers are interpolated from both.",
+                DoubleValue(0.5),
+                MakeDoubleAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapLayerHeight,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapLayerHeight),
+                MakeDoubleChecker<double>(0.01))
+            .AddAttribute(
+                "RadioMapMaxVertices",
+                "Number of vertices of all the radio maps above which the maps are dropped "
+                "(about 64 bytes per vertex).",
+                UintegerValue(1000000),
+                MakeUintegerAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapMaxVertices,
+                    &FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapMaxVertices),
+                MakeUintegerChecker<uint64_t>(8))
+            .AddAttribute(
+                "LossFile",
+                "Loss file (see LossMatrixFile) serving the losses of its nodes, empty to compute "
+                "all the losses. The simulation is aborted if the file does not match the "
+                "buildings, the nodes, the frequency, the gain or the diffraction mode.",
+                StringValue(""),
+                MakeStringAccessor(&FirstOrderBuildingsAwarePropagationLossModel::SetLossFile,
+                                   &FirstOrderBuildingsAwarePropagationLossModel::GetLossFile),
+                MakeStringChecker())
+            .AddAttribute(
+                "Culling",
+                "Give the received power from the lower bound of the loss (see "
+                "GetLossLowerBound), without looking at the buildings, when even this bound "
+                "leaves the received power below RxSensitivity (default false). The power of "
+                "these links is overstated, but stays below RxSensitivity. Their noise is still "
+                "drawn, so the noise of the other links does not change. The links whose loss "
+                "is interpolated from a radio map are not culled.",
+                BooleanValue(false),
+                MakeBooleanAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::m_cullingEnabled),
+                MakeBooleanChecker())
+            .AddAttribute("RxSensitivity",
+                          "Received power (in dBm) below which the receivers drop the signal, "
+                          "used by Culling.",
+                          DoubleValue(-101.0),
+                          MakeDoubleAccessor(
+                              &FirstOrderBuildingsAwarePropagationLossModel::m_rxSensitivity),
+                          MakeDoubleChecker<double>())
+            .AddAttribute(
+                "StatsEnabled",
+                "Collect the counters and latency histograms of the loss computation (see "
+                "GetStatistics), the disabled statistics cost a test of a flag (default false)",
+                BooleanValue(false),
+                MakeBooleanAccessor(&FirstOrderBuildingsAwarePropagationLossModel::SetStatsEnabled,
+                                    &FirstOrderBuildingsAwarePropagationLossModel::GetStatsEnabled),
+                MakeBooleanChecker())
+            .AddAttribute(
+                "StatsFile",
+                "File to which the statistics are written at Simulator::Destroy when they are "
+                "collected, empty to not write them.",
+                StringValue(""),
+                MakeStringAccessor(&FirstOrderBuildingsAwarePropagationLossModel::SetStatsFile,
+                                   &FirstOrderBuildingsAwarePropagationLossModel::GetStatsFile),
+                MakeStringChecker())
+            .AddTraceSource(
+                "LossBreakdown",
+                "Terms of the loss of each GetLoss call: ITU-R 1411 loss, penetration, diffraction "
+                "corner, reflection point and path giving the loss. They are only computed when a "
+                "sink is connected.",
+                MakeTraceSourceAccessor(
+                    &FirstOrderBuildingsAwarePropagationLossModel::m_lossBreakdownTrace),
+                "ns3::FirstOrderBuildingsAwarePropagationLossModel::LossBreakdownTracedCallback");
 
     return tid;
 }
@@ -79,104 +326,741 @@ FirstOrderBuildingsAwarePropagationLossModel::SetFrequency(double freq)
 {
     NS_LOG_FUNCTION(this);
 
-    m_ituR1411Los->SetAttribute("Frequency", DoubleValue(freq));
     m_frequency = freq;
+    // Constants of ItuR1411, computed as ItuR1411LosPropagationLossModel does
+    m_lambda = 299792458.0 / freq;
+    m_lambdaSquared = m_lambda * m_lambda;
+    m_linkCache->Clear();
+    m_radioMaps->Clear();
+    m_lossFileChecked = false;
+    m_snapshotReady = false;
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetFrequency() const
+{
+    return m_frequency;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetGain(double gain)
+{
+    NS_LOG_FUNCTION(this);
+    txGain = gain;
+    m_linkCache->Clear();
+    m_radioMaps->Clear();
+    m_lossFileChecked = false;
+    m_snapshotReady = false;
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetGain() const
+{
+    return txGain;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetNoiseEnabled(bool enabled)
+{
+    NS_LOG_FUNCTION(this << enabled);
+    m_noiseEnabled = enabled;
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::GetNoiseEnabled() const
+{
+    NS_LOG_FUNCTION(this);
+    return m_noiseEnabled;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetZoneCacheEnabled(bool enabled)
+{
+    NS_LOG_FUNCTION(this << enabled);
+    m_zoneCacheEnabled = enabled;
+    m_zoneCache->Clear();
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::GetZoneCacheEnabled() const
+{
+    NS_LOG_FUNCTION(this);
+    return m_zoneCacheEnabled;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetZoneCacheMaxCorners(uint32_t maxCorners)
+{
+    NS_LOG_FUNCTION(this << maxCorners);
+    m_zoneCache->SetMaxCorners(maxCorners);
+}
+
+uint32_t
+FirstOrderBuildingsAwarePropagationLossModel::GetZoneCacheMaxCorners() const
+{
+    return m_zoneCache->GetMaxCorners();
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetLinkCacheEnabled(bool enabled)
+{
+    NS_LOG_FUNCTION(this << enabled);
+    m_linkCacheEnabled = enabled;
+    m_linkCache->Clear();
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::GetLinkCacheEnabled() const
+{
+    NS_LOG_FUNCTION(this);
+    return m_linkCacheEnabled;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetLinkCacheMaxEntries(uint32_t maxEntries)
+{
+    NS_LOG_FUNCTION(this << maxEntries);
+    m_linkCache->SetMaxEntries(maxEntries);
+}
+
+uint32_t
+FirstOrderBuildingsAwarePropagationLossModel::GetLinkCacheMaxEntries() const
+{
+    return m_linkCache->GetMaxEntries();
+}
+
+Ptr<LinkLossCache>
+FirstOrderBuildingsAwarePropagationLossModel::GetLinkCache() const
+{
+    return m_linkCache;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapEnabled(bool enabled)
+{
+    NS_LOG_FUNCTION(this << enabled);
+    m_radioMapEnabled = enabled;
+    m_radioMaps->Clear();
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapEnabled() const
+{
+    NS_LOG_FUNCTION(this);
+    return m_radioMapEnabled;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapResolution(double resolution)
+{
+    NS_LOG_FUNCTION(this << resolution);
+    m_radioMaps->SetResolution(resolution);
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapResolution() const
+{
+    return m_radioMaps->GetResolution();
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapTolerance(double tolerance)
+{
+    NS_LOG_FUNCTION(this << tolerance);
+    m_radioMaps->SetTolerance(tolerance);
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapTolerance() const
+{
+    return m_radioMaps->GetTolerance();
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapLayerHeight(double height)
+{
+    NS_LOG_FUNCTION(this << height);
+    m_radioMaps->SetLayerHeight(height);
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapLayerHeight() const
+{
+    return m_radioMaps->GetLayerHeight();
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetRadioMapMaxVertices(uint64_t vertices)
+{
+    NS_LOG_FUNCTION(this << vertices);
+    m_radioMaps->SetMaxVertices(vertices);
+}
+
+uint64_t
+FirstOrderBuildingsAwarePropagationLossModel::GetRadioMapMaxVertices() const
+{
+    return m_radioMaps->GetMaxVertices();
+}
+
+Ptr<RadioMapCache>
+FirstOrderBuildingsAwarePropagationLossModel::GetRadioMaps() const
+{
+    return m_radioMaps;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetLossFile(const std::string& path)
+{
+    NS_LOG_FUNCTION(this << path);
+    m_lossFilePath = path;
+    m_lossFileChecked = false;
+    m_snapshotReady = false;
+    if (m_lossFile)
+    {
+        m_lossFile->Dispose();
+        m_lossFile = nullptr;
+    }
+    if (path.empty())
+    {
+        return;
+    }
+    m_lossFile = CreateObject<LossMatrixFile>();
+    NS_ABORT_MSG_UNLESS(m_lossFile->Open(path), "Cannot read the loss file " << path);
+}
+
+std::string
+FirstOrderBuildingsAwarePropagationLossModel::GetLossFile() const
+{
+    return m_lossFilePath;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetThreadCount(uint32_t count)
+{
+    NS_LOG_FUNCTION(this << count);
+    m_pool->SetThreadCount(count);
+}
+
+uint32_t
+FirstOrderBuildingsAwarePropagationLossModel::GetThreadCount() const
+{
+    return m_pool->GetThreadCount();
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetDiffractionMode(DiffractionModeType mode)
+{
+    NS_LOG_FUNCTION(this << mode);
+    m_diffractionMode = mode;
+    if ((mode == TABLE_DIFFRACTION) && !m_nlosDiffraction.IsBuilt())
+    {
+        m_nlosDiffraction.Build([this](double angle) { return DiffFunct(angle); },
+                                DIFF_TABLE_SIZE);
+        m_losDiffraction.Build([this](double angle) { return DiffFunct(-angle); },
+                               DIFF_TABLE_SIZE);
+    }
+    m_linkCache->Clear();
+    m_radioMaps->Clear();
+    m_lossFileChecked = false;
+    m_snapshotReady = false;
+}
+
+FirstOrderBuildingsAwarePropagationLossModel::DiffractionModeType
+FirstOrderBuildingsAwarePropagationLossModel::GetDiffractionMode() const
+{
+    return m_diffractionMode;
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetDiffractionMaxError() const
+{
+    if (m_diffractionMode == EXACT_DIFFRACTION)
+    {
+        return 0.0;
+    }
+    return std::max(m_nlosDiffraction.GetMaxError(), m_losDiffraction.GetMaxError());
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetStatsEnabled(bool enabled)
+{
+    NS_LOG_FUNCTION(this << enabled);
+    m_stats->SetEnabled(enabled);
+    ScheduleStatsDump();
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::GetStatsEnabled() const
+{
+    return m_stats->IsEnabled();
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::SetStatsFile(const std::string& path)
+{
+    NS_LOG_FUNCTION(this << path);
+    m_statsFile = path;
+    ScheduleStatsDump();
+}
+
+std::string
+FirstOrderBuildingsAwarePropagationLossModel::GetStatsFile() const
+{
+    return m_statsFile;
+}
+
+Ptr<LossStatistics>
+FirstOrderBuildingsAwarePropagationLossModel::GetStatistics() const
+{
+    return m_stats;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::ScheduleStatsDump()
+{
+    if (m_statsDumpScheduled || !m_stats->IsEnabled() || m_statsFile.empty())
+    {
+        return;
+    }
+    // The statistics outlive the model until Simulator::Destroy
+    Simulator::ScheduleDestroy(&LossStatistics::Dump, m_stats, m_statsFile);
+    m_statsDumpScheduled = true;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::NotifyBuildingsChanged()
+{
+    NS_LOG_FUNCTION(this);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_city->Invalidate();
+    m_snapshotReady = false;
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetLoss(Ptr<MobilityModel> rx,
+                                                      Ptr<MobilityModel> tx) const
+{
+    NS_LOG_FUNCTION(this);
+
+    if (m_lossBreakdownTrace.IsEmpty())
+    {
+        double loss = GetDeterministicLoss(rx, tx);
+        if (m_noiseEnabled)
+        {
+            loss += Noise(loss, rx, tx);
+        }
+        return loss;
+    }
+
+    UpdateCitySnapshot();
+    m_stats->Add(LossStatistics::CALLS);
+    LossBreakdown breakdown;
+    double loss = GetDeterministicLoss(rx, tx, GetEndpoint(tx, nullptr), &breakdown);
+    if (m_noiseEnabled)
+    {
+        breakdown.noise = Noise(loss, rx, tx);
+        loss += breakdown.noise;
+    }
+    breakdown.loss = loss;
+    m_lossBreakdownTrace(rx, tx, breakdown);
+    return loss;
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetLossLowerBound(Ptr<MobilityModel> rx,
+                                                                Ptr<MobilityModel> tx) const
+{
+    NS_LOG_FUNCTION(this);
+
+    Vector rxPos = rx->GetPosition();
+    Vector txPos = tx->GetPosition();
+    double bound = ItuR1411(rxPos, txPos);
+    if (bound <= 90)
+    {
+        // The buildings only add losses to the direct path, a reflected path is at least as long
+        // as the link
+        double length = std::hypot(txPos.x - rxPos.x, txPos.y - rxPos.y);
+        bound = std::min(bound, ReflectionLossLowerBound(length, txPos.z, rxPos.z));
+    }
+    if (m_noiseEnabled)
+    {
+        // The noise of a loss L is at least -|0.05 L + 1| (see Noise), and L - |0.05 L + 1|
+        // increases with L
+        bound -= std::abs(0.05 * bound + 1);
+    }
+    return bound;
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::GetLossBatch(
+    Ptr<MobilityModel> tx,
+    std::span<const Ptr<MobilityModel>> rx,
+    std::span<double> out) const
+{
+    NS_LOG_FUNCTION(this << rx.size());
+    NS_ASSERT_MSG(rx.size() == out.size(), "GetLossBatch needs one output per receiver");
+
+    UpdateCitySnapshot();
+    m_stats->Add(LossStatistics::CALLS, rx.size());
+    // The source is located once, and the corners checked from it are shared by the receivers
+    NLOSassess::CornerVisibility corners;
+    NLOSassess::Endpoint txEndpoint = GetEndpoint(tx, &corners);
+    if (m_pool->GetThreadCount() == 1)
+    {
+        for (size_t i = 0; i < rx.size(); ++i)
+        {
+            double loss = GetDeterministicLoss(rx[i], tx, txEndpoint);
+            if (m_noiseEnabled)
+            {
+                loss += Noise(loss, rx[i], tx);
+            }
+            out[i] = loss;
+        }
+        return;
+    }
+
+    // The caches and the random variable are only used by this thread, the threads of the pool
+    // compute the links missing from the link cache
+    std::vector<uint32_t> missing;
+    std::vector<NLOSassess::Endpoint> rxEndpoints;
+    for (uint32_t i = 0; i < rx.size(); ++i)
+    {
+        if (LookupLoss(rx[i], tx, out[i]) ||
+            (IsRadioMapLink(rx[i], tx) && InterpolateLoss(rx[i], tx, txEndpoint, out[i])))
+        {
+            continue;
+        }
+        missing.push_back(i);
+        rxEndpoints.push_back(GetEndpoint(rx[i], nullptr));
+    }
+    std::vector<NLOSassess::CornerVisibility> threadCorners = CopyCorners(txEndpoint);
+    m_pool->ParallelFor(missing.size(), [&](uint32_t k, uint32_t thread) {
+        NLOSassess::Endpoint source = txEndpoint;
+        source.corners = &threadCorners[thread];
+        source.cornersMutex = nullptr;
+        out[missing[k]] = DoGetDeterministicLoss(rxEndpoints[k], source);
+    });
+    MergeCorners(txEndpoint, threadCorners);
+    if (m_linkCacheEnabled)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (uint32_t i : missing)
+        {
+            m_linkCache->Insert(rx[i], tx, out[i]);
+        }
+    }
+    // Noise drawn in the order of the receivers, whatever the number of threads
+    if (m_noiseEnabled)
+    {
+        for (size_t i = 0; i < rx.size(); ++i)
+        {
+            out[i] += Noise(out[i], rx[i], tx);
+        }
+    }
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::GetDeterministicLossBatch(
+    Ptr<MobilityModel> tx,
+    std::span<const Vector> rx,
+    std::span<double> out) const
+{
+    NS_LOG_FUNCTION(this << rx.size());
+    NS_ASSERT_MSG(rx.size() == out.size(),
+                  "GetDeterministicLossBatch needs one output per position");
+
+    UpdateCitySnapshot();
+    m_stats->Add(LossStatistics::CALLS, rx.size());
+    NLOSassess::CornerVisibility corners;
+    NLOSassess::Endpoint txEndpoint = GetEndpoint(tx, &corners);
+    std::vector<NLOSassess::CornerVisibility> threadCorners = CopyCorners(txEndpoint);
+    m_pool->ParallelFor(rx.size(), [&](uint32_t i, uint32_t thread) {
+        NLOSassess::Endpoint source = txEndpoint;
+        source.corners = &threadCorners[thread];
+        source.cornersMutex = nullptr;
+        out[i] = DoGetDeterministicLoss(NLOSassess::Endpoint{rx[i]}, source);
+    });
+    MergeCorners(txEndpoint, threadCorners);
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::GetDeterministicLossMatrix(
+    std::span<const Ptr<MobilityModel>> nodes,
+    std::span<double> out,
+    uint32_t tileSize) const
+{
+    NS_LOG_FUNCTION(this << nodes.size() << tileSize);
+    NS_ASSERT_MSG(out.size() == nodes.size() * nodes.size(),
+                  "GetDeterministicLossMatrix needs one output per pair of nodes");
+    NS_ASSERT_MSG(tileSize > 0, "Empty tiles");
+
+    UpdateCitySnapshot();
+    const uint32_t n = nodes.size();
+    m_stats->Add(LossStatistics::CALLS, static_cast<uint64_t>(n) * (n - 1));
+    std::vector<NLOSassess::Endpoint> endpoints;
+    endpoints.reserve(n);
+    for (const auto& node : nodes)
+    {
+        endpoints.push_back(GetEndpoint(node, nullptr));
+        endpoints.back().corners = nullptr;
+        endpoints.back().cornersMutex = nullptr;
+    }
+
+    // Corners checked by each thread from each source
+    const uint32_t tiles = (n + tileSize - 1) / tileSize;
+    std::vector<std::vector<NLOSassess::CornerVisibility>> threadCorners(
+        m_pool->GetThreadCount(),
+        std::vector<NLOSassess::CornerVisibility>(n));
+    m_pool->ParallelFor(tiles * tiles, [&](uint32_t tile, uint32_t thread) {
+        const uint32_t rxBegin = (tile / tiles) * tileSize;
+        const uint32_t txBegin = (tile % tiles) * tileSize;
+        for (uint32_t j = txBegin; j < std::min(txBegin + tileSize, n); ++j)
+        {
+            NLOSassess::Endpoint source = endpoints[j];
+            source.corners = &threadCorners[thread][j];
+            for (uint32_t i = rxBegin; i < std::min(rxBegin + tileSize, n); ++i)
+            {
+                out[i * n + j] = (i == j) ? 0.0 : DoGetDeterministicLoss(endpoints[i], source);
+            }
+        }
+    });
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetDeterministicLoss(Ptr<MobilityModel> rx,
+                                                                   Ptr<MobilityModel> tx) const
+{
+    NS_LOG_FUNCTION(this);
+
+    UpdateCitySnapshot();
+    m_stats->Add(LossStatistics::CALLS);
+    return GetDeterministicLoss(rx, tx, GetEndpoint(tx, nullptr));
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::GetDeterministicLoss(
+    Ptr<MobilityModel> rx,
+    Ptr<MobilityModel> tx,
+    const NLOSassess::Endpoint& txEndpoint,
+    LossBreakdown* breakdown) const
+{
+    double loss = 0.0;
+    if (LookupLoss(rx, tx, loss))
+    {
+        return loss;
+    }
+    if (IsRadioMapLink(rx, tx) && InterpolateLoss(rx, tx, txEndpoint, loss))
+    {
+        return loss;
+    }
+    loss = DoGetDeterministicLoss(GetEndpoint(rx, nullptr), txEndpoint, breakdown);
+    if (m_linkCacheEnabled)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_linkCache->Insert(rx, tx, loss);
+    }
+    return loss;
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::LookupLoss(Ptr<MobilityModel> rx,
+                                                         Ptr<MobilityModel> tx,
+                                                         double& loss) const
+{
+    if (!m_lossFile && !m_linkCacheEnabled)
+    {
+        // Nothing to look up, the default, without taking the lock
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_lossFile && m_lossFile->Lookup(rx, tx, loss))
+    {
+        return true;
+    }
+    return m_linkCacheEnabled && m_linkCache->Lookup(rx, tx, loss);
+}
+
+/**
+ * @brief Tell if a node may have a radio map: a node that is only standing still, like a mobile
+ * node in a pause, would get a map that is dropped as soon as it moves again
+ *
+ * @param mobility the mobility model of the node
+ * @returns true if the node has a ConstantPositionMobilityModel
+ */
+static bool
+IsFixed(Ptr<MobilityModel> mobility)
+{
+    return DynamicCast<ConstantPositionMobilityModel>(mobility) != nullptr;
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::IsRadioMapLink(Ptr<MobilityModel> rx,
+                                                             Ptr<MobilityModel> tx) const
+{
+    // The links between fixed nodes go to the link cache
+    return m_radioMapEnabled && (IsFixed(rx) != IsFixed(tx));
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::InterpolateLoss(
+    Ptr<MobilityModel> rx,
+    Ptr<MobilityModel> tx,
+    const NLOSassess::Endpoint& txEndpoint,
+    double& loss) const
+{
+    // The radio maps have their own lock, the missing vertices are computed without holding it
+    if (IsFixed(tx))
+    {
+        return m_radioMaps->Interpolate(
+            tx,
+            true,
+            rx->GetPosition(),
+            [this, &txEndpoint](const Vector& vertex) {
+                return DoGetDeterministicLoss(NLOSassess::Endpoint{vertex}, txEndpoint);
+            },
+            loss);
+    }
+    NLOSassess::Endpoint rxEndpoint = GetEndpoint(rx, nullptr);
+    return m_radioMaps->Interpolate(
+        rx,
+        false,
+        tx->GetPosition(),
+        [this, &rxEndpoint](const Vector& vertex) {
+            return DoGetDeterministicLoss(rxEndpoint, NLOSassess::Endpoint{vertex});
+        },
+        loss);
 }
 
-void
-FirstOrderBuildingsAwarePropagationLossModel::SetGain(double gain)
+NLOSassess::Endpoint
+FirstOrderBuildingsAwarePropagationLossModel::GetEndpoint(
+    Ptr<MobilityModel> node,
+    NLOSassess::CornerVisibility* corners) const
 {
-    NS_LOG_FUNCTION(this);
-    txGain = gain;
+    // The positions are read once, the geometry below only works on them
+    NLOSassess::Endpoint endpoint{node->GetPosition()};
+    if (m_zoneCacheEnabled)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        endpoint = m_zoneCache->GetEndpoint(node, *m_city, *m_assess);
+    }
+    if (!endpoint.corners)
+    {
+        endpoint.corners = corners;
+    }
+    return endpoint;
 }
 
-void
-FirstOrderBuildingsAwarePropagationLossModel::SetNoiseEnabled(bool enabled)
+std::vector<NLOSassess::CornerVisibility>
+FirstOrderBuildingsAwarePropagationLossModel::CopyCorners(const NLOSassess::Endpoint& tx) const
 {
-    NS_LOG_FUNCTION(this << enabled);
-    m_noiseEnabled = enabled;
+    std::unique_lock<std::mutex> lock;
+    if (tx.cornersMutex)
+    {
+        lock = std::unique_lock<std::mutex>(*tx.cornersMutex);
+    }
+    return std::vector<NLOSassess::CornerVisibility>(m_pool->GetThreadCount(), *tx.corners);
 }
 
-bool
-FirstOrderBuildingsAwarePropagationLossModel::GetNoiseEnabled() const
+void
+FirstOrderBuildingsAwarePropagationLossModel::MergeCorners(
+    const NLOSassess::Endpoint& tx,
+    const std::vector<NLOSassess::CornerVisibility>& threadCorners) const
 {
-    NS_LOG_FUNCTION(this);
-    return m_noiseEnabled;
+    std::unique_lock<std::mutex> lock;
+    if (tx.cornersMutex)
+    {
+        lock = std::unique_lock<std::mutex>(*tx.cornersMutex);
+    }
+    for (const auto& checked : threadCorners)
+    {
+        tx.corners->insert(checked.begin(), checked.end());
+    }
 }
 
 double
-FirstOrderBuildingsAwarePropagationLossModel::GetLoss(Ptr<MobilityModel> rx,
-                                                      Ptr<MobilityModel> tx) const
+FirstOrderBuildingsAwarePropagationLossModel::DoGetDeterministicLoss(
+    const NLOSassess::Endpoint& rx,
+    const NLOSassess::Endpoint& tx,
+    LossBreakdown* breakdown) const
 {
-    NS_LOG_FUNCTION(this);
+    const Vector& rxPos = rx.position;
+    const Vector& txPos = tx.position;
+    NS_LOG_FUNCTION(this << rxPos << txPos);
 
-    NS_ASSERT_MSG((rx->GetPosition().z >= 0) && (tx->GetPosition().z >= 0),
+    NS_ASSERT_MSG((rxPos.z >= 0) && (txPos.z >= 0),
                   "FirstOrderBuildingsAwarePropagationLossModel does not support underground nodes "
                   "(placed at z < 0)");
 
+    LossStatistics::Timer timer(*m_stats, LossStatistics::LINK_PHASE);
+    m_stats->Add(LossStatistics::LINKS);
     double loss = 0.0;
 
     // For now singular loss model ITU-R-1411
-    loss = ItuR1411(rx, tx);
-    NS_LOG_DEBUG("Initial loss (before first order path loss) : " << loss);
-    std::vector<Ptr<Building>> NLOSBuildings;
-    std::vector<Ptr<Building>> AllBuildings;
-    Vector rxPos = rx->GetPosition();
-    Vector txPos = tx->GetPosition();
-    int limit = BuildingList::GetNBuildings();
-    for (int index = 0; index < limit; ++index)
+    loss = ItuR1411(rxPos, txPos);
+    if (breakdown)
     {
-        Ptr<Building> CurBu = BuildingList::GetBuilding(index);
-        if (CurBu->IsIntersect(rxPos, txPos))
-        {
-            NLOSBuildings.push_back(CurBu);
-        }
-        AllBuildings.push_back(CurBu);
+        breakdown->path = FAR_PATH;
+        breakdown->ituLoss = loss;
     }
     if (loss > 90)
     {
-        if (m_noiseEnabled)
-        {
-            loss += Noise(loss);
-        }
-
+        m_stats->Add(LossStatistics::FAR_LINKS);
         return loss;
     }
+    std::vector<uint32_t> NLOSBuildings = GetIntersectedBuildings(rxPos, txPos);
 
     if (!NLOSBuildings.empty())
     {
-        double direct_path_loss = loss + PenetrationLoss(NLOSBuildings);
-        NS_LOG_DEBUG("NLOS first order buildings aware, direct path loss : " << direct_path_loss);
-        double diffracted_path_loss =
-            loss + NLOSDiffractionLoss(NLOSBuildings, AllBuildings, rx, tx);
-        NS_LOG_DEBUG(
-            "NLOS first order buildings aware, diffracted path loss : " << diffracted_path_loss);
-        double reflected_path_loss = ReflectionLoss(AllBuildings, rx, tx);
-        NS_LOG_DEBUG(
-            "NLOS first order buildings aware, reflected path loss : " << reflected_path_loss);
-        loss = std::min(std::min(direct_path_loss, diffracted_path_loss), reflected_path_loss);
-        NS_LOG_INFO(
-            this << " ------------------------- 0-0 NLOS first order buildings aware loss : "
-                 << loss);
+        m_stats->Add(LossStatistics::NLOS_LINKS);
+        double penetration_loss = PenetrationLoss(NLOSBuildings);
+        double direct_path_loss = loss + penetration_loss;
 
-        if (m_noiseEnabled)
+        // The diffracted and reflected paths are evaluated by increasing lower bound, a path whose
+        // bound is above the best loss found so far cannot change the loss
+        double best = direct_path_loss;
+        PathType path = PENETRATION_PATH;
+        auto evaluateDiffraction = [&]() {
+            if (loss + DIFF_MIN > best + BOUND_MARGIN)
+            {
+                m_stats->Add(LossStatistics::DIFFRACTIONS_PRUNED);
+                return;
+            }
+            double diffracted_path_loss =
+                loss + NLOSDiffractionLoss(NLOSBuildings, rx, tx, breakdown);
+            path = (diffracted_path_loss < best) ? DIFFRACTION_PATH : path;
+            best = std::min(best, diffracted_path_loss);
+        };
+        auto evaluateReflection = [&]() {
+            double reflected_path_loss = ReflectionLoss(rx, tx, best, breakdown);
+            path = (reflected_path_loss < best) ? REFLECTION_PATH : path;
+            best = std::min(best, reflected_path_loss);
+        };
+        double length = std::hypot(txPos.x - rxPos.x, txPos.y - rxPos.y);
+        if (ReflectionLossLowerBound(length, txPos.z, rxPos.z) < loss + DIFF_MIN)
         {
-            loss += Noise(loss);
+            evaluateReflection();
+            evaluateDiffraction();
         }
-
-        // if (diffracted_path_loss > 1000){std::cout <<"tik"<<std::endl;std::cout <<
-        // diffracted_path_loss<<std::endl;std::exit(1);}
-        return loss;
+        else
+        {
+            evaluateDiffraction();
+            evaluateReflection();
+        }
+        if (breakdown)
+        {
+            breakdown->path = path;
+            breakdown->penetrationLoss = penetration_loss;
+        }
+        return best;
     }
-    loss += LOSDiffractionLoss(AllBuildings, rx, tx);
-    NS_LOG_INFO(this << " 0-0 LOS first order buildings aware loss : " << loss);
-
-    if (m_noiseEnabled)
+    m_stats->Add(LossStatistics::LOS_LINKS);
+    double diffraction_loss = LOSDiffractionLoss(rx, tx, breakdown);
+    if (breakdown)
     {
-        loss += Noise(loss);
+        breakdown->path = LOS_PATH;
+        breakdown->diffractionLoss = diffraction_loss;
     }
-
-    return loss;
+    return loss + diffraction_loss;
 }
 
 double
@@ -185,6 +1069,21 @@ FirstOrderBuildingsAwarePropagationLossModel::DoCalcRxPower(double txPowerDbm,
                                                             Ptr<MobilityModel> b) const
 {
     double rxPow = txPowerDbm;
+    if (m_cullingEnabled && !IsRadioMapLink(a, b))
+    {
+        double bound = GetLossLowerBound(a, b);
+        if (txPowerDbm - bound < m_rxSensitivity)
+        {
+            NS_LOG_DEBUG("Culled link, loss of at least " << bound);
+            if (m_noiseEnabled)
+            {
+                // The draw of the link is discarded, the next links get the same draws as
+                // without culling
+                Noise(bound, a, b);
+            }
+            return rxPow - bound;
+        }
+    }
     rxPow -= GetLoss(a, b);
     return rxPow;
 }
@@ -195,94 +1094,77 @@ FirstOrderBuildingsAwarePropagationLossModel::DoAssignStreams(int64_t stream)
     NS_LOG_FUNCTION(this);
 
     uni_rdm->SetStream(stream);
+    m_noiseStream = stream;
+    std::lock_guard<std::mutex> lock(m_noiseMutex);
+    m_noiseDraws.clear();
 
     return 1;
 }
 
+void
+FirstOrderBuildingsAwarePropagationLossModel::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    {
+        std::lock_guard<std::mutex> lock(m_noiseMutex);
+        m_noiseDraws.clear();
+        m_noiseIds.clear();
+    }
+    PropagationLossModel::DoDispose();
+}
+
 double
 FirstOrderBuildingsAwarePropagationLossModel::PenetrationLoss(
-    const std::vector<Ptr<Building>>& NLOSBuildings) const
+    const std::vector<uint32_t>& NLOSBuildings) const
 {
     NS_LOG_FUNCTION(this);
 
     double loss = 0;
-    for (size_t i = 0; i < NLOSBuildings.size(); ++i)
+    for (uint32_t slot : NLOSBuildings)
     {
-        if (NLOSBuildings[i]->GetExtWallsType() == Building::Wood)
-        {
-            loss += 2 * 20;
-        }
-        else if (NLOSBuildings[i]->GetExtWallsType() == Building::ConcreteWithWindows)
-        {
-            loss += 2 * 30;
-        }
-        else if (NLOSBuildings[i]->GetExtWallsType() == Building::ConcreteWithoutWindows)
-        {
-            loss += 2 * 30;
-        }
-        else if (NLOSBuildings[i]->GetExtWallsType() == Building::StoneBlocks)
-        {
-            loss += 2 * 40;
-        }
-        else
-        {
-            NS_LOG_ERROR(this << " Unkwnon Wall Type");
-        }
+        loss += m_city->GetPenetrationLoss(slot);
     }
     return loss;
 }
 
 double
 FirstOrderBuildingsAwarePropagationLossModel::NLOSDiffractionLoss(
-    const std::vector<Ptr<Building>>& NLOSBuildings,
-    const std::vector<Ptr<Building>>& AllBuildings,
-    Ptr<MobilityModel> rx,
-    Ptr<MobilityModel> tx) const
+    const std::vector<uint32_t>& NLOSBuildings,
+    const NLOSassess::Endpoint& rx,
+    const NLOSassess::Endpoint& tx,
+    LossBreakdown* breakdown) const
 {
     NS_LOG_FUNCTION(this);
 
-    auto CreateTempMobilityModel = [](Vector position) {
-        Ptr<ConstantPositionMobilityModel> tempMobility =
-            CreateObject<ConstantPositionMobilityModel>();
-        tempMobility->SetPosition(position);
-        return tempMobility;
+    auto selected = [&](double loss, const Vector& corner) {
+        if (breakdown)
+        {
+            breakdown->diffractionLoss = loss;
+            breakdown->diffractionCorner = corner;
+            breakdown->diffractionAngle = calculateAngle(tx.position, corner, rx.position);
+        }
+        return loss;
     };
-
     for (size_t i = 0; i < NLOSBuildings.size(); ++i)
     {
-        std::vector<Vector> CornersPos = m_assess->GetCorner(NLOSBuildings[i], rx, tx);
+        std::vector<Vector> CornersPos = m_assess->GetCorner(*m_city, NLOSBuildings[i], rx, tx);
         const size_t size_cor = CornersPos.size();
         if (size_cor == 1)
         {
-            Ptr<MobilityModel> corner_pos = CreateTempMobilityModel(CornersPos[0]);
-            std::vector<Ptr<Building>> NLOScorner =
-                m_assess->GetBuildingsBetween(corner_pos, tx, AllBuildings);
-            if (NLOScorner.empty())
+            if (IsCornerVisible(CornersPos[0], tx))
             {
-                double theta = calculateAngle(tx, CornersPos[0], rx);
-                NS_LOG_DEBUG("NLOS diffraction, theta : " << theta << " on corner "
-                                                          << CornersPos[0]);
-                return DiffFunct(theta);
+                double loss = DiffractionLoss(tx.position, CornersPos[0], rx.position, true);
+                return selected(loss, CornersPos[0]);
             }
         }
         if (size_cor == 2)
         {
-            Ptr<MobilityModel> corner_pos_1 = CreateTempMobilityModel(CornersPos[0]);
-            Ptr<MobilityModel> corner_pos_2 = CreateTempMobilityModel(CornersPos[1]);
-            std::vector<Ptr<Building>> NLOScorner_1 =
-                m_assess->GetBuildingsBetween(corner_pos_1, tx, AllBuildings);
-            std::vector<Ptr<Building>> NLOScorner_2 =
-                m_assess->GetBuildingsBetween(corner_pos_2, tx, AllBuildings);
-            if (NLOScorner_1.empty() || NLOScorner_2.empty())
+            if (IsCornerVisible(CornersPos[0], tx) || IsCornerVisible(CornersPos[1], tx))
             {
-                double theta_1 = calculateAngle(tx, CornersPos[0], rx);
-                double theta_2 = calculateAngle(tx, CornersPos[1], rx);
-                NS_LOG_DEBUG("NLOS diffraction, theta_1 : "
-                             << theta_1 << " on corner " << CornersPos[0]
-                             << " theta_2 : " << theta_2 << " on corner " << CornersPos[1]);
-                double loss_1 = DiffFunct(theta_1);
-                double loss_2 = DiffFunct(theta_2);
-                return std::min(loss_1, loss_2);
+                double loss_1 = DiffractionLoss(tx.position, CornersPos[0], rx.position, true);
+                double loss_2 = DiffractionLoss(tx.position, CornersPos[1], rx.position, true);
+                return (loss_2 < loss_1) ? selected(loss_2, CornersPos[1])
+                                         : selected(loss_1, CornersPos[0]);
             }
         }
         if (size_cor > 2)
@@ -297,122 +1179,229 @@ FirstOrderBuildingsAwarePropagationLossModel::NLOSDiffractionLoss(
 
 double
 FirstOrderBuildingsAwarePropagationLossModel::LOSDiffractionLoss(
-    const std::vector<Ptr<Building>>& AllBuildings,
-    Ptr<MobilityModel> rx,
-    Ptr<MobilityModel> tx) const
+    const NLOSassess::Endpoint& rx,
+    const NLOSassess::Endpoint& tx,
+    LossBreakdown* breakdown) const
 {
     NS_LOG_FUNCTION(this);
 
-    auto CreateTempMobilityModel = [](Vector position) {
-        Ptr<ConstantPositionMobilityModel> tempMobility =
-            CreateObject<ConstantPositionMobilityModel>();
-        tempMobility->SetPosition(position);
-        return tempMobility;
-    };
+    const Vector& rxPos = rx.position;
+    const Vector& txPos = tx.position;
 
-    std::vector<double> losses;
-    for (size_t j = 0; j < AllBuildings.size(); ++j)
-    {
-        std::vector<Vector> CornersPos = m_assess->GetCorner(AllBuildings[j], rx, tx);
+    // Only the buildings overlapping the bounding box of the link can have a diffraction corner.
+    // The corner search is cheap, the visibility of the corner is not: it is only checked for the
+    // corners of the corridor, the others cannot give a positive loss.
+    std::vector<Vector> corridorCorners;
+    auto addCorner = [&](uint32_t slot) {
+        std::vector<Vector> CornersPos = m_assess->GetCorner(*m_city, slot, rx, tx);
         const size_t size_cor = CornersPos.size();
-        if (size_cor == 1)
+        if ((size_cor == 1) && IsInDiffractionCorridor(CornersPos[0], txPos, rxPos))
         {
-            Ptr<MobilityModel> corner_pos = CreateTempMobilityModel(CornersPos[0]);
-            std::vector<Ptr<Building>> NLOScorner =
-                m_assess->GetBuildingsBetween(corner_pos, tx, AllBuildings);
-            if (NLOScorner.empty())
-            {
-                double theta = -calculateAngle(tx, CornersPos[0], rx);
-                NS_LOG_DEBUG("NLOS diffraction, theta : " << theta << " on corner "
-                                                          << CornersPos[0]);
-                losses.push_back(DiffFunct(theta));
-            }
+            corridorCorners.push_back(CornersPos[0]);
         }
         if (size_cor > 1)
         {
             NS_LOG_ERROR(
                 this
                 << "In LOS, a given building should at most be source of one (1) difffraction");
-            return 0.0;
-            ;
+            return false;
+        }
+        return true;
+    };
+    // Without a spatial index, every building of the snapshot is a candidate
+    if (m_spatialIndex == GRID_INDEX)
+    {
+        for (uint32_t slot : GetBuildingsAround(rxPos, txPos))
+        {
+            if (!addCorner(slot))
+            {
+                return 0.0;
+            }
+        }
+    }
+    else
+    {
+        for (uint32_t slot = 0; slot < m_city->GetNBuildings(); ++slot)
+        {
+            if (!addCorner(slot))
+            {
+                return 0.0;
+            }
         }
     }
 
-    if (!losses.empty())
+    // Negative losses are discarded, and a corner that does not raise the loss needs no check
+    double maxL = 0.0;
+    for (const auto& corner : corridorCorners)
     {
-        auto maxIt = std::max_element(losses.begin(), losses.end());
-        double maxL = *maxIt;
-        if (maxL >= 0)
+        double cornerLoss = DiffractionLoss(txPos, corner, rxPos, false);
+        if (!(cornerLoss > maxL))
         {
-            return maxL;
+            continue;
         }
-        return 0.0;
+        if (IsCornerVisible(corner, tx))
+        {
+            maxL = cornerLoss;
+            if (breakdown)
+            {
+                breakdown->diffractionCorner = corner;
+                breakdown->diffractionAngle = calculateAngle(txPos, corner, rxPos);
+            }
+        }
+    }
+    return maxL;
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::IsCornerVisible(const Vector& corner,
+                                                              const NLOSassess::Endpoint& tx) const
+{
+    LossStatistics::Timer timer(*m_stats, LossStatistics::CORNER_VISIBILITY_PHASE);
+    std::pair<double, double> key(corner.x, corner.y);
+    if (tx.corners)
+    {
+        std::unique_lock<std::mutex> lock;
+        if (tx.cornersMutex)
+        {
+            lock = std::unique_lock<std::mutex>(*tx.cornersMutex);
+        }
+        auto it = tx.corners->find(key);
+        if (it != tx.corners->end())
+        {
+            return it->second;
+        }
+    }
+    // Checked without holding the mutex, a concurrent call may check the corner too
+    m_stats->Add(LossStatistics::CORNERS_EVALUATED);
+    std::vector<uint32_t> blocking;
+    if (m_spatialIndex == GRID_INDEX)
+    {
+        blocking = m_assess->GetBuildingsBetween(corner,
+                                                 tx,
+                                                 *m_city,
+                                                 GetBuildingsAround(corner, tx.position));
+    }
+    else
+    {
+        blocking = m_assess->GetBuildingsBetween(corner, tx, *m_city);
+    }
+    bool visible = blocking.empty();
+    if (tx.corners)
+    {
+        std::unique_lock<std::mutex> lock;
+        if (tx.cornersMutex)
+        {
+            lock = std::unique_lock<std::mutex>(*tx.cornersMutex);
+        }
+        tx.corners->emplace(key, visible);
     }
-    return 0.0;
+    return visible;
 }
 
 double
-FirstOrderBuildingsAwarePropagationLossModel::ReflectionLoss(
-    const std::vector<Ptr<Building>>& AllBuildings,
-    Ptr<MobilityModel> rx,
-    Ptr<MobilityModel> tx) const
+FirstOrderBuildingsAwarePropagationLossModel::ReflectionLoss(const NLOSassess::Endpoint& rx,
+                                                             const NLOSassess::Endpoint& tx,
+                                                             double bound,
+                                                             LossBreakdown* breakdown) const
 {
-    NS_LOG_FUNCTION(this);
+    NS_LOG_FUNCTION(this << bound);
+
+    LossStatistics::Timer timer(*m_stats, LossStatistics::REFLECTION_PHASE);
+    const Vector& rxPos = rx.position;
+    const Vector& txPos = tx.position;
 
     std::vector<double> refl_loss;
-    double refl_coef = 0;
 
-    auto CreateTempMobilityModel = [](Vector position) {
-        Ptr<ConstantPositionMobilityModel> tempMobility =
-            CreateObject<ConstantPositionMobilityModel>();
-        tempMobility->SetPosition(position);
-        return tempMobility;
+    // A reflected path longer than the search length cannot give a loss below the bound
+    auto IsPruned = [this, &txPos, &rxPos](double length, double best) {
+        return ReflectionLossLowerBound(length, txPos.z, rxPos.z) > best + BOUND_MARGIN;
     };
+    double searchLength = std::hypot(txPos.x - rxPos.x, txPos.y - rxPos.y);
+    if (IsPruned(searchLength, bound))
+    {
+        m_stats->Add(LossStatistics::REFLECTIONS_PRUNED);
+        return std::numeric_limits<double>::infinity();
+    }
+    double lo = searchLength;
+    double hi = std::max(2 * searchLength, 1.0);
+    for (int i = 0; (i < 32) && !IsPruned(hi, bound); ++i)
+    {
+        lo = hi;
+        hi *= 2;
+    }
+    searchLength = std::numeric_limits<double>::infinity();
+    if (IsPruned(hi, bound))
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            double mid = 0.5 * (lo + hi);
+            (IsPruned(mid, bound) ? hi : lo) = mid;
+        }
+        searchLength = hi;
+    }
 
-    for (size_t i = 0; i < AllBuildings.size(); ++i)
+    // Facades by increasing path length, the search stops once the lower bound exceeds the best
+    // loss found so far
+    double best = bound;
+    std::vector<uint32_t> evaluated;
+    std::vector<std::pair<double, uint32_t>> facades =
+        m_facades->GetFacadesInEllipse(txPos, rxPos, searchLength);
+    for (size_t k = 0; k < facades.size(); ++k)
     {
+        auto [length, facade] = facades[k];
+        if (IsPruned(length, best))
+        {
+            m_stats->Add(LossStatistics::FACADES_PRUNED, facades.size() - k);
+            break;
+        }
+        uint32_t slot = m_facades->GetFacade(facade).building;
+        if (std::find(evaluated.begin(), evaluated.end(), slot) != evaluated.end())
+        {
+            continue;
+        }
+        evaluated.push_back(slot);
+        m_stats->Add(LossStatistics::REFLECTIONS_EVALUATED);
+
         std::optional<Vector> reflection_point =
-            m_assess->Getreflectionpoint(AllBuildings[i], rx, tx);
+            m_assess->Getreflectionpoint(*m_city, slot, rx, tx);
         if (reflection_point)
         {
             // Check if NLOS conditions are met
-            Ptr<MobilityModel> reflectionMobility = CreateTempMobilityModel(*reflection_point);
-            if (m_assess->GetBuildingsBetween(reflectionMobility, rx, {AllBuildings[i]}).empty() &&
-                m_assess->GetBuildingsBetween(reflectionMobility, tx, {AllBuildings[i]}).empty())
+            if (m_assess->GetBuildingsBetween(*reflection_point, rx, *m_city, {slot}).empty() &&
+                m_assess->GetBuildingsBetween(*reflection_point, tx, *m_city, {slot}).empty())
             {
-                // Assign reflection coefficient based on wall type
-                switch (AllBuildings[i]->GetExtWallsType())
+                // Reflection coefficient based on wall type
+                double refl_coef = m_city->GetReflectionCoefficient(slot);
+                if (refl_coef < 0)
                 {
-                case Building::Wood:
-                    refl_coef = 0.4;
-                    break;
-                case Building::ConcreteWithWindows:
-                    refl_coef = 0.6;
-                    break;
-                case Building::ConcreteWithoutWindows:
-                    refl_coef = 0.61;
-                    break;
-                case Building::StoneBlocks:
-                    refl_coef = 0.9;
-                    break;
-                default:
                     NS_LOG_ERROR(this << " Unknown Wall Type");
                     continue;
                 }
                 // Calculate loss
-                NS_LOG_DEBUG("NLOS reflection at : "
-                             << *reflection_point
-                             << " Tx-reflection-point loss : " << ItuR1411(tx, reflectionMobility)
-                             << " reflection-point-Rx loss : " << ItuR1411(reflectionMobility, rx));
-                // Calculate the 'first half'
-                double first_half = txGain - ItuR1411(tx, reflectionMobility);
-                // Apply attenuation coefficient
-                double rxGain =
-                    (first_half > 0)
-                        ? (first_half * refl_coef - ItuR1411(reflectionMobility, rx))
-                        : (first_half * (1 + (1 - refl_coef)) - ItuR1411(reflectionMobility, rx));
-                double loss = txGain - rxGain;
+                double firstHalfLoss = ItuR1411(txPos, *reflection_point);
+                double secondHalfLoss = ItuR1411(*reflection_point, rxPos);
+                double loss = ReflectedPathLoss(firstHalfLoss, secondHalfLoss, refl_coef);
+                if (std::isnan(loss))
+                {
+                    // Degenerate geometry, both nodes on the line of the wall
+                    continue;
+                }
+                if (breakdown && (loss < breakdown->reflectionLoss))
+                {
+                    // The reflecting wall is the one of the building holding the point
+                    Box box = m_city->GetBounds(slot);
+                    std::array<double, 4> distances = {std::abs(reflection_point->x - box.xMin),
+                                                       std::abs(reflection_point->x - box.xMax),
+                                                       std::abs(reflection_point->y - box.yMin),
+                                                       std::abs(reflection_point->y - box.yMax)};
+                    breakdown->reflectionLoss = loss;
+                    breakdown->reflectionPoint = *reflection_point;
+                    breakdown->reflectionBuilding = m_city->GetId(slot);
+                    breakdown->reflectionWall = static_cast<FacadeIndex::Orientation>(
+                        std::min_element(distances.begin(), distances.end()) - distances.begin());
+                }
                 refl_loss.push_back(loss);
+                best = std::min(best, loss);
             }
         }
     }
@@ -429,27 +1418,134 @@ FirstOrderBuildingsAwarePropagationLossModel::ReflectionLoss(
 }
 
 double
-FirstOrderBuildingsAwarePropagationLossModel::Noise(double loss) const
+FirstOrderBuildingsAwarePropagationLossModel::ReflectedPathLoss(double firstHalfLoss,
+                                                                double secondHalfLoss,
+                                                                double refl_coef) const
+{
+    // Calculate the 'first half'
+    double first_half = txGain - firstHalfLoss;
+    // Apply attenuation coefficient
+    double rxGain = (first_half > 0)
+                        ? (first_half * refl_coef - secondHalfLoss)
+                        : (first_half * (1 + (1 - refl_coef)) - secondHalfLoss);
+    return txGain - rxGain;
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::ReflectionLossLowerBound(double length,
+                                                                       double txHeight,
+                                                                       double rxHeight) const
+{
+    /*
+     * The reflected loss increases with the loss of both halves and decreases with the
+     * reflection coefficient, and ItuR1411 increases with the distance. Splitting the x-y length
+     * of the path into segments, each position of the reflection point along the path is
+     * bounded by the shortest first half and the shortest second half of its segment.
+     */
+    const int segments = 4;
+    std::array<double, segments> firstDistances;
+    std::array<double, segments> secondDistances;
+    for (int k = 0; k < segments; ++k)
+    {
+        double firstHalf = length * k / segments;
+        double secondHalf = length * (segments - k - 1) / segments;
+        firstDistances[k] = std::hypot(firstHalf, txHeight - REFL_HEIGHT);
+        secondDistances[k] = std::hypot(secondHalf, rxHeight - REFL_HEIGHT);
+    }
+    // The heights of each half do not change from a segment to the next
+    std::array<double, segments> firstLosses;
+    std::array<double, segments> secondLosses;
+    ItuR1411(firstDistances, txHeight, REFL_HEIGHT, firstLosses);
+    ItuR1411(secondDistances, REFL_HEIGHT, rxHeight, secondLosses);
+
+    double bound = std::numeric_limits<double>::infinity();
+    for (int k = 0; k < segments; ++k)
+    {
+        double loss = ReflectedPathLoss(firstLosses[k], secondLosses[k], REFL_COEF_MAX);
+        if (std::isnan(loss))
+        {
+            return -std::numeric_limits<double>::infinity();
+        }
+        bound = std::min(bound, loss);
+    }
+    return bound;
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::Noise(double loss,
+                                                    Ptr<MobilityModel> rx,
+                                                    Ptr<MobilityModel> tx) const
 {
     NS_LOG_FUNCTION(this);
 
+    LossStatistics::Timer timer(*m_stats, LossStatistics::NOISE_PHASE);
     double y = 0.25 * loss + 5;
     double top = y * 1.1;
     double bot = y * (1 - .1);
     double borne = std::abs(top - bot);
-    uni_rdm->SetAttribute("Min", DoubleValue(-borne));
-    uni_rdm->SetAttribute("Max", DoubleValue(+borne));
-    return uni_rdm->GetValue();
+    if (m_noiseEngine == PHILOX_NOISE)
+    {
+        // Same scaling as UniformRandomVariable
+        return -borne + 2 * borne * PhiloxDraw(rx, tx);
+    }
+    // Same draw as setting the Min and Max attributes, without changing the random variable
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return uni_rdm->GetValue(-borne, +borne);
 }
 
 double
-FirstOrderBuildingsAwarePropagationLossModel::calculateAngle(Ptr<MobilityModel> rx,
-                                                             Vector B,
-                                                             Ptr<MobilityModel> tx) const
+FirstOrderBuildingsAwarePropagationLossModel::PhiloxDraw(Ptr<MobilityModel> rx,
+                                                         Ptr<MobilityModel> tx) const
+{
+    std::lock_guard<std::mutex> lock(m_noiseMutex);
+    if ((m_noiseStream < 0) && (m_autoNoiseStream == 0))
+    {
+        // Allocated like the stream of a random variable without assigned stream, but only when
+        // the first draw is made so that the other automatic streams do not move
+        m_autoNoiseStream = RngSeedManager::GetNextStreamIndex();
+    }
+    // The stream assigned to the noise, or the automatic one, and the seed and the run of the
+    // simulation
+    uint64_t stream =
+        (m_noiseStream >= 0) ? static_cast<uint64_t>(m_noiseStream) : m_autoNoiseStream;
+    uint64_t key = stream ^ (static_cast<uint64_t>(RngSeedManager::GetSeed()) << 32) ^
+                   (RngSeedManager::GetRun() * 0x9E3779B97F4A7C15ULL);
+
+    uint32_t rxId = GetNoiseId(rx);
+    uint32_t txId = GetNoiseId(tx);
+    return PhiloxUniform({rxId, txId, CountNoiseDraw(rxId, txId), 0}, key);
+}
+
+uint32_t
+FirstOrderBuildingsAwarePropagationLossModel::GetNoiseId(Ptr<MobilityModel> mobility) const
+{
+    Ptr<Node> node = mobility->GetObject<Node>();
+    if (node)
+    {
+        return node->GetId();
+    }
+    auto it = m_noiseIds.find(mobility);
+    if (it == m_noiseIds.end())
+    {
+        uint32_t id = NOISE_ID_OTHER + static_cast<uint32_t>(m_noiseIds.size());
+        it = m_noiseIds.emplace(mobility, id).first;
+    }
+    return it->second;
+}
+
+uint32_t
+FirstOrderBuildingsAwarePropagationLossModel::CountNoiseDraw(uint32_t rxId, uint32_t txId) const
+{
+    // Only the links that drew take memory
+    return m_noiseDraws[(static_cast<uint64_t>(rxId) << 32) | txId]++;
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::calculateAngle(const Vector& A,
+                                                             const Vector& B,
+                                                             const Vector& C) const
 { // Test available at Angletest.cc
 
-    Vector A = rx->GetPosition();
-    Vector C = tx->GetPosition();
     // Vector AB
     double ABx = B.x - A.x;
     double ABy = B.y - A.y;
@@ -477,20 +1573,234 @@ FirstOrderBuildingsAwarePropagationLossModel::DiffFunct(double angle) const
 {
     NS_LOG_FUNCTION(this);
 
-    double a = 0.70;
-    double b = 24.9;
-    double c = 3.555;
-    double d = 31.7;
+    double a = DIFF_A;
+    double b = DIFF_B;
+    double c = DIFF_C;
+    double d = DIFF_D;
     return -a / (exp((angle / b) - c)) + d;
 }
 
 double
-FirstOrderBuildingsAwarePropagationLossModel::ItuR1411(Ptr<MobilityModel> rx,
-                                                       Ptr<MobilityModel> tx) const
+FirstOrderBuildingsAwarePropagationLossModel::DiffractionLoss(const Vector& tx,
+                                                              const Vector& corner,
+                                                              const Vector& rx,
+                                                              bool shadowed) const
+{
+    if (m_diffractionMode == EXACT_DIFFRACTION)
+    {
+        double theta = calculateAngle(tx, corner, rx);
+        return DiffFunct(shadowed ? theta : -theta);
+    }
+    // Same directions as calculateAngle, in the x-y plan
+    double abx = corner.x - tx.x;
+    double aby = corner.y - tx.y;
+    double bcx = rx.x - corner.x;
+    double bcy = rx.y - corner.y;
+    double dot = abx * bcx + aby * bcy;
+    double cross = abx * bcy - aby * bcx;
+    return (shadowed ? m_nlosDiffraction : m_losDiffraction).GetLoss(dot, cross);
+}
+
+bool
+FirstOrderBuildingsAwarePropagationLossModel::IsInDiffractionCorridor(const Vector& point,
+                                                                      const Vector& a,
+                                                                      const Vector& b) const
+{
+    /*
+     * DiffFunct(theta) is negative below theta_0 = b * (c + ln(a / d)) (about -6.4 deg), so a
+     * LOS corner only matters if the path a -> corner -> b deviates by less than |theta_0|.
+     * These corners lie between two circle arcs through a and b, inside the strip of half width
+     * |ab| / 2 * tan(|theta_0| / 2) around the segment.
+     */
+    static const double corridorSlope =
+        0.5 * std::tan(-0.5 * DIFF_B * (DIFF_C + std::log(DIFF_A / DIFF_D)) * M_PI / 180.0);
+
+    double abx = b.x - a.x;
+    double aby = b.y - a.y;
+    double apx = point.x - a.x;
+    double apy = point.y - a.y;
+    double length2 = abx * abx + aby * aby;
+    double along = apx * abx + apy * aby;
+    if ((along < 0) || (along > length2))
+    {
+        return false;
+    }
+    // |cross| / |ab| <= |ab| * slope, with a small margin for rounding errors
+    double cross = std::abs(abx * apy - aby * apx);
+    return cross <= length2 * corridorSlope * (1 + 1e-9);
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::ItuR1411(const Vector& rx, const Vector& tx) const
+{
+    NS_LOG_FUNCTION(this);
+
+    return ItuR1411(CalculateDistance(rx, tx), rx.z, tx.z);
+}
+
+/**
+ * @brief Get the loss according to ItuR1411 from the distance and the breakpoint of the heights
+ *
+ * Same operations as ItuR1411LosPropagationLossModel::GetLoss, so the losses are the same to the
+ * last bit.
+ *
+ * @param distance distance between the nodes (in m)
+ * @param Lbp loss at the breakpoint (in dB)
+ * @param Rbp distance of the breakpoint (in m)
+ * @returns loss (in dB)
+ */
+static inline double
+ItuR1411FromBreakpoint(double distance, double Lbp, double Rbp)
+{
+    double ratio = std::log10(distance / Rbp);
+    double lossLow = 0;
+    double lossUp = 0;
+    if (distance <= Rbp)
+    {
+        lossLow = Lbp + 20 * ratio;
+        lossUp = Lbp + 20 + 25 * ratio;
+    }
+    else
+    {
+        lossLow = Lbp + 40 * ratio;
+        lossUp = Lbp + 20 + 40 * ratio;
+    }
+    return (lossLow + lossUp) / 2;
+}
+
+double
+FirstOrderBuildingsAwarePropagationLossModel::ItuR1411(double distance,
+                                                       double hb,
+                                                       double hm) const
+{
+    double Lbp = std::fabs(20 * std::log10(m_lambdaSquared / (8 * M_PI * hb * hm)));
+    double Rbp = (4 * hb * hm) / m_lambda;
+    return ItuR1411FromBreakpoint(distance, Lbp, Rbp);
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::ItuR1411(std::span<const double> distances,
+                                                       double hb,
+                                                       double hm,
+                                                       std::span<double> out) const
+{
+    NS_ASSERT_MSG(distances.size() == out.size(), "ItuR1411 needs one output per distance");
+    double Lbp = std::fabs(20 * std::log10(m_lambdaSquared / (8 * M_PI * hb * hm)));
+    double Rbp = (4 * hb * hm) / m_lambda;
+    for (size_t i = 0; i < distances.size(); ++i)
+    {
+        out[i] = ItuR1411FromBreakpoint(distances[i], Lbp, Rbp);
+    }
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::UpdateCitySnapshot() const
+{
+    // Same test as CitySnapshot::Update, on the values seen by the last call, without the lock
+    const uint32_t n = BuildingList::GetNBuildings();
+    const Building* first = (n > 0) ? PeekPointer(*BuildingList::Begin()) : nullptr;
+    if (m_snapshotReady.load(std::memory_order_acquire) &&
+        (m_snapshotBuildings.load(std::memory_order_relaxed) == n) &&
+        (m_snapshotFirst.load(std::memory_order_relaxed) == first) &&
+        (m_snapshotIndex.load(std::memory_order_relaxed) == m_spatialIndex))
+    {
+        return;
+    }
+
+    NS_LOG_FUNCTION(this);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_city->Update())
+    {
+        // The cached links were computed with the previous buildings
+        m_linkCache->Clear();
+        m_radioMaps->Clear();
+        m_lossFileChecked = false;
+    }
+    CheckLossFile();
+    uint32_t version = m_city->GetVersion();
+    bool gridStale =
+        (m_spatialIndex == GRID_INDEX) && (!m_grid || (m_grid->GetVersion() != version));
+    if (gridStale)
+    {
+        if (!m_grid)
+        {
+            m_grid = CreateObject<BuildingGridIndex>();
+        }
+        m_grid->Build(*m_city, m_gridCellSize);
+    }
+    if (gridStale || !m_facades || (m_facades->GetVersion() != version))
+    {
+        if (!m_facades)
+        {
+            m_facades = CreateObject<FacadeIndex>();
+        }
+        m_facades->Build(*m_city, (m_spatialIndex == GRID_INDEX) ? m_grid : nullptr);
+    }
+
+    // Published once the indexes are built and the loss file is checked
+    m_snapshotBuildings.store(n, std::memory_order_relaxed);
+    m_snapshotFirst.store(first, std::memory_order_relaxed);
+    m_snapshotIndex.store(m_spatialIndex, std::memory_order_relaxed);
+    m_snapshotReady.store(true, std::memory_order_release);
+}
+
+void
+FirstOrderBuildingsAwarePropagationLossModel::CheckLossFile() const
 {
+    if (!m_lossFile || m_lossFileChecked)
+    {
+        return;
+    }
     NS_LOG_FUNCTION(this);
+    std::string reason;
+    NS_ABORT_MSG_UNLESS(m_lossFile->Check(m_frequency, txGain, m_diffractionMode, reason),
+                        "Loss file " << m_lossFilePath << " does not match the scenario: "
+                                     << reason);
+    NS_LOG_INFO("Serving the losses of " << m_lossFile->GetNNodes() << " nodes from "
+                                         << m_lossFilePath);
+    m_lossFileChecked = true;
+}
+
+std::vector<uint32_t>
+FirstOrderBuildingsAwarePropagationLossModel::GetIntersectedBuildings(const Vector& a,
+                                                                      const Vector& b) const
+{
+    NS_LOG_FUNCTION(this << a << b);
+
+    LossStatistics::Timer timer(*m_stats, LossStatistics::BUILDING_SCAN_PHASE);
+    std::vector<uint32_t> NLOSBuildings;
+    if (m_spatialIndex == GRID_INDEX)
+    {
+        NLOSBuildings = m_grid->GetSegmentCandidates(a, b);
+        m_stats->Add(LossStatistics::BUILDINGS_TESTED, NLOSBuildings.size());
+        m_stats->Add(LossStatistics::BUILDINGS_PRUNED,
+                     m_city->GetNBuildings() - NLOSBuildings.size());
+        m_city->FilterIntersected(a, b, NLOSBuildings);
+    }
+    else
+    {
+        m_stats->Add(LossStatistics::BUILDINGS_TESTED, m_city->GetNBuildings());
+        NLOSBuildings = m_city->GetIntersected(a, b);
+    }
+    // Back to BuildingList order
+    std::sort(NLOSBuildings.begin(), NLOSBuildings.end(), [this](uint32_t x, uint32_t y) {
+        return m_city->GetId(x) < m_city->GetId(y);
+    });
+    return NLOSBuildings;
+}
+
+std::vector<uint32_t>
+FirstOrderBuildingsAwarePropagationLossModel::GetBuildingsAround(const Vector& a,
+                                                                 const Vector& b) const
+{
+    NS_LOG_FUNCTION(this << a << b);
+    NS_ASSERT_MSG(m_spatialIndex == GRID_INDEX, "No spatial index to look the buildings up in");
 
-    return m_ituR1411Los->GetLoss(rx, tx);
+    return m_grid->GetBoxCandidates(std::min(a.x, b.x),
+                                    std::max(a.x, b.x),
+                                    std::min(a.y, b.y),
+                                    std::max(a.y, b.y));
 }
 
 } // namespace ns3
@@ -9,17 +9,36 @@
 #ifndef FIRST_ORDER_DETERMINISTIC_PATHLOSS_H
 #define FIRST_ORDER_DETERMINISTIC_PATHLOSS_H
 
+#include "foba-city-snapshot.h"
+#include "foba-diffraction-table.h"
+#include "foba-facade-index.h"
+#include "foba-grid-index.h"
+#include "foba-link-cache.h"
+#include "foba-loss-file.h"
+#include "foba-loss-stats.h"
+#include "foba-philox.h"
+#include "foba-radio-map.h"
+#include "foba-thread-pool.h"
 #include "foba-toolbox.h"
+#include "foba-zone-cache.h"
 
 #include "ns3/boolean.h"
 #include "ns3/propagation-environment.h"
 #include "ns3/propagation-loss-model.h"
+#include "ns3/traced-callback.h"
+
+#include <atomic>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace ns3
 {
 
-class ItuR1411LosPropagationLossModel;
-
 /**
  * @ingroup buildings
  *
@@ -34,6 +53,14 @@ class ItuR1411LosPropagationLossModel;
  * of the signal with buildings, however, it has a level of abstraction, it does not reflect
  * the exact behavior that the signal would have in real life.
  *
+ * GetLoss can be called by several threads at the same time: the geometry only works on copies of
+ * the positions, and the building snapshot, the caches and the random variable are shared under a
+ * mutex, only taken when they are used or when the buildings changed. The calls running at the
+ * same time must not share a mobility model, as the reference count of a Ptr is not atomic, and
+ * the buildings, the positions of their nodes and the attributes must not change meanwhile. The
+ * noise of concurrent calls is drawn in the order they reach the random variable, unless the
+ * NoiseEngine is Philox.
+ *
  */
 
 class FirstOrderBuildingsAwarePropagationLossModel : public PropagationLossModel
@@ -44,6 +71,84 @@ class FirstOrderBuildingsAwarePropagationLossModel : public PropagationLossModel
      * @return The object TypeId.
      */
     static TypeId GetTypeId();
+
+    /**
+     * @brief Spatial index used to select the buildings to evaluate
+     */
+    enum SpatialIndexType
+    {
+        NO_INDEX,  ///< every building of the BuildingList is evaluated
+        GRID_INDEX ///< only the buildings of the grid cells crossed by the link are evaluated
+    };
+
+    /**
+     * @brief Generator of the noise draws
+     */
+    enum NoiseEngineType
+    {
+        RNG_STREAM_NOISE, ///< the draws follow each other in the stream of a random variable
+        PHILOX_NOISE      ///< each draw is keyed by the stream, the link and its number of draws
+    };
+
+    /**
+     * @brief Evaluation of the diffraction loss of a corner
+     */
+    enum DiffractionModeType
+    {
+        EXACT_DIFFRACTION, ///< the angle is computed, then the loss
+        TABLE_DIFFRACTION  ///< the loss is interpolated from a table (see DiffractionTable)
+    };
+
+    /**
+     * @brief Path giving the loss of a link
+     */
+    enum PathType
+    {
+        FAR_PATH,         ///< ITU-R 1411 loss above 90 dB, the buildings are not looked at
+        LOS_PATH,         ///< clear direct path, with the diffraction of the corners near it
+        PENETRATION_PATH, ///< direct path through the buildings
+        DIFFRACTION_PATH, ///< path diffracted by a corner of a building
+        REFLECTION_PATH,  ///< path reflected by a wall of a building
+        STORED_PATH       ///< loss from the loss file, the link cache or a radio map
+    };
+
+    /**
+     * @brief Terms of the loss of a link, given by the LossBreakdown trace source
+     *
+     * A term that was not computed for the link keeps its default value.
+     */
+    struct LossBreakdown
+    {
+        PathType path{STORED_PATH}; ///< path giving the loss
+        /// ITU-R 1411 loss of the direct path (in dB), NaN for a stored loss
+        double ituLoss{std::numeric_limits<double>::quiet_NaN()};
+        double penetrationLoss{0.0}; ///< loss of the walls crossed by the direct path (in dB)
+        /// Loss of the diffraction corner over ituLoss (in dB), +infinity if none was evaluated
+        double diffractionLoss{std::numeric_limits<double>::infinity()};
+        Vector diffractionCorner; ///< corner of the diffracted path
+        /// Deviation of the diffracted path at the corner (in degrees), NaN if none
+        double diffractionAngle{std::numeric_limits<double>::quiet_NaN()};
+        /// Loss of the reflected path (in dB), +infinity if none was evaluated
+        double reflectionLoss{std::numeric_limits<double>::infinity()};
+        Vector reflectionPoint; ///< reflection point of the reflected path
+        /// Id of the reflecting building in the BuildingList, max if none
+        uint32_t reflectionBuilding{std::numeric_limits<uint32_t>::max()};
+        FacadeIndex::Orientation reflectionWall{FacadeIndex::X_MIN}; ///< reflecting wall
+        double noise{0.0};                                            ///< noise (in dB)
+        double loss{std::numeric_limits<double>::quiet_NaN()}; ///< loss given by GetLoss (in dB)
+    };
+
+    /**
+     * TracedCallback signature for the terms of the loss of a link.
+     *
+     * @param [in] rx the mobility model of the destination
+     * @param [in] tx the mobility model of the source
+     * @param [in] breakdown the terms of the loss
+     */
+    typedef void (*LossBreakdownTracedCallback)(Ptr<const MobilityModel> rx,
+                                                Ptr<const MobilityModel> tx,
+                                                const LossBreakdown& breakdown);
+
     FirstOrderBuildingsAwarePropagationLossModel();
     ~FirstOrderBuildingsAwarePropagationLossModel() override;
 
@@ -54,6 +159,12 @@ class FirstOrderBuildingsAwarePropagationLossModel : public PropagationLossModel
      */
     void SetFrequency(double freq);
 
+    /**
+     * @brief Get the propagation frequency
+     * @return the frequency (in Hz)
+     */
+    double GetFrequency() const;
+
     /**
      * set the emmittsing power
      *
@@ -61,6 +172,12 @@ class FirstOrderBuildingsAwarePropagationLossModel : public PropagationLossModel
      */
     void SetGain(double gain);
 
+    /**
+     * @brief Get the emitting gain
+     * @return the gain (in dB)
+     */
+    double GetGain() const;
+
     /**
      * \brief Enable or disable noise addition to the path loss
      * \param enabled true to enable noise, false to disable
@@ -73,17 +190,412 @@ class FirstOrderBuildingsAwarePropagationLossModel : public PropagationLossModel
      */
     bool GetNoiseEnabled() const;
 
+    /**
+     * @brief Enable or disable the cache of the zones of the nodes relatively to the buildings
+     * @param enabled true to enable the cache, false to disable it
+     */
+    void SetZoneCacheEnabled(bool enabled);
+
+    /**
+     * @brief Get the current zone cache enabled state
+     * @return true if the zone cache is enabled, false otherwise
+     */
+    bool GetZoneCacheEnabled() const;
+
+    /**
+     * @brief Set the number of corners whose visibility from a static node is kept by the zone
+     * cache
+     * @param maxCorners the number of corners
+     */
+    void SetZoneCacheMaxCorners(uint32_t maxCorners);
+
+    /**
+     * @brief Get the number of corners whose visibility from a static node is kept by the zone
+     * cache
+     * @return the number of corners
+     */
+    uint32_t GetZoneCacheMaxCorners() const;
+
+    /**
+     * @brief Enable or disable the cache of the deterministic loss of the links
+     * @param enabled true to enable the cache, false to disable it
+     */
+    void SetLinkCacheEnabled(bool enabled);
+
+    /**
+     * @brief Get the current link cache enabled state
+     * @return true if the link cache is enabled, false otherwise
+     */
+    bool GetLinkCacheEnabled() const;
+
+    /**
+     * @brief Set the maximum number of links in the link cache
+     * @param maxEntries the maximum number of links
+     */
+    void SetLinkCacheMaxEntries(uint32_t maxEntries);
+
+    /**
+     * @brief Get the maximum number of links in the link cache
+     * @return the maximum number of links
+     */
+    uint32_t GetLinkCacheMaxEntries() const;
+
+    /**
+     * @brief Get the link cache, to read its hit, miss and eviction counts
+     * @return the link cache
+     */
+    Ptr<LinkLossCache> GetLinkCache() const;
+
+    /**
+     * @brief Enable or disable the radio maps of the fixed nodes (see RadioMapCache)
+     * @param enabled true to interpolate the losses between a fixed node, with a
+     * ConstantPositionMobilityModel, and a node with another mobility model
+     */
+    void SetRadioMapEnabled(bool enabled);
+
+    /**
+     * @brief Get the current radio map enabled state
+     * @return true if the radio maps are enabled, false otherwise
+     */
+    bool GetRadioMapEnabled() const;
+
+    /**
+     * @brief Set the edge length of the cells of the radio maps
+     * @param resolution the edge length (in m)
+     */
+    void SetRadioMapResolution(double resolution);
+
+    /**
+     * @brief Get the edge length of the cells of the radio maps
+     * @return the edge length (in m)
+     */
+    double GetRadioMapResolution() const;
+
+    /**
+     * @brief Set the largest spread of the losses of the vertices of an interpolated cell
+     * @param tolerance the spread (in dB)
+     */
+    void SetRadioMapTolerance(double tolerance);
+
+    /**
+     * @brief Get the largest spread of the losses of the vertices of an interpolated cell
+     * @return the spread (in dB)
+     */
+    double GetRadioMapTolerance() const;
+
+    /**
+     * @brief Set the distance between the layers of the radio maps
+     * @param height the distance (in m)
+     */
+    void SetRadioMapLayerHeight(double height);
+
+    /**
+     * @brief Get the distance between the layers of the radio maps
+     * @return the distance (in m)
+     */
+    double GetRadioMapLayerHeight() const;
+
+    /**
+     * @brief Set the number of vertices of all the radio maps above which the maps are dropped
+     * @param vertices the number of vertices
+     */
+    void SetRadioMapMaxVertices(uint64_t vertices);
+
+    /**
+     * @brief Get the number of vertices of all the radio maps above which the maps are dropped
+     * @return the number of vertices
+     */
+    uint64_t GetRadioMapMaxVertices() const;
+
+    /**
+     * @brief Get the radio maps, to read their vertex and lookup counts
+     * @return the radio maps
+     */
+    Ptr<RadioMapCache> GetRadioMaps() const;
+
+    /**
+     * @brief Serve the losses of the nodes of a loss file (see LossMatrixFile)
+     *
+     * The file is checked against the buildings, the nodes, the frequency and the gain on the next
+     * loss computation, and the simulation is aborted if they differ.
+     *
+     * @param path the loss file, empty to compute all the losses
+     */
+    void SetLossFile(const std::string& path);
+
+    /**
+     * @brief Get the loss file serving the losses
+     * @return the path of the file, empty if none
+     */
+    std::string GetLossFile() const;
+
+    /**
+     * @brief Set the number of threads computing the losses of a GetLossBatch,
+     * GetDeterministicLossBatch or GetDeterministicLossMatrix call
+     *
+     * The other calls, GetLoss and CalcRxPower included, run in the calling thread. The batches
+     * started by several threads at the same time run one after the other.
+     *
+     * @param count the number of threads, the calling thread included
+     */
+    void SetThreadCount(uint32_t count);
+
+    /**
+     * @brief Get the number of threads computing the losses of a batch
+     * @return the number of threads, the calling thread included
+     */
+    uint32_t GetThreadCount() const;
+
+    /**
+     * @brief Set the evaluation of the diffraction loss of the corners
+     * @param mode EXACT_DIFFRACTION, or TABLE_DIFFRACTION to interpolate the loss without acos
+     * and exp, the tables being built on the first use of this mode
+     */
+    void SetDiffractionMode(DiffractionModeType mode);
+
+    /**
+     * @return the evaluation of the diffraction loss of the corners
+     */
+    DiffractionModeType GetDiffractionMode() const;
+
+    /**
+     * @return the largest error of the diffraction loss of a corner (in dB), 0 in the exact mode
+     */
+    double GetDiffractionMaxError() const;
+
+    /**
+     * @brief Enable or disable the collection of the counters and latency histograms of the
+     * loss computation, the collected ones are kept
+     * @param enabled true to collect the statistics
+     */
+    void SetStatsEnabled(bool enabled);
+
+    /**
+     * @return true if the statistics of the loss computation are collected
+     */
+    bool GetStatsEnabled() const;
+
+    /**
+     * @brief Set the file to which the statistics are written at Simulator::Destroy
+     * @param path the path of the file, empty to not write them
+     */
+    void SetStatsFile(const std::string& path);
+
+    /**
+     * @return the file to which the statistics are written at Simulator::Destroy
+     */
+    std::string GetStatsFile() const;
+
+    /**
+     * @return the counters and latency histograms of the loss computation
+     */
+    Ptr<LossStatistics> GetStatistics() const;
+
+    /**
+     * @brief Take into account the changes of the buildings already in the BuildingList
+     *
+     * The model works on a snapshot of the BuildingList (see CitySnapshot), taken again on the
+     * next loss computation when buildings were added or the BuildingList was created again after
+     * Simulator::Destroy. Changing the bounds or the wall type of a building after a loss was
+     * computed is not detected, this call is needed after such changes.
+     */
+    void NotifyBuildingsChanged();
+
     /**
      * @brief Compute the path loss according to the nodes position
      * and the presence or not of buildings in between.
      *
+     * The terms of the loss are given to the LossBreakdown trace source, and only computed when a
+     * sink is connected to it.
+     *
      * @param rx the mobility model of the destination
      * @param tx the mobility model of the source
      * @returns the propagation loss (in dB)
      */
     double GetLoss(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx) const;
 
+    /**
+     * @brief Bound the path loss from below without looking at the buildings.
+     *
+     * The loss of a link is at least the ITU-R 1411 loss of the direct path, unless a reflection
+     * on a facade gives a lower loss, which is itself bounded from the length of the link. A link
+     * whose bound is above the loss that the receiver tolerates can be discarded without
+     * computing its loss. The bound does not hold for the losses interpolated from a radio map.
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @returns a lower bound of the loss given by GetLoss, noise included (in dB)
+     */
+    double GetLossLowerBound(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx) const;
+
+    /**
+     * @brief Compute the path loss without the noise.
+     *
+     * With the link cache enabled, the loss of a link between two static nodes is only computed
+     * once for each direction, until one of the nodes changes its course.
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @returns the propagation loss before noise (in dB)
+     */
+    double GetDeterministicLoss(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx) const;
+
+    /**
+     * @brief Compute the path loss from one source to several destinations.
+     *
+     * Gives the same losses, noise included, as calling GetLoss for each destination in turn,
+     * but the source is only located once and the visibility of the building corners from it is
+     * shared by the destinations. With several threads (see SetThreadCount), the losses missing
+     * from the link cache are computed in parallel, then the noise is drawn in the order of the
+     * destinations.
+     *
+     * @param tx the mobility model of the source
+     * @param rx the mobility models of the destinations
+     * @param out set to the propagation loss (in dB) for each destination
+     */
+    void GetLossBatch(Ptr<MobilityModel> tx,
+                      std::span<const Ptr<MobilityModel>> rx,
+                      std::span<double> out) const;
+
+    /**
+     * @brief Compute the path loss without the noise from one source to several positions.
+     *
+     * The positions are computed by the threads of the model (see SetThreadCount), sharing the
+     * visibility of the building corners from the source. The caches are not used for the
+     * positions, which are not nodes.
+     *
+     * @param tx the mobility model of the source
+     * @param rx the positions of the destinations
+     * @param out set to the propagation loss before noise (in dB) for each position
+     */
+    void GetDeterministicLossBatch(Ptr<MobilityModel> tx,
+                                   std::span<const Vector> rx,
+                                   std::span<double> out) const;
+
+    /**
+     * @brief Compute the path loss without the noise between all the pairs of a set of nodes.
+     *
+     * The pairs are split in tiles of tileSize destinations by tileSize sources, computed by the
+     * threads of the model (see SetThreadCount). The visibility of the building corners from
+     * each source is shared by the tiles computed by a same thread. The caches are not used.
+     *
+     * @param nodes the mobility models of the nodes
+     * @param out set to GetDeterministicLoss(nodes[i], nodes[j]) (in dB) at i * nodes.size() + j,
+     * 0 for i = j
+     * @param tileSize number of destinations and of sources in a tile
+     */
+    void GetDeterministicLossMatrix(std::span<const Ptr<MobilityModel>> nodes,
+                                    std::span<double> out,
+                                    uint32_t tileSize) const;
+
   private:
+    /**
+     * @brief Compute the path loss without the noise, the source being already located
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @param txEndpoint the source, as given by GetEndpoint
+     * @param breakdown filled with the terms of the loss, or nullptr
+     * @returns the propagation loss before noise (in dB)
+     */
+    double GetDeterministicLoss(Ptr<MobilityModel> rx,
+                                Ptr<MobilityModel> tx,
+                                const NLOSassess::Endpoint& txEndpoint,
+                                LossBreakdown* breakdown = nullptr) const;
+
+    /**
+     * @brief Get the loss without the noise of a link from the loss file or the link cache
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @param loss set to the loss (in dB) if found
+     * @returns false if the link has to be computed
+     */
+    bool LookupLoss(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx, double& loss) const;
+
+    /**
+     * @brief Tell if the loss of a link may be interpolated from a radio map
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @returns true if the radio maps are enabled and only one of the nodes is fixed, a fixed node
+     * having a ConstantPositionMobilityModel: a moving node that pauses does not get a map
+     */
+    bool IsRadioMapLink(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx) const;
+
+    /**
+     * @brief Interpolate the loss without the noise of a link between a fixed node and a moving
+     * node from the radio map of the fixed node
+     *
+     * Only called on the links accepted by IsRadioMapLink.
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @param txEndpoint the source, located by GetEndpoint
+     * @param loss set to the loss (in dB) if interpolated
+     * @returns false if the link has to be computed
+     */
+    bool InterpolateLoss(Ptr<MobilityModel> rx,
+                         Ptr<MobilityModel> tx,
+                         const NLOSassess::Endpoint& txEndpoint,
+                         double& loss) const;
+
+    /**
+     * @brief Abort if the loss file does not match the scenario, once per change of the scenario
+     */
+    void CheckLossFile() const;
+
+    /**
+     * @brief Locate a node, with its zones and corners from the zone cache if it is enabled
+     *
+     * @param node the mobility model of the node
+     * @param corners the corner visibility to use if the zone cache does not keep one for the
+     * node, may be nullptr
+     * @returns the node
+     */
+    NLOSassess::Endpoint GetEndpoint(Ptr<MobilityModel> node,
+                                     NLOSassess::CornerVisibility* corners) const;
+
+    /**
+     * @brief Check if there is no building between a building corner and the source
+     *
+     * The result is kept in the corner visibility of the source, if it has one.
+     *
+     * @param corner the corner
+     * @param tx the source
+     * @returns true if the corner is visible from the source
+     */
+    bool IsCornerVisible(const Vector& corner, const NLOSassess::Endpoint& tx) const;
+
+    /**
+     * @brief Copy the corners already checked from the source, for the threads of a batch
+     *
+     * @param tx the source, located by GetEndpoint with its own corner visibility
+     * @returns one copy of the visibility of the corners for each thread of the pool
+     */
+    std::vector<NLOSassess::CornerVisibility> CopyCorners(const NLOSassess::Endpoint& tx) const;
+
+    /**
+     * @brief Add the corners checked by the threads of a batch to the visibility of the source
+     *
+     * @param tx the source, located by GetEndpoint with its own corner visibility
+     * @param threadCorners the visibility of the corners completed by each thread
+     */
+    void MergeCorners(const NLOSassess::Endpoint& tx,
+                      const std::vector<NLOSassess::CornerVisibility>& threadCorners) const;
+
+    /**
+     * @brief Compute the path loss without the noise between two nodes
+     *
+     * @param rx the destination
+     * @param tx the source
+     * @param breakdown filled with the terms of the loss, or nullptr
+     * @returns the propagation loss before noise (in dB)
+     */
+    double DoGetDeterministicLoss(const NLOSassess::Endpoint& rx,
+                                  const NLOSassess::Endpoint& tx,
+                                  LossBreakdown* breakdown = nullptr) const;
+
     /**
      * Computes the received power by applying the pathloss model
      *
@@ -107,13 +619,15 @@ class FirstOrderBuildingsAwarePropagationLossModel : public PropagationLossModel
      */
     int64_t DoAssignStreams(int64_t stream) override;
 
+    void DoDispose() override;
+
     /**
      * @brief Compute the path loss with additionnal loss for all walls traversed.
      *
-     * @param NLOSBuildings the buildings between the sight of the two nodes
+     * @param NLOSBuildings the slots of the buildings between the sight of the two nodes
      * @returns the penetration loss (in dB)
      */
-    double PenetrationLoss(const std::vector<Ptr<Building>>& NLOSBuildings) const;
+    double PenetrationLoss(const std::vector<uint32_t>& NLOSBuildings) const;
 
     /**
      * @brief Compute the path loss that is diffracted by a building with positive angles.
@@ -127,58 +641,126 @@ class FirstOrderBuildingsAwarePropagationLossModel : public PropagationLossModel
      * do so, we return a +infinity loss value so that when it is compare to penetration and
      * reflection we are sure it wont be selected.
      *
-     * @param NLOSBuildings the buildings between the sight of the two nodes
-     * @param AllBuildings List of all the buildings in the simulation
-     * @param rx the mobility model of the destination
-     * @param tx the mobility model of the source
+     * @param NLOSBuildings the slots of the buildings between the sight of the two nodes, in
+     * BuildingList order
+     * @param rx the destination
+     * @param tx the source
+     * @param breakdown given the loss, corner and angle of the diffraction, or nullptr
      * @returns the diffraction loss (in dB)
      */
-    double NLOSDiffractionLoss(const std::vector<Ptr<Building>>& NLOSBuildings,
-                               const std::vector<Ptr<Building>>& AllBuildings,
-                               Ptr<MobilityModel> rx,
-                               Ptr<MobilityModel> tx) const;
+    double NLOSDiffractionLoss(const std::vector<uint32_t>& NLOSBuildings,
+                               const NLOSassess::Endpoint& rx,
+                               const NLOSassess::Endpoint& tx,
+                               LossBreakdown* breakdown) const;
 
     /**
      * @brief Compute the path loss that is diffracted by the building(s) with negative angles
      *
-     * @param AllBuildings the buildings between the sight of the two nodes
-     * @param rx the mobility model of the destination
-     * @param tx the mobility model of the source
+     * Only the corners lying in the corridor around the line of sight (see
+     * IsInDiffractionCorridor) are evaluated, the other ones would give a negative loss, which is
+     * discarded.
+     *
+     * @param rx the destination
+     * @param tx the source
+     * @param breakdown given the loss, corner and angle of the diffraction, or nullptr
      * @returns the diffraction loss (in dB)
      */
-    double LOSDiffractionLoss(const std::vector<Ptr<Building>>& AllBuildings,
-                              Ptr<MobilityModel> rx,
-                              Ptr<MobilityModel> tx) const;
+    double LOSDiffractionLoss(const NLOSassess::Endpoint& rx,
+                              const NLOSassess::Endpoint& tx,
+                              LossBreakdown* breakdown) const;
 
     /**
      * @brief Compute the path loss that is reflected on the building(s)
      *
-     * @param AllBuildings All the buildings in the simulation
-     * @param rx the mobility model of the destination
-     * @param tx the mobility model of the source
-     * @returns the reflection loss (in dB)
+     * The facades are evaluated by increasing length of the reflected path, and only while a
+     * path of that length can give a loss below both the bound and the best reflection found so
+     * far (see ReflectionLossLowerBound). The facades are taken from the ellipse of foci rx and tx
+     * whose major axis is the longest such path.
+     *
+     * @param rx the destination
+     * @param tx the source
+     * @param bound loss above which a reflection would not be selected (in dB)
+     * @param breakdown given the loss, point, building and wall of the best reflection, or nullptr
+     * @returns the reflection loss (in dB), +infinity if no reflection gives a loss below the bound
+     */
+    double ReflectionLoss(const NLOSassess::Endpoint& rx,
+                          const NLOSassess::Endpoint& tx,
+                          double bound,
+                          LossBreakdown* breakdown) const;
+
+    /**
+     * @brief Loss of a reflected path from the loss of its two halves
+     *
+     * @param firstHalfLoss loss between the source and the reflection point (in dB)
+     * @param secondHalfLoss loss between the reflection point and the destination (in dB)
+     * @param refl_coef reflection coefficient of the wall
+     * @returns the reflected path loss (in dB)
      */
-    double ReflectionLoss(const std::vector<Ptr<Building>>& AllBuildings,
-                          Ptr<MobilityModel> rx,
-                          Ptr<MobilityModel> tx) const;
+    double ReflectedPathLoss(double firstHalfLoss, double secondHalfLoss, double refl_coef) const;
+
+    /**
+     * @brief Lower bound of the loss of any reflected path of a given length in the x-y plan
+     *
+     * @param length length of the reflected path in the x-y plan (in m)
+     * @param txHeight height of the source (in m)
+     * @param rxHeight height of the destination (in m)
+     * @returns the lower bound (in dB), increasing with the length
+     */
+    double ReflectionLossLowerBound(double length, double txHeight, double rxHeight) const;
 
     /**
      * @brief Adds noise to the loss, proportionnaly to it's strength
      *
      * @param loss the loss to apply to the signal
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
      * @returns the propagation loss (in dB)
      */
-    double Noise(double loss) const;
+    double Noise(double loss, Ptr<MobilityModel> rx, Ptr<MobilityModel> tx) const;
+
+    /**
+     * @brief Draw a uniform value of the Philox noise engine for a link
+     *
+     * The counter of the draw holds the identifiers of the nodes and the number of draws already
+     * made for the link, so the draws of a link do not depend on the draws of the other links.
+     * Without a stream given to AssignStreams, the key uses an automatic stream of the
+     * RngSeedManager, so the models do not draw the same noise.
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @returns a uniform value in [0, 1)
+     */
+    double PhiloxDraw(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx) const;
+
+    /**
+     * @brief Get the identifier of a node in the counters of the Philox noise engine
+     *
+     * Called with m_noiseMutex held.
+     *
+     * @param mobility the mobility model of the node
+     * @returns the id of the node aggregating the mobility model, or for a mobility model without
+     * node, 2^31 plus its rank in the order the mobility models are met
+     */
+    uint32_t GetNoiseId(Ptr<MobilityModel> mobility) const;
+
+    /**
+     * @brief Count a Philox noise draw of a link, called with m_noiseMutex held
+     *
+     * @param rxId noise id of the destination (see GetNoiseId)
+     * @param txId noise id of the source
+     * @returns the number of draws of the link before this one
+     */
+    uint32_t CountNoiseDraw(uint32_t rxId, uint32_t txId) const;
 
     /**
      * @brief Calculate the angle between AB and BC on the x-y plan
      *
-     * @param rx a 3D point
+     * @param A a 3D point
      * @param B a 3D point
-     * @param tx a 3D point
+     * @param C a 3D point
      * @returns The angle (in degrees) between AB and BC
      */
-    double calculateAngle(Ptr<MobilityModel> rx, Vector B, Ptr<MobilityModel> tx) const;
+    double calculateAngle(const Vector& A, const Vector& B, const Vector& C) const;
 
     /**
      * @brief Signal attenuation as a function of the shadowing angle
@@ -189,22 +771,161 @@ class FirstOrderBuildingsAwarePropagationLossModel : public PropagationLossModel
     double DiffFunct(double angle) const;
 
     /**
-     * @brief Get the loss between two node according to ItuR1411
+     * @brief Get the diffraction loss of a corner, in the mode selected by DiffractionMode
      *
-     * @param rx the mobility model of the destination
-     * @param tx the mobility model of the source
+     * @param tx the position of the source
+     * @param corner the position of the corner
+     * @param rx the position of the destination
+     * @param shadowed true if the corner shadows the destination (NLOS), false if the direct path
+     * is clear (LOS), in which case the angle counts negatively
+     * @returns loss (in dB), DiffFunct of the angle between tx, the corner and rx
+     */
+    double DiffractionLoss(const Vector& tx,
+                           const Vector& corner,
+                           const Vector& rx,
+                           bool shadowed) const;
+
+    /**
+     * @brief Check if a point lies in the corridor around the segment between two nodes in which
+     * a LOS diffraction corner gives a positive loss.
+     *
+     * The corridor is the strip around the segment whose half width is derived from the
+     * angle at which DiffFunct crosses 0 dB.
+     *
+     * @param point the point to check (typically a building corner)
+     * @param a first end of the segment
+     * @param b second end of the segment
+     * @returns true if the point is in the corridor
+     */
+    bool IsInDiffractionCorridor(const Vector& point, const Vector& a, const Vector& b) const;
+
+    /**
+     * @brief Get the loss between two positions according to ItuR1411, as computed by
+     * ItuR1411LosPropagationLossModel
+     *
+     * @param rx the position of the destination
+     * @param tx the position of the source
      * @returns loss (in dB)
      */
-    double ItuR1411(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx) const;
+    double ItuR1411(const Vector& rx, const Vector& tx) const;
+
+    /**
+     * @brief Get the loss according to ItuR1411 from the distance and the heights of the nodes
+     *
+     * @param distance distance between the nodes (in m)
+     * @param hb height of the first node (in m)
+     * @param hm height of the second node (in m)
+     * @returns loss (in dB)
+     */
+    double ItuR1411(double distance, double hb, double hm) const;
+
+    /**
+     * @brief Get the losses according to ItuR1411 from several distances between nodes at the same
+     * heights, the breakpoint of the heights being computed once
+     *
+     * @param distances distances between the nodes (in m)
+     * @param hb height of the first node (in m)
+     * @param hm height of the second node (in m)
+     * @param out set to the loss (in dB) of each distance, as given by ItuR1411(distance, hb, hm)
+     */
+    void ItuR1411(std::span<const double> distances,
+                  double hb,
+                  double hm,
+                  std::span<double> out) const;
+
+    /**
+     * @brief Rebuild the city snapshot, the spatial index and the facade index if the
+     * BuildingList changed since they were built
+     *
+     * m_mutex is only taken when the BuildingList, the spatial index or the settings checked
+     * against the loss file changed since the last call.
+     */
+    void UpdateCitySnapshot() const;
+
+    /**
+     * @brief Get the buildings that intersect the straight line between two points.
+     *
+     * With a spatial index, only the buildings of the crossed grid cells are tested.
+     *
+     * @param a first end of the line
+     * @param b second end of the line
+     * @returns the slots of the buildings that intersect the line, in BuildingList order
+     */
+    std::vector<uint32_t> GetIntersectedBuildings(const Vector& a, const Vector& b) const;
+
+    /**
+     * @brief Get the buildings that NLOSassess::GetBuildingsBetween may report between two points.
+     *
+     * The toolbox only reports buildings whose footprint overlaps the bounding box of the line
+     * (both points on the same side of a building is a default LOS case), so only the buildings
+     * of the grid cells overlapping that box are returned. Only used with a spatial index: without
+     * one, the callers go through the slots of the snapshot directly.
+     *
+     * @param a first end of the line
+     * @param b second end of the line
+     * @returns the slots of the buildings to give to NLOSassess::GetBuildingsBetween
+     */
+    std::vector<uint32_t> GetBuildingsAround(const Vector& a, const Vector& b) const;
+
+    /**
+     * @brief Write the statistics to the statistics file at Simulator::Destroy, if they are
+     * collected and the file is set, and if not done yet
+     */
+    void ScheduleStatsDump();
 
-    Ptr<ItuR1411LosPropagationLossModel>
-        m_ituR1411Los;        ///< ItuR1411LosPropagationLossModel variable holder
     Ptr<NLOSassess> m_assess; ///< FOBA toolbox
     double m_frequency;       ///< Operating frequency
+    double m_lambda;          ///< Wavelength of the operating frequency (in m)
+    double m_lambdaSquared;   ///< Square of the wavelength (in m^2)
     double txGain;            ///< Emiting gain
     bool
         m_noiseEnabled; ///< if True (default value) noise is taken in account as small-scale fading
     Ptr<UniformRandomVariable> uni_rdm; ///< RandomVariable object
+    SpatialIndexType m_spatialIndex;    ///< Spatial index used to select the buildings
+    double m_gridCellSize;              ///< Edge length of the grid index cells (in m)
+    mutable Ptr<BuildingGridIndex> m_grid; ///< Grid index over the BuildingList
+    mutable Ptr<FacadeIndex> m_facades;    ///< Facade index over the BuildingList
+    Ptr<CitySnapshot> m_city;              ///< Snapshot of the BuildingList
+    bool m_zoneCacheEnabled;               ///< if True the zones of the nodes are cached
+    Ptr<NodeZoneCache> m_zoneCache;        ///< Zones of the nodes
+    bool m_linkCacheEnabled;               ///< if True the loss of the links is cached
+    Ptr<LinkLossCache> m_linkCache;        ///< Deterministic loss of the links
+    Ptr<WorkStealingPool> m_pool;          ///< Threads computing the losses of a batch
+    std::string m_lossFilePath;            ///< Loss file serving the losses, empty if none
+    Ptr<LossMatrixFile> m_lossFile;        ///< Mapped loss file, or nullptr
+    mutable bool m_lossFileChecked;        ///< True once the loss file matched the scenario
+    bool m_radioMapEnabled;                ///< if True the fixed nodes have radio maps
+    Ptr<RadioMapCache> m_radioMaps;        ///< Radio maps of the fixed nodes
+    mutable std::mutex m_mutex;            ///< Protects the snapshot, caches and random variable
+    /// True while the snapshot, the indexes and the loss file check are up to date
+    mutable std::atomic<bool> m_snapshotReady;
+    /// Number of buildings of the BuildingList when the snapshot was last found up to date
+    mutable std::atomic<uint32_t> m_snapshotBuildings;
+    /// First building of the BuildingList when the snapshot was last found up to date
+    mutable std::atomic<const Building*> m_snapshotFirst;
+    /// Spatial index of the snapshot when it was last found up to date
+    mutable std::atomic<SpatialIndexType> m_snapshotIndex;
+    bool m_cullingEnabled;                 ///< if True the links below the sensitivity are culled
+    double m_rxSensitivity;                ///< Sensitivity of the receivers (in dBm)
+    NoiseEngineType m_noiseEngine;         ///< Generator of the noise draws
+    DiffractionModeType m_diffractionMode; ///< Evaluation of the diffraction loss of the corners
+    DiffractionTable m_nlosDiffraction;    ///< Diffraction loss of the shadowing corners
+    DiffractionTable m_losDiffraction;     ///< Diffraction loss of the corners of a clear path
+    Ptr<LossStatistics> m_stats;           ///< Counters and latency histograms
+    std::string m_statsFile;               ///< File written at Simulator::Destroy, empty if none
+    bool m_statsDumpScheduled;             ///< True once the statistics file is scheduled
+    /// Terms of the loss of each GetLoss call, only computed when a sink is connected
+    TracedCallback<Ptr<const MobilityModel>, Ptr<const MobilityModel>, const LossBreakdown&>
+        m_lossBreakdownTrace;
+    int64_t m_noiseStream;                 ///< Stream assigned to the noise, -1 if none
+    /// Automatic stream of the Philox noise without assigned stream, 0 until the first draw
+    mutable uint64_t m_autoNoiseStream;
+    /// Philox noise draws already made for each link that drew, by (rx id << 32) | tx id
+    mutable std::unordered_map<uint64_t, uint32_t> m_noiseDraws;
+    /// Philox noise ids of the mobility models without node, the model keeps them alive so that
+    /// their address is not given to another mobility model
+    mutable std::map<Ptr<MobilityModel>, uint32_t> m_noiseIds;
+    mutable std::mutex m_noiseMutex; ///< Protects the Philox noise draws and ids
 };
 
 } // namespace ns3
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-city-snapshot.h"
+
+#include "ns3/building-list.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("CitySnapshot");
+
+NS_OBJECT_ENSURE_REGISTERED(CitySnapshot);
+
+/**
+ * @brief Interleave the bits of two 16 bits coordinates (Morton code)
+ * @param x first coordinate
+ * @param y second coordinate
+ * @return the Morton code
+ */
+static uint32_t
+MortonCode(uint32_t x, uint32_t y)
+{
+    auto spread = [](uint32_t v) {
+        v &= 0x0000ffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+TypeId
+CitySnapshot::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::CitySnapshot")
+                            .SetParent<Object>()
+                            .SetGroupName("Buildings")
+                            .AddConstructor<CitySnapshot>();
+    return tid;
+}
+
+CitySnapshot::CitySnapshot()
+    : m_version(0),
+      m_stale(false),
+      m_firstSlot(0)
+{
+}
+
+CitySnapshot::~CitySnapshot()
+{
+}
+
+bool
+CitySnapshot::Update()
+{
+    /*
+     * The BuildingList only grows until Simulator::Destroy empties it, and the snapshot keeps its
+     * buildings alive, so the buildings of a new BuildingList cannot have the address of the first
+     * building of the snapshot.
+     */
+    const uint32_t n = BuildingList::GetNBuildings();
+    if ((m_version > 0) && !m_stale && (GetNBuildings() == n) &&
+        ((n == 0) || (*BuildingList::Begin() == m_buildings[m_firstSlot])))
+    {
+        return false;
+    }
+    NS_LOG_FUNCTION(this);
+    Build(std::vector<Ptr<Building>>(BuildingList::Begin(), BuildingList::End()));
+    return true;
+}
+
+void
+CitySnapshot::Invalidate()
+{
+    NS_LOG_FUNCTION(this);
+    m_stale = true;
+}
+
+void
+CitySnapshot::Build(const std::vector<Ptr<Building>>& buildings)
+{
+    NS_LOG_FUNCTION(this << buildings.size());
+
+    const uint32_t n = buildings.size();
+    std::vector<Box> bounds;
+    bounds.reserve(n);
+    double xMin = std::numeric_limits<double>::infinity();
+    double yMin = std::numeric_limits<double>::infinity();
+    double xMax = -std::numeric_limits<double>::infinity();
+    double yMax = -std::numeric_limits<double>::infinity();
+    for (const auto& building : buildings)
+    {
+        bounds.push_back(building->GetBoundaries());
+        double cx = 0.5 * (bounds.back().xMin + bounds.back().xMax);
+        double cy = 0.5 * (bounds.back().yMin + bounds.back().yMax);
+        xMin = std::min(xMin, cx);
+        xMax = std::max(xMax, cx);
+        yMin = std::min(yMin, cy);
+        yMax = std::max(yMax, cy);
+    }
+
+    // Order the slots along the Morton curve of the footprint centers, ties in BuildingList order
+    std::vector<uint32_t> code(n);
+    for (uint32_t id = 0; id < n; ++id)
+    {
+        auto quantize = [](double v, double lo, double hi) {
+            return (hi > lo) ? static_cast<uint32_t>((v - lo) / (hi - lo) * 65535.0) : 0U;
+        };
+        code[id] = MortonCode(
+            quantize(0.5 * (bounds[id].xMin + bounds[id].xMax), xMin, xMax),
+            quantize(0.5 * (bounds[id].yMin + bounds[id].yMax), yMin, yMax));
+    }
+    m_id.resize(n);
+    std::iota(m_id.begin(), m_id.end(), 0);
+    std::stable_sort(m_id.begin(), m_id.end(), [&code](uint32_t a, uint32_t b) {
+        return code[a] < code[b];
+    });
+
+    m_buildings.resize(n);
+    m_xMin.resize(n);
+    m_xMax.resize(n);
+    m_yMin.resize(n);
+    m_yMax.resize(n);
+    m_zMin.resize(n);
+    m_zMax.resize(n);
+    m_corners.resize(n);
+    m_wallType.resize(n);
+    m_penetrationLoss.resize(n);
+    m_reflectionCoef.resize(n);
+    for (uint32_t slot = 0; slot < n; ++slot)
+    {
+        const Box& box = bounds[m_id[slot]];
+        m_buildings[slot] = buildings[m_id[slot]];
+        m_firstSlot = (m_id[slot] == 0) ? slot : m_firstSlot;
+        m_xMin[slot] = box.xMin;
+        m_xMax[slot] = box.xMax;
+        m_yMin[slot] = box.yMin;
+        m_yMax[slot] = box.yMax;
+        m_zMin[slot] = box.zMin;
+        m_zMax[slot] = box.zMax;
+        m_corners[slot][TOP_LEFT] = Vector(box.xMin, box.yMax, 0);
+        m_corners[slot][TOP_RIGHT] = Vector(box.xMax, box.yMax, 0);
+        m_corners[slot][BOTTOM_LEFT] = Vector(box.xMin, box.yMin, 0);
+        m_corners[slot][BOTTOM_RIGHT] = Vector(box.xMax, box.yMin, 0);
+        m_wallType[slot] = m_buildings[slot]->GetExtWallsType();
+
+        // Loss for each of the two walls traversed, and share of the power that is reflected
+        switch (m_wallType[slot])
+        {
+        case Building::Wood:
+            m_penetrationLoss[slot] = 2 * 20;
+            m_reflectionCoef[slot] = 0.4;
+            break;
+        case Building::ConcreteWithWindows:
+            m_penetrationLoss[slot] = 2 * 30;
+            m_reflectionCoef[slot] = 0.6;
+            break;
+        case Building::ConcreteWithoutWindows:
+            m_penetrationLoss[slot] = 2 * 30;
+            m_reflectionCoef[slot] = 0.61;
+            break;
+        case Building::StoneBlocks:
+            m_penetrationLoss[slot] = 2 * 40;
+            m_reflectionCoef[slot] = 0.9;
+            break;
+        default:
+            NS_LOG_ERROR(this << " Unknown Wall Type");
+            m_penetrationLoss[slot] = 0;
+            m_reflectionCoef[slot] = -1;
+        }
+    }
+    m_stale = false;
+    ++m_version;
+    NS_LOG_DEBUG("Snapshot version " << m_version << " of " << n << " buildings");
+}
+
+uint32_t
+CitySnapshot::GetVersion() const
+{
+    return m_version;
+}
+
+Ptr<Building>
+CitySnapshot::GetBuilding(uint32_t slot) const
+{
+    return m_buildings[slot];
+}
+
+Building::ExtWallsType_t
+CitySnapshot::GetExtWallsType(uint32_t slot) const
+{
+    return m_wallType[slot];
+}
+
+BoxArrays
+CitySnapshot::GetBoxes() const
+{
+    return {m_xMin.data(),
+            m_xMax.data(),
+            m_yMin.data(),
+            m_yMax.data(),
+            m_zMin.data(),
+            m_zMax.data()};
+}
+
+std::vector<uint32_t>
+CitySnapshot::GetIntersected(const Vector& a, const Vector& b) const
+{
+    std::vector<uint32_t> slots(GetNBuildings());
+    slots.resize(FilterSegmentIntersections(a, b, GetBoxes(), nullptr, slots.size(), slots.data()));
+    return slots;
+}
+
+void
+CitySnapshot::FilterIntersected(const Vector& a,
+                                const Vector& b,
+                                std::vector<uint32_t>& slots) const
+{
+    slots.resize(
+        FilterSegmentIntersections(a, b, GetBoxes(), slots.data(), slots.size(), slots.data()));
+}
+
+} // namespace ns3
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_CITY_SNAPSHOT_H
+#define FOBA_CITY_SNAPSHOT_H
+
+#include "foba-segment-box.h"
+
+#include "ns3/box.h"
+#include "ns3/building.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/vector.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Contiguous copy of the buildings of the BuildingList, as used by the
+ * FirstOrderBuildingsAwarePropagationLossModel.
+ *
+ * The bounds of the buildings are stored as structure of arrays, along with their corners and the
+ * penetration loss and reflection coefficient of their walls, so the geometry kernels do not have
+ * to go through Ptr<Building> and Building::GetBoundaries() for each building of each link.
+ *
+ * The buildings are stored in slots ordered along a Morton (Z-order) curve of their footprint
+ * center, so buildings close to each other are close in memory. GetId() gives the index of the
+ * building of a slot in the BuildingList, to restore the BuildingList order where it matters.
+ *
+ * The snapshot is rebuilt by Update() when buildings were added to the BuildingList, or when the
+ * BuildingList was created again after Simulator::Destroy, each rebuild increments its version.
+ * A change of the bounds or the wall type of a building already in the snapshot is not detected,
+ * Invalidate() has to be called after it.
+ */
+class CitySnapshot : public Object
+{
+  public:
+    /**
+     * @brief Get the type ID.
+     * @return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * @brief Corners of the footprint of a building
+     */
+    enum Corner
+    {
+        TOP_LEFT,    ///< (xMin, yMax)
+        TOP_RIGHT,   ///< (xMax, yMax)
+        BOTTOM_LEFT, ///< (xMin, yMin)
+        BOTTOM_RIGHT ///< (xMax, yMin)
+    };
+
+    CitySnapshot();
+    ~CitySnapshot() override;
+
+    /**
+     * @brief Rebuild the snapshot if the BuildingList changed since it was built
+     * @return true if the snapshot was rebuilt
+     */
+    bool Update();
+
+    /**
+     * @brief Rebuild the snapshot on the next Update(), for changes of the buildings that Update()
+     * does not detect
+     */
+    void Invalidate();
+
+    /**
+     * @brief (Re)build the snapshot from a set of buildings.
+     *
+     * @param buildings the buildings, their position in the vector is their id
+     */
+    void Build(const std::vector<Ptr<Building>>& buildings);
+
+    /**
+     * @return the number of times the snapshot was built
+     */
+    uint32_t GetVersion() const;
+
+    /**
+     * @return the number of buildings in the snapshot
+     */
+    uint32_t GetNBuildings() const;
+
+    /**
+     * @param slot slot of the building
+     * @return the index of the building in the vector it was built from (the BuildingList)
+     */
+    uint32_t GetId(uint32_t slot) const;
+
+    /**
+     * @param slot slot of the building
+     * @return the building
+     */
+    Ptr<Building> GetBuilding(uint32_t slot) const;
+
+    /**
+     * @param slot slot of the building
+     * @return the bounds of the building
+     */
+    Box GetBounds(uint32_t slot) const;
+
+    /**
+     * @param slot slot of the building
+     * @param corner corner of the footprint
+     * @return the position of the corner (at z = 0)
+     */
+    const Vector& GetCorner(uint32_t slot, Corner corner) const;
+
+    /**
+     * @param slot slot of the building
+     * @return the type of the external walls of the building
+     */
+    Building::ExtWallsType_t GetExtWallsType(uint32_t slot) const;
+
+    /**
+     * @param slot slot of the building
+     * @return the loss to go through the building (two walls, in dB)
+     */
+    double GetPenetrationLoss(uint32_t slot) const;
+
+    /**
+     * @param slot slot of the building
+     * @return the reflection coefficient of the walls, negative for an unknown wall type
+     */
+    double GetReflectionCoefficient(uint32_t slot) const;
+
+    /**
+     * @brief Get the buildings intersected by the segment between two points (see
+     * FilterSegmentIntersections)
+     *
+     * @param a first end of the segment
+     * @param b second end of the segment
+     * @return the slots of the intersected buildings, by increasing slot
+     */
+    std::vector<uint32_t> GetIntersected(const Vector& a, const Vector& b) const;
+
+    /**
+     * @brief Keep the buildings of a set that are intersected by the segment between two points
+     *
+     * @param a first end of the segment
+     * @param b second end of the segment
+     * @param slots the slots of the buildings to test, only the intersected ones are kept, in
+     * the same order
+     */
+    void FilterIntersected(const Vector& a, const Vector& b, std::vector<uint32_t>& slots) const;
+
+  private:
+    /**
+     * @return the bounds of the buildings, indexed by slot
+     */
+    BoxArrays GetBoxes() const;
+
+    uint32_t m_version;                               ///< Number of builds
+    bool m_stale;                                     ///< True once Invalidate() was called
+    uint32_t m_firstSlot;                             ///< Slot of the first building of the list
+    std::vector<uint32_t> m_id;                       ///< BuildingList index of each slot
+    std::vector<Ptr<Building>> m_buildings;           ///< Building of each slot
+    std::vector<double> m_xMin;                       ///< Lower x bound of each slot
+    std::vector<double> m_xMax;                       ///< Upper x bound of each slot
+    std::vector<double> m_yMin;                       ///< Lower y bound of each slot
+    std::vector<double> m_yMax;                       ///< Upper y bound of each slot
+    std::vector<double> m_zMin;                       ///< Lower z bound of each slot
+    std::vector<double> m_zMax;                       ///< Upper z bound of each slot
+    std::vector<std::array<Vector, 4>> m_corners;     ///< Corners of each slot, indexed by Corner
+    std::vector<Building::ExtWallsType_t> m_wallType; ///< Wall type of each slot
+    std::vector<double> m_penetrationLoss;            ///< Penetration loss of each slot (in dB)
+    std::vector<double> m_reflectionCoef;             ///< Reflection coefficient of each slot
+};
+
+inline uint32_t
+CitySnapshot::GetNBuildings() const
+{
+    return m_id.size();
+}
+
+inline uint32_t
+CitySnapshot::GetId(uint32_t slot) const
+{
+    return m_id[slot];
+}
+
+inline Box
+CitySnapshot::GetBounds(uint32_t slot) const
+{
+    return Box(m_xMin[slot], m_xMax[slot], m_yMin[slot], m_yMax[slot], m_zMin[slot], m_zMax[slot]);
+}
+
+inline const Vector&
+CitySnapshot::GetCorner(uint32_t slot, Corner corner) const
+{
+    return m_corners[slot][corner];
+}
+
+inline double
+CitySnapshot::GetPenetrationLoss(uint32_t slot) const
+{
+    return m_penetrationLoss[slot];
+}
+
+inline double
+CitySnapshot::GetReflectionCoefficient(uint32_t slot) const
+{
+    return m_reflectionCoef[slot];
+}
+
+} // namespace ns3
+
+#endif /* FOBA_CITY_SNAPSHOT_H */
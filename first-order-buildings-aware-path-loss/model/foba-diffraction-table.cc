@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-diffraction-table.h"
+
+#include "ns3/assert.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("DiffractionTable");
+
+/// Number of angles checked between two entries to measure the error of the table
+static const uint32_t ERROR_SAMPLES = 16;
+
+DiffractionTable::DiffractionTable()
+    : m_maxError(0.0)
+{
+}
+
+void
+DiffractionTable::Build(const std::function<double(double)>& loss, uint32_t size)
+{
+    NS_LOG_FUNCTION(this << size);
+    NS_ASSERT_MSG(size >= 2, "The diffraction table needs 2 entries by half");
+
+    auto toDegrees = [](double t) { return 2 * std::atan(t) * 180.0 / M_PI; };
+    m_low.resize(size);
+    m_high.resize(size);
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        double t = static_cast<double>(i) / (size - 1);
+        m_low[i] = loss(toDegrees(t));
+        m_high[i] = loss(180.0 - toDegrees(t));
+    }
+
+    m_maxError = 0.0;
+    for (uint32_t k = 0; k <= (size - 1) * ERROR_SAMPLES; ++k)
+    {
+        double t = static_cast<double>(k) / ((size - 1) * ERROR_SAMPLES);
+        for (bool low : {true, false})
+        {
+            double exact = loss(low ? toDegrees(t) : 180.0 - toDegrees(t));
+            double table = Interpolate(low ? m_low : m_high, t);
+            if ((exact > 0) || (table > 0))
+            {
+                m_maxError = std::max(m_maxError, std::abs(table - exact));
+            }
+        }
+    }
+    NS_LOG_INFO("Diffraction table of " << size << " entries by half, largest error "
+                                        << m_maxError << " dB");
+}
+
+bool
+DiffractionTable::IsBuilt() const
+{
+    return !m_low.empty();
+}
+
+double
+DiffractionTable::GetLoss(double dot, double cross) const
+{
+    // |AB| |BC|, from the Lagrange identity of the x-y plan
+    double magnitudes = std::sqrt(dot * dot + cross * cross);
+    if (!(magnitudes > 0))
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    cross = std::abs(cross);
+    if (dot >= 0)
+    {
+        return Interpolate(m_low, cross / (magnitudes + dot));
+    }
+    return Interpolate(m_high, cross / (magnitudes - dot));
+}
+
+double
+DiffractionTable::GetMaxError() const
+{
+    return m_maxError;
+}
+
+double
+DiffractionTable::Interpolate(const std::vector<double>& half, double t) const
+{
+    double x = t * (half.size() - 1);
+    uint32_t i = std::min(static_cast<uint32_t>(x), static_cast<uint32_t>(half.size() - 2));
+    double w = x - i;
+    return half[i] + w * (half[i + 1] - half[i]);
+}
+
+} // namespace ns3
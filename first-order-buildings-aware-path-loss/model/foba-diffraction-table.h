@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_DIFFRACTION_TABLE_H
+#define FOBA_DIFFRACTION_TABLE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Table of a diffraction loss as a function of the angle between the direction from the
+ * source to the corner and the direction from the corner to the destination.
+ *
+ * The angle is not computed: the table is indexed by the tangent of its half, given by the dot
+ * and cross products of the two directions, t = |cross| / (|AB| |BC| + dot) from 0 to 90 degrees
+ * and its inverse |cross| / (|AB| |BC| - dot) from 90 to 180 degrees. The angle is a smooth
+ * function of both (2 atan(t)), so the loss is interpolated linearly between the entries without
+ * acos. The largest error is measured when the table is built, on the angles whose exact or
+ * interpolated loss is positive, the model discarding the negative diffraction losses.
+ */
+class DiffractionTable
+{
+  public:
+    DiffractionTable();
+
+    /**
+     * @brief Fill the table
+     * @param loss the loss (in dB) as a function of the angle (in degrees, from 0 to 180)
+     * @param size number of entries of each half of the table (at least 2)
+     */
+    void Build(const std::function<double(double)>& loss, uint32_t size);
+
+    /**
+     * @return true once the table is built
+     */
+    bool IsBuilt() const;
+
+    /**
+     * @brief Interpolate the loss of the angle between two directions in the x-y plan
+     * @param dot dot product of the directions
+     * @param cross cross product of the directions
+     * @return the interpolated loss (in dB), NaN if one of the directions is null
+     */
+    double GetLoss(double dot, double cross) const;
+
+    /**
+     * @return the largest difference between the interpolated and the exact loss (in dB), for the
+     * angles where one of them is positive
+     */
+    double GetMaxError() const;
+
+  private:
+    /**
+     * @brief Interpolate the loss in one half of the table
+     * @param half the entries of the half
+     * @param t tangent of the half angle (0 to 90 degrees) or its inverse (90 to 180 degrees)
+     * @return the interpolated loss (in dB)
+     */
+    double Interpolate(const std::vector<double>& half, double t) const;
+
+    std::vector<double> m_low;  ///< Losses from 0 to 90 degrees, by tangent of the half angle
+    std::vector<double> m_high; ///< Losses from 180 to 90 degrees, by cotangent of the half angle
+    double m_maxError;          ///< Largest error measured when building the table (in dB)
+};
+
+} // namespace ns3
+
+#endif /* FOBA_DIFFRACTION_TABLE_H */
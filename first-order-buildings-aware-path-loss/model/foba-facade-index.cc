@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-facade-index.h"
+
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("FacadeIndex");
+
+NS_OBJECT_ENSURE_REGISTERED(FacadeIndex);
+
+TypeId
+FacadeIndex::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::FacadeIndex")
+                            .SetParent<Object>()
+                            .SetGroupName("Buildings")
+                            .AddConstructor<FacadeIndex>();
+    return tid;
+}
+
+FacadeIndex::FacadeIndex()
+    : m_version(0)
+{
+}
+
+FacadeIndex::~FacadeIndex()
+{
+}
+
+void
+FacadeIndex::Build(const CitySnapshot& city, Ptr<BuildingGridIndex> grid)
+{
+    NS_LOG_FUNCTION(this << city.GetNBuildings());
+    NS_ASSERT_MSG(!grid || (grid->GetVersion() == city.GetVersion()),
+                  "The grid index must be built over the same snapshot");
+
+    m_grid = grid;
+    m_version = city.GetVersion();
+    m_facades.clear();
+    m_facades.reserve(4 * city.GetNBuildings());
+    for (uint32_t slot = 0; slot < city.GetNBuildings(); ++slot)
+    {
+        Box box = city.GetBounds(slot);
+        Building::ExtWallsType_t wallType = city.GetExtWallsType(slot);
+        m_facades.push_back({slot, X_MIN, box.xMin, box.yMin, box.yMax, wallType});
+        m_facades.push_back({slot, X_MAX, box.xMax, box.yMin, box.yMax, wallType});
+        m_facades.push_back({slot, Y_MIN, box.yMin, box.xMin, box.xMax, wallType});
+        m_facades.push_back({slot, Y_MAX, box.yMax, box.xMin, box.xMax, wallType});
+    }
+}
+
+uint32_t
+FacadeIndex::GetVersion() const
+{
+    return m_version;
+}
+
+uint32_t
+FacadeIndex::GetNBuildings() const
+{
+    return m_facades.size() / 4;
+}
+
+const FacadeIndex::Facade&
+FacadeIndex::GetFacade(uint32_t index) const
+{
+    return m_facades[index];
+}
+
+double
+FacadeIndex::GetMinPathLength(uint32_t index, const Vector& a, const Vector& b) const
+{
+    const Facade& facade = m_facades[index];
+    bool alongX = (facade.orientation == Y_MIN) || (facade.orientation == Y_MAX);
+
+    // Coordinates along the wall (u) and distance to the wall line (d)
+    double ua = alongX ? a.x : a.y;
+    double ub = alongX ? b.x : b.y;
+    double da = std::abs((alongX ? a.y : a.x) - facade.coordinate);
+    double db = std::abs((alongX ? b.y : b.x) - facade.coordinate);
+
+    // The path length is convex along the wall line, its minimum is the specular point (same
+    // side) or the crossing point (opposite sides), both split [ua, ub] in the ratio da / db
+    double u = ua;
+    if (da + db > 0)
+    {
+        u = ua + (ub - ua) * da / (da + db);
+    }
+    u = std::clamp(u, facade.lo, facade.hi);
+    return std::hypot(ua - u, da) + std::hypot(ub - u, db);
+}
+
+void
+FacadeIndex::AppendFacades(uint32_t building,
+                           const Vector& a,
+                           const Vector& b,
+                           double length,
+                           std::vector<std::pair<double, uint32_t>>& out) const
+{
+    for (uint32_t index = 4 * building; index < 4 * building + 4; ++index)
+    {
+        const Facade& facade = m_facades[index];
+        bool outside = false;
+        switch (facade.orientation)
+        {
+        case X_MIN:
+            outside = (a.x <= facade.coordinate) && (b.x <= facade.coordinate);
+            break;
+        case X_MAX:
+            outside = (a.x >= facade.coordinate) && (b.x >= facade.coordinate);
+            break;
+        case Y_MIN:
+            outside = (a.y <= facade.coordinate) && (b.y <= facade.coordinate);
+            break;
+        case Y_MAX:
+            outside = (a.y >= facade.coordinate) && (b.y >= facade.coordinate);
+            break;
+        }
+        if (!outside)
+        {
+            continue;
+        }
+        double pathLength = GetMinPathLength(index, a, b);
+        if (pathLength <= length)
+        {
+            out.emplace_back(pathLength, index);
+        }
+    }
+}
+
+std::vector<std::pair<double, uint32_t>>
+FacadeIndex::GetFacadesInEllipse(const Vector& a, const Vector& b, double length) const
+{
+    NS_LOG_FUNCTION(this << a << b << length);
+
+    std::vector<std::pair<double, uint32_t>> facades;
+    if (m_grid && std::isfinite(length))
+    {
+        // Bounding box of the ellipse of foci a and b and major axis length
+        double dx = b.x - a.x;
+        double dy = b.y - a.y;
+        double focal = std::hypot(dx, dy);
+        double ux = (focal > 0) ? dx / focal : 1.0;
+        double uy = (focal > 0) ? dy / focal : 0.0;
+        double major = 0.5 * length;
+        double minor = std::sqrt(std::max(major * major - 0.25 * focal * focal, 0.0));
+        double ex = std::sqrt(major * major * ux * ux + minor * minor * uy * uy);
+        double ey = std::sqrt(major * major * uy * uy + minor * minor * ux * ux);
+        double cx = 0.5 * (a.x + b.x);
+        double cy = 0.5 * (a.y + b.y);
+        for (uint32_t building : m_grid->GetBoxCandidates(cx - ex, cx + ex, cy - ey, cy + ey))
+        {
+            AppendFacades(building, a, b, length, facades);
+        }
+    }
+    else
+    {
+        for (uint32_t building = 0; building < GetNBuildings(); ++building)
+        {
+            AppendFacades(building, a, b, length, facades);
+        }
+    }
+    std::sort(facades.begin(), facades.end());
+    return facades;
+}
+
+} // namespace ns3
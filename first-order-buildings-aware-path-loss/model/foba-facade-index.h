@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_FACADE_INDEX_H
+#define FOBA_FACADE_INDEX_H
+
+#include "foba-city-snapshot.h"
+#include "foba-grid-index.h"
+
+#include "ns3/building.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/vector.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Index of the building walls (facades) that may produce a reflection.
+ *
+ * Each building contributes its four walls (x = xMin, x = xMax, y = yMin, y = yMax) with their
+ * extent and wall type. A reflection on a wall is only possible if both nodes are on the outer
+ * side of it, and the reflected path tx -> wall -> rx is at least as long as the shortest path
+ * touching the wall. Given a maximum path length L, only the walls intersecting the ellipse of foci
+ * tx and rx and major axis L can hold a reflection point.
+ *
+ * When a BuildingGridIndex is provided, only the walls of the buildings of the cells overlapped by
+ * the ellipse are considered, otherwise every wall is checked.
+ */
+class FacadeIndex : public Object
+{
+  public:
+    /**
+     * @brief Get the type ID.
+     * @return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * @brief The wall of the building a facade belongs to
+     */
+    enum Orientation
+    {
+        X_MIN, ///< wall at x = xMin, facing -x
+        X_MAX, ///< wall at x = xMax, facing +x
+        Y_MIN, ///< wall at y = yMin, facing -y
+        Y_MAX  ///< wall at y = yMax, facing +y
+    };
+
+    /**
+     * @brief A building wall
+     */
+    struct Facade
+    {
+        uint32_t building;                 ///< slot of the building in the snapshot
+        Orientation orientation;           ///< wall of the building
+        double coordinate;                 ///< x (X_MIN, X_MAX) or y (Y_MIN, Y_MAX) of the wall
+        double lo;                         ///< lower bound of the wall along its axis
+        double hi;                         ///< upper bound of the wall along its axis
+        Building::ExtWallsType_t wallType; ///< material of the wall
+    };
+
+    FacadeIndex();
+    ~FacadeIndex() override;
+
+    /**
+     * @brief (Re)build the index over the buildings of a snapshot.
+     *
+     * @param city the buildings to index
+     * @param grid grid index built over the same snapshot, or nullptr to check every wall
+     */
+    void Build(const CitySnapshot& city, Ptr<BuildingGridIndex> grid);
+
+    /**
+     * @return the version of the snapshot the index was built from
+     */
+    uint32_t GetVersion() const;
+
+    /**
+     * @return the number of buildings the index was built with
+     */
+    uint32_t GetNBuildings() const;
+
+    /**
+     * @param index index of the facade
+     * @return the facade
+     */
+    const Facade& GetFacade(uint32_t index) const;
+
+    /**
+     * @brief Length (in the x-y plan) of the shortest path from a to b touching a facade.
+     *
+     * For a specular reflection on the wall, it is the length of the reflected path.
+     *
+     * @param index index of the facade
+     * @param a first end of the path
+     * @param b second end of the path
+     * @return the length of the path (in m)
+     */
+    double GetMinPathLength(uint32_t index, const Vector& a, const Vector& b) const;
+
+    /**
+     * @brief Get the facades that may hold a reflection point between a and b with a reflected
+     * path no longer than a given length.
+     *
+     * @param a first node
+     * @param b second node
+     * @param length maximum length (in the x-y plan) of the reflected path, may be infinite
+     * @return the facades with both nodes on their outer side and within the ellipse, as pairs of
+     * (shortest path length, facade index) sorted by increasing length
+     */
+    std::vector<std::pair<double, uint32_t>> GetFacadesInEllipse(const Vector& a,
+                                                                 const Vector& b,
+                                                                 double length) const;
+
+  private:
+    /**
+     * @brief Add the facades of a building to a candidate list if they fit in the ellipse.
+     *
+     * @param building slot of the building
+     * @param a first node
+     * @param b second node
+     * @param length maximum length of the reflected path
+     * @param out list of candidates to complete
+     */
+    void AppendFacades(uint32_t building,
+                       const Vector& a,
+                       const Vector& b,
+                       double length,
+                       std::vector<std::pair<double, uint32_t>>& out) const;
+
+    std::vector<Facade> m_facades; ///< Facades, the four walls of slot i start at 4 * i
+    Ptr<BuildingGridIndex> m_grid; ///< Grid index over the same snapshot (may be null)
+    uint32_t m_version;            ///< Version of the indexed snapshot
+};
+
+} // namespace ns3
+
+#endif /* FOBA_FACADE_INDEX_H */
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-grid-index.h"
+
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("BuildingGridIndex");
+
+NS_OBJECT_ENSURE_REGISTERED(BuildingGridIndex);
+
+/// Upper bound on the number of cells, the cell size is enlarged beyond it
+static const double GRID_MAX_CELLS = 4194304.0;
+
+TypeId
+BuildingGridIndex::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::BuildingGridIndex")
+                            .SetParent<Object>()
+                            .SetGroupName("Buildings")
+                            .AddConstructor<BuildingGridIndex>();
+    return tid;
+}
+
+BuildingGridIndex::BuildingGridIndex()
+    : m_cellSize(1.0),
+      m_xOrigin(0.0),
+      m_yOrigin(0.0),
+      m_nx(0),
+      m_ny(0),
+      m_nBuildings(0),
+      m_version(0)
+{
+}
+
+BuildingGridIndex::~BuildingGridIndex()
+{
+}
+
+void
+BuildingGridIndex::Build(const CitySnapshot& city, double cellSize)
+{
+    NS_LOG_FUNCTION(this << city.GetNBuildings() << cellSize);
+    NS_ASSERT_MSG(cellSize > 0, "The grid cell size must be strictly positive");
+
+    m_nBuildings = city.GetNBuildings();
+    m_version = city.GetVersion();
+    m_cellStart.clear();
+    m_cellItems.clear();
+    if (m_nBuildings == 0)
+    {
+        m_nx = 0;
+        m_ny = 0;
+        return;
+    }
+
+    double xMin = std::numeric_limits<double>::infinity();
+    double yMin = std::numeric_limits<double>::infinity();
+    double xMax = -std::numeric_limits<double>::infinity();
+    double yMax = -std::numeric_limits<double>::infinity();
+    std::vector<Box> bounds;
+    bounds.reserve(m_nBuildings);
+    for (uint32_t slot = 0; slot < m_nBuildings; ++slot)
+    {
+        bounds.push_back(city.GetBounds(slot));
+        xMin = std::min(xMin, bounds.back().xMin);
+        xMax = std::max(xMax, bounds.back().xMax);
+        yMin = std::min(yMin, bounds.back().yMin);
+        yMax = std::max(yMax, bounds.back().yMax);
+    }
+
+    // Bound the memory footprint for sparse cities spread over a large area
+    double cells =
+        std::ceil((xMax - xMin) / cellSize + 1) * std::ceil((yMax - yMin) / cellSize + 1);
+    if (cells > GRID_MAX_CELLS)
+    {
+        cellSize *= std::sqrt(cells / GRID_MAX_CELLS);
+        NS_LOG_DEBUG("Grid cell size enlarged to " << cellSize);
+    }
+
+    // Inflate the footprints so that buildings touching a cell boundary belong to both cells
+    const double eps = 1e-6 * cellSize;
+    m_cellSize = cellSize;
+    m_xOrigin = xMin - eps;
+    m_yOrigin = yMin - eps;
+    m_nx = static_cast<int32_t>(std::floor((xMax + eps - m_xOrigin) / m_cellSize)) + 1;
+    m_ny = static_cast<int32_t>(std::floor((yMax + eps - m_yOrigin) / m_cellSize)) + 1;
+
+    // Counting pass, then fill (CSR layout keeps each cell contiguous)
+    std::vector<uint32_t> count(static_cast<size_t>(m_nx) * m_ny + 1, 0);
+    for (const auto& box : bounds)
+    {
+        for (int32_t cy = CellY(box.yMin - eps); cy <= CellY(box.yMax + eps); ++cy)
+        {
+            for (int32_t cx = CellX(box.xMin - eps); cx <= CellX(box.xMax + eps); ++cx)
+            {
+                ++count[static_cast<size_t>(cy) * m_nx + cx + 1];
+            }
+        }
+    }
+    for (size_t i = 1; i < count.size(); ++i)
+    {
+        count[i] += count[i - 1];
+    }
+    m_cellStart = count;
+    m_cellItems.resize(count.back());
+    for (uint32_t slot = 0; slot < bounds.size(); ++slot)
+    {
+        const Box& box = bounds[slot];
+        for (int32_t cy = CellY(box.yMin - eps); cy <= CellY(box.yMax + eps); ++cy)
+        {
+            for (int32_t cx = CellX(box.xMin - eps); cx <= CellX(box.xMax + eps); ++cx)
+            {
+                m_cellItems[count[static_cast<size_t>(cy) * m_nx + cx]++] = slot;
+            }
+        }
+    }
+    NS_LOG_DEBUG("Grid of " << m_nx << "x" << m_ny << " cells for " << m_nBuildings
+                            << " buildings");
+}
+
+uint32_t
+BuildingGridIndex::GetNBuildings() const
+{
+    return m_nBuildings;
+}
+
+uint32_t
+BuildingGridIndex::GetVersion() const
+{
+    return m_version;
+}
+
+double
+BuildingGridIndex::GetCellSize() const
+{
+    return m_cellSize;
+}
+
+int32_t
+BuildingGridIndex::CellX(double x) const
+{
+    double cx = std::floor((x - m_xOrigin) / m_cellSize);
+    return static_cast<int32_t>(std::clamp(cx, 0.0, static_cast<double>(m_nx - 1)));
+}
+
+int32_t
+BuildingGridIndex::CellY(double y) const
+{
+    double cy = std::floor((y - m_yOrigin) / m_cellSize);
+    return static_cast<int32_t>(std::clamp(cy, 0.0, static_cast<double>(m_ny - 1)));
+}
+
+void
+BuildingGridIndex::AppendCell(int32_t cx, int32_t cy, std::vector<uint32_t>& out) const
+{
+    size_t cell = static_cast<size_t>(cy) * m_nx + cx;
+    out.insert(out.end(),
+               m_cellItems.begin() + m_cellStart[cell],
+               m_cellItems.begin() + m_cellStart[cell + 1]);
+}
+
+std::vector<uint32_t>
+BuildingGridIndex::GetSegmentCandidates(const Vector& a, const Vector& b) const
+{
+    NS_LOG_FUNCTION(this << a << b);
+
+    std::vector<uint32_t> candidates;
+    if (m_nBuildings == 0)
+    {
+        return candidates;
+    }
+
+    // Clip the segment to the grid (Liang-Barsky), nothing is registered outside of it
+    const double dx = b.x - a.x;
+    const double dy = b.y - a.y;
+    const double gridXMax = m_xOrigin + m_nx * m_cellSize;
+    const double gridYMax = m_yOrigin + m_ny * m_cellSize;
+    double t0 = 0.0;
+    double t1 = 1.0;
+    auto clip = [&t0, &t1](double p, double q) {
+        if (p == 0)
+        {
+            return q >= 0;
+        }
+        double t = q / p;
+        if (p < 0)
+        {
+            t0 = std::max(t0, t);
+        }
+        else
+        {
+            t1 = std::min(t1, t);
+        }
+        return t0 <= t1;
+    };
+    if (!clip(-dx, a.x - m_xOrigin) || !clip(dx, gridXMax - a.x) || !clip(-dy, a.y - m_yOrigin) ||
+        !clip(dy, gridYMax - a.y))
+    {
+        return candidates;
+    }
+
+    // Amanatides & Woo traversal of the cells crossed between t0 and t1
+    int32_t cx = CellX(a.x + t0 * dx);
+    int32_t cy = CellY(a.y + t0 * dy);
+    const int32_t stepX = (dx > 0) ? 1 : -1;
+    const int32_t stepY = (dy > 0) ? 1 : -1;
+    const double inf = std::numeric_limits<double>::infinity();
+    const double tDeltaX = (dx != 0) ? m_cellSize / std::abs(dx) : inf;
+    const double tDeltaY = (dy != 0) ? m_cellSize / std::abs(dy) : inf;
+    double tMaxX = inf;
+    double tMaxY = inf;
+    if (dx != 0)
+    {
+        double border = m_xOrigin + (cx + (dx > 0 ? 1 : 0)) * m_cellSize;
+        tMaxX = (border - a.x) / dx;
+    }
+    if (dy != 0)
+    {
+        double border = m_yOrigin + (cy + (dy > 0 ? 1 : 0)) * m_cellSize;
+        tMaxY = (border - a.y) / dy;
+    }
+
+    AppendCell(cx, cy, candidates);
+    while (std::min(tMaxX, tMaxY) <= t1)
+    {
+        if (tMaxX < tMaxY)
+        {
+            cx += stepX;
+            tMaxX += tDeltaX;
+        }
+        else
+        {
+            cy += stepY;
+            tMaxY += tDeltaY;
+        }
+        if ((cx < 0) || (cx >= m_nx) || (cy < 0) || (cy >= m_ny))
+        {
+            break;
+        }
+        AppendCell(cx, cy, candidates);
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    return candidates;
+}
+
+std::vector<uint32_t>
+BuildingGridIndex::GetBoxCandidates(double xMin, double xMax, double yMin, double yMax) const
+{
+    NS_LOG_FUNCTION(this << xMin << xMax << yMin << yMax);
+
+    std::vector<uint32_t> candidates;
+    if ((m_nBuildings == 0) || (xMax < m_xOrigin) || (yMax < m_yOrigin) ||
+        (xMin > m_xOrigin + m_nx * m_cellSize) || (yMin > m_yOrigin + m_ny * m_cellSize))
+    {
+        return candidates;
+    }
+    for (int32_t cy = CellY(yMin); cy <= CellY(yMax); ++cy)
+    {
+        for (int32_t cx = CellX(xMin); cx <= CellX(xMax); ++cx)
+        {
+            AppendCell(cx, cy, candidates);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    return candidates;
+}
+
+} // namespace ns3
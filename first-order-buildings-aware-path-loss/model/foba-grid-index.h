@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_GRID_INDEX_H
+#define FOBA_GRID_INDEX_H
+
+#include "foba-city-snapshot.h"
+
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/vector.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Uniform 2D grid over the building footprints.
+ *
+ * Every building is registered in each cell its footprint overlaps. A segment query walks the
+ * cells crossed by the x-y projection of the segment (Amanatides & Woo DDA traversal), so only
+ * the buildings close to the line of sight need to be tested instead of the whole BuildingList.
+ *
+ * Footprints are slightly inflated when registered, so a building touching a cell boundary (or
+ * a segment running exactly along one) is always reported. Queries may therefore return a few
+ * extra candidates, but never miss one: the exact test is left to the caller.
+ *
+ * Candidates are returned as slots of the CitySnapshot given to Build(), in increasing order, so
+ * callers iterate them in the same order as a linear scan of the snapshot would.
+ */
+class BuildingGridIndex : public Object
+{
+  public:
+    /**
+     * @brief Get the type ID.
+     * @return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    BuildingGridIndex();
+    ~BuildingGridIndex() override;
+
+    /**
+     * @brief (Re)build the grid over the buildings of a snapshot.
+     *
+     * @param city the buildings to index
+     * @param cellSize edge length of a grid cell (in m)
+     */
+    void Build(const CitySnapshot& city, double cellSize);
+
+    /**
+     * @return the version of the snapshot the grid was built from
+     */
+    uint32_t GetVersion() const;
+
+    /**
+     * @return the number of buildings the grid was built with
+     */
+    uint32_t GetNBuildings() const;
+
+    /**
+     * @return the edge length of a grid cell (in m), possibly enlarged to bound memory usage
+     */
+    double GetCellSize() const;
+
+    /**
+     * @brief Get the buildings registered in the cells crossed by a segment.
+     *
+     * @param a first end of the segment
+     * @param b second end of the segment
+     * @return the sorted slots of the buildings that may intersect the segment
+     */
+    std::vector<uint32_t> GetSegmentCandidates(const Vector& a, const Vector& b) const;
+
+    /**
+     * @brief Get the buildings registered in the cells overlapped by an axis-aligned rectangle.
+     *
+     * @param xMin lower x bound of the rectangle
+     * @param xMax upper x bound of the rectangle
+     * @param yMin lower y bound of the rectangle
+     * @param yMax upper y bound of the rectangle
+     * @return the sorted slots of the buildings whose footprint may overlap the rectangle
+     */
+    std::vector<uint32_t> GetBoxCandidates(double xMin,
+                                           double xMax,
+                                           double yMin,
+                                           double yMax) const;
+
+  private:
+    /**
+     * @brief Column of the cell containing an abscissa, clamped to the grid.
+     * @param x abscissa (in m)
+     * @return the column index
+     */
+    int32_t CellX(double x) const;
+
+    /**
+     * @brief Row of the cell containing an ordinate, clamped to the grid.
+     * @param y ordinate (in m)
+     * @return the row index
+     */
+    int32_t CellY(double y) const;
+
+    /**
+     * @brief Append the buildings of a cell to a candidate list.
+     * @param cx column of the cell
+     * @param cy row of the cell
+     * @param out list of candidates to complete
+     */
+    void AppendCell(int32_t cx, int32_t cy, std::vector<uint32_t>& out) const;
+
+    double m_cellSize;                 ///< Edge length of a cell (in m)
+    double m_xOrigin;                  ///< Abscissa of the grid lower left corner
+    double m_yOrigin;                  ///< Ordinate of the grid lower left corner
+    int32_t m_nx;                      ///< Number of columns
+    int32_t m_ny;                      ///< Number of rows
+    uint32_t m_nBuildings;             ///< Number of indexed buildings
+    uint32_t m_version;                ///< Version of the indexed snapshot
+    std::vector<uint32_t> m_cellStart; ///< Offset of each cell in m_cellItems (CSR layout)
+    std::vector<uint32_t> m_cellItems; ///< Building slots, grouped by cell
+};
+
+} // namespace ns3
+
+#endif /* FOBA_GRID_INDEX_H */
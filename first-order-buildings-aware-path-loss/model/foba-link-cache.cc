@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-link-cache.h"
+
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("LinkLossCache");
+
+NS_OBJECT_ENSURE_REGISTERED(LinkLossCache);
+
+TypeId
+LinkLossCache::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::LinkLossCache")
+            .SetParent<Object>()
+            .SetGroupName("Buildings")
+            .AddConstructor<LinkLossCache>()
+            .AddAttribute("MaxEntries",
+                          "Maximum number of links in the cache, the least recently used links "
+                          "are evicted first.",
+                          UintegerValue(100000),
+                          MakeUintegerAccessor(&LinkLossCache::SetMaxEntries,
+                                               &LinkLossCache::GetMaxEntries),
+                          MakeUintegerChecker<uint32_t>(1));
+    return tid;
+}
+
+LinkLossCache::LinkLossCache()
+    : m_maxEntries(100000),
+      m_hits(0),
+      m_misses(0),
+      m_evictions(0)
+{
+}
+
+LinkLossCache::~LinkLossCache()
+{
+    // The models may outlive a cache that was not disposed
+    UntrackAll();
+}
+
+void
+LinkLossCache::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    UntrackAll();
+    m_entries.clear();
+    m_recent.clear();
+    Object::DoDispose();
+}
+
+void
+LinkLossCache::SetMaxEntries(uint32_t maxEntries)
+{
+    NS_LOG_FUNCTION(this << maxEntries);
+    m_maxEntries = maxEntries;
+    while (m_entries.size() > m_maxEntries)
+    {
+        m_entries.erase(m_recent.back());
+        m_recent.pop_back();
+        ++m_evictions;
+    }
+}
+
+uint32_t
+LinkLossCache::GetMaxEntries() const
+{
+    return m_maxEntries;
+}
+
+std::pair<LinkLossCache::Key, int>
+LinkLossCache::MakeKey(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx)
+{
+    const MobilityModel* a = PeekPointer(rx);
+    const MobilityModel* b = PeekPointer(tx);
+    if (a < b)
+    {
+        return {Key(a, b), 0};
+    }
+    return {Key(b, a), 1};
+}
+
+uint64_t
+LinkLossCache::GetEpoch(const MobilityModel* model) const
+{
+    auto it = m_tracked.find(model);
+    return (it == m_tracked.end()) ? 0 : it->second.epoch;
+}
+
+bool
+LinkLossCache::Lookup(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx, double& loss)
+{
+    auto [key, direction] = MakeKey(rx, tx);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+    {
+        ++m_misses;
+        return false;
+    }
+    Entry& entry = it->second;
+    if ((entry.epochs[0] != GetEpoch(key.first)) || (entry.epochs[1] != GetEpoch(key.second)))
+    {
+        // One of the models moved since the link was computed
+        m_recent.erase(entry.recent);
+        m_entries.erase(it);
+        ++m_misses;
+        return false;
+    }
+    if (std::isnan(entry.loss[direction]))
+    {
+        ++m_misses;
+        return false;
+    }
+    m_recent.splice(m_recent.begin(), m_recent, entry.recent);
+    loss = entry.loss[direction];
+    ++m_hits;
+    return true;
+}
+
+void
+LinkLossCache::Insert(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx, double loss)
+{
+    if ((rx->GetVelocity().GetLength() != 0) || (tx->GetVelocity().GetLength() != 0))
+    {
+        return;
+    }
+    Track(rx);
+    Track(tx);
+    auto [key, direction] = MakeKey(rx, tx);
+    uint64_t epochs[2] = {GetEpoch(key.first), GetEpoch(key.second)};
+    auto [it, inserted] = m_entries.try_emplace(key);
+    Entry& entry = it->second;
+    if (inserted)
+    {
+        m_recent.push_front(key);
+        entry.recent = m_recent.begin();
+    }
+    else
+    {
+        m_recent.splice(m_recent.begin(), m_recent, entry.recent);
+    }
+    if (inserted || (entry.epochs[0] != epochs[0]) || (entry.epochs[1] != epochs[1]))
+    {
+        entry.epochs[0] = epochs[0];
+        entry.epochs[1] = epochs[1];
+        entry.loss[0] = std::numeric_limits<double>::quiet_NaN();
+        entry.loss[1] = std::numeric_limits<double>::quiet_NaN();
+    }
+    entry.loss[direction] = loss;
+    if (m_entries.size() > m_maxEntries)
+    {
+        m_entries.erase(m_recent.back());
+        m_recent.pop_back();
+        ++m_evictions;
+    }
+}
+
+void
+LinkLossCache::Clear()
+{
+    NS_LOG_FUNCTION(this);
+    m_entries.clear();
+    m_recent.clear();
+}
+
+uint32_t
+LinkLossCache::GetNEntries() const
+{
+    return m_entries.size();
+}
+
+uint64_t
+LinkLossCache::GetHits() const
+{
+    return m_hits;
+}
+
+uint64_t
+LinkLossCache::GetMisses() const
+{
+    return m_misses;
+}
+
+uint64_t
+LinkLossCache::GetEvictions() const
+{
+    return m_evictions;
+}
+
+void
+LinkLossCache::Track(Ptr<MobilityModel> model)
+{
+    if (m_tracked.count(PeekPointer(model)))
+    {
+        return;
+    }
+    NS_LOG_FUNCTION(this << model);
+    m_tracked[PeekPointer(model)] = Tracked{model, 1};
+    model->TraceConnectWithoutContext("CourseChange",
+                                      MakeCallback(&LinkLossCache::NotifyCourseChange, this));
+}
+
+void
+LinkLossCache::UntrackAll()
+{
+    for (auto& [address, tracked] : m_tracked)
+    {
+        tracked.model->TraceDisconnectWithoutContext(
+            "CourseChange",
+            MakeCallback(&LinkLossCache::NotifyCourseChange, this));
+    }
+    m_tracked.clear();
+}
+
+void
+LinkLossCache::NotifyCourseChange(Ptr<const MobilityModel> model)
+{
+    NS_LOG_FUNCTION(this << model);
+    auto it = m_tracked.find(PeekPointer(model));
+    if (it != m_tracked.end())
+    {
+        // The links of the model are dropped when they are next looked up
+        ++it->second.epoch;
+    }
+}
+
+} // namespace ns3
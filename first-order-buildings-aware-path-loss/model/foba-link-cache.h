@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_LINK_CACHE_H
+#define FOBA_LINK_CACHE_H
+
+#include "ns3/mobility-model.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace ns3
+{
+
+/**
+ * @brief Cache of the deterministic loss of the links between pairs of mobility models.
+ *
+ * An entry is shared by the two directions of a link, each direction being computed on its first
+ * use. Each mobility model seen by the cache has an epoch, incremented by its CourseChange trace;
+ * an entry is only valid while the epochs of both models are the ones it was computed with.
+ *
+ * Since a model moving at a constant velocity does not fire CourseChange, a link is only stored
+ * when both models are static (zero velocity): a model starting to move changes its course, which
+ * invalidates its links.
+ *
+ * The number of entries is bounded, the least recently used entry is evicted first.
+ */
+class LinkLossCache : public Object
+{
+  public:
+    /**
+     * @brief Get the type ID.
+     * @return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    LinkLossCache();
+    ~LinkLossCache() override;
+
+    /**
+     * @brief Set the maximum number of links in the cache, the least recently used links are
+     * evicted if needed
+     * @param maxEntries the maximum number of links (at least 1)
+     */
+    void SetMaxEntries(uint32_t maxEntries);
+
+    /**
+     * @return the maximum number of links in the cache
+     */
+    uint32_t GetMaxEntries() const;
+
+    /**
+     * @brief Get the loss of a link if it is in the cache
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @param loss set to the loss of the link (in dB) if it is in the cache
+     * @return true if the link is in the cache
+     */
+    bool Lookup(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx, double& loss);
+
+    /**
+     * @brief Store the loss of a link, if both models are static
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @param loss the loss of the link (in dB)
+     */
+    void Insert(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx, double loss);
+
+    /**
+     * @brief Remove all the links from the cache, the counters are kept
+     */
+    void Clear();
+
+    /**
+     * @return the number of links in the cache
+     */
+    uint32_t GetNEntries() const;
+
+    /**
+     * @return the number of losses found in the cache
+     */
+    uint64_t GetHits() const;
+
+    /**
+     * @return the number of losses not found in the cache
+     */
+    uint64_t GetMisses() const;
+
+    /**
+     * @return the number of links evicted to respect the maximum number of links
+     */
+    uint64_t GetEvictions() const;
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /// Two mobility models, ordered by address
+    using Key = std::pair<const MobilityModel*, const MobilityModel*>;
+
+    /**
+     * @brief Hash of a Key
+     */
+    struct KeyHash
+    {
+        /**
+         * @param key the key to hash
+         * @return the hash of the key
+         */
+        std::size_t operator()(const Key& key) const
+        {
+            std::size_t a = std::hash<const void*>()(key.first);
+            std::size_t b = std::hash<const void*>()(key.second);
+            return a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+        }
+    };
+
+    /**
+     * @brief A link in the cache
+     */
+    struct Entry
+    {
+        uint64_t epochs[2];              ///< epochs of the two models of the key
+        double loss[2];                  ///< loss from first to second model and back, NaN if unset
+        std::list<Key>::iterator recent; ///< position in the recently used list
+    };
+
+    /**
+     * @brief A mobility model followed by the cache
+     */
+    struct Tracked
+    {
+        Ptr<MobilityModel> model; ///< the model, kept to disconnect from its trace
+        uint64_t epoch;           ///< number of course changes of the model
+    };
+
+    /**
+     * @brief Key of a link, and which of its directions is rx -> tx
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @return the key and the index of the direction in Entry::loss
+     */
+    static std::pair<Key, int> MakeKey(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx);
+
+    /**
+     * @param model a mobility model
+     * @return the epoch of the model, 0 if it is not followed
+     */
+    uint64_t GetEpoch(const MobilityModel* model) const;
+
+    /**
+     * @brief Follow the course changes of a model, if not done yet
+     * @param model the model
+     */
+    void Track(Ptr<MobilityModel> model);
+
+    /**
+     * @brief Stop following the course changes of all the models
+     */
+    void UntrackAll();
+
+    /**
+     * @brief Invalidate the links of a model
+     * @param model the model whose course changed
+     */
+    void NotifyCourseChange(Ptr<const MobilityModel> model);
+
+    uint32_t m_maxEntries;                             ///< Maximum number of links
+    std::unordered_map<Key, Entry, KeyHash> m_entries; ///< Links in the cache
+    std::list<Key> m_recent;                           ///< Links, most recently used first
+    std::unordered_map<const MobilityModel*, Tracked> m_tracked; ///< Followed models
+    uint64_t m_hits;                                   ///< Number of hits
+    uint64_t m_misses;                                 ///< Number of misses
+    uint64_t m_evictions;                              ///< Number of evictions
+};
+
+} // namespace ns3
+
+#endif /* FOBA_LINK_CACHE_H */
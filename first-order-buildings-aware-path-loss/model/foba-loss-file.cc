@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-loss-file.h"
+
+#include "ns3/abort.h"
+#include "ns3/building-list.h"
+#include "ns3/building.h"
+#include "ns3/hash.h"
+#include "ns3/log.h"
+#include "ns3/node-list.h"
+#include "ns3/node.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FOBA_LOSS_FILE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("LossMatrixFile");
+
+NS_OBJECT_ENSURE_REGISTERED(LossMatrixFile);
+
+/// Magic string at the start of the loss files
+static const char LOSS_FILE_MAGIC[8] = {'F', 'O', 'B', 'A', 'L', 'O', 'S', 'S'};
+/// Version of the loss file format
+static const uint32_t LOSS_FILE_VERSION = 2;
+/// Losses per dB in the loss files
+static const double LOSS_FILE_SCALE = 100.0;
+/// Quantized loss of the links whose loss was not finite, below the saturated losses
+static const int16_t LOSS_FILE_MISSING = std::numeric_limits<int16_t>::min();
+
+TypeId
+LossMatrixFile::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::LossMatrixFile")
+                            .SetParent<Object>()
+                            .SetGroupName("Buildings")
+                            .AddConstructor<LossMatrixFile>();
+    return tid;
+}
+
+LossMatrixFile::LossMatrixFile()
+    : m_header(nullptr),
+      m_nodes(nullptr),
+      m_losses(nullptr),
+      m_mapping(nullptr),
+      m_size(0)
+{
+}
+
+LossMatrixFile::~LossMatrixFile()
+{
+    Close();
+}
+
+void
+LossMatrixFile::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Close();
+    Object::DoDispose();
+}
+
+void
+LossMatrixFile::Write(const std::string& path,
+                      NodeContainer nodes,
+                      std::span<const double> losses,
+                      double frequency,
+                      double txGain,
+                      uint32_t diffractionMode)
+{
+    NS_LOG_FUNCTION(path << nodes.GetN() << frequency << txGain << diffractionMode);
+    const uint64_t n = nodes.GetN();
+    NS_ASSERT_MSG(losses.size() == n * n, "One loss per pair of nodes is needed");
+
+    Header header;
+    std::memcpy(header.magic, LOSS_FILE_MAGIC, sizeof(header.magic));
+    header.version = LOSS_FILE_VERSION;
+    header.nNodes = n;
+    header.frequency = frequency;
+    header.txGain = txGain;
+    header.buildingsHash = HashBuildings();
+    header.diffraction = diffractionMode;
+    header.reserved = 0;
+
+    std::vector<NodeRecord> records;
+    records.reserve(n);
+    for (auto it = nodes.Begin(); it != nodes.End(); ++it)
+    {
+        Ptr<MobilityModel> mobility = (*it)->GetObject<MobilityModel>();
+        NS_ABORT_MSG_UNLESS(mobility, "Node " << (*it)->GetId() << " has no MobilityModel");
+        Vector position = mobility->GetPosition();
+        records.push_back(NodeRecord{(*it)->GetId(), 0, position.x, position.y, position.z});
+    }
+
+    // A NaN would go through the clamp, and its conversion to int16_t is undefined
+    uint64_t missing = 0;
+    std::vector<int16_t> quantized(losses.size());
+    std::transform(losses.begin(), losses.end(), quantized.begin(), [&missing](double loss) {
+        if (!std::isfinite(loss))
+        {
+            ++missing;
+            return LOSS_FILE_MISSING;
+        }
+        double scaled = std::round(loss * LOSS_FILE_SCALE);
+        return static_cast<int16_t>(
+            std::clamp<double>(scaled,
+                               -std::numeric_limits<int16_t>::max(),
+                               std::numeric_limits<int16_t>::max()));
+    });
+    if (missing > 0)
+    {
+        NS_LOG_WARN(missing << " losses are not finite, their links will be computed again");
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_UNLESS(file, "Cannot write the loss file " << path);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(NodeRecord));
+    file.write(reinterpret_cast<const char*>(quantized.data()), quantized.size() * sizeof(int16_t));
+    NS_ABORT_MSG_UNLESS(file, "Cannot write the loss file " << path);
+}
+
+uint64_t
+LossMatrixFile::HashBuildings()
+{
+    std::ostringstream buildings;
+    for (auto it = BuildingList::Begin(); it != BuildingList::End(); ++it)
+    {
+        Box box = (*it)->GetBoundaries();
+        double bounds[6] = {box.xMin, box.xMax, box.yMin, box.yMax, box.zMin, box.zMax};
+        int32_t wallType = (*it)->GetExtWallsType();
+        buildings.write(reinterpret_cast<const char*>(bounds), sizeof(bounds));
+        buildings.write(reinterpret_cast<const char*>(&wallType), sizeof(wallType));
+    }
+    std::string bytes = buildings.str();
+    return Hash64(bytes.data(), bytes.size());
+}
+
+bool
+LossMatrixFile::Open(const std::string& path)
+{
+    NS_LOG_FUNCTION(this << path);
+    Close();
+
+#ifdef FOBA_LOSS_FILE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        NS_LOG_WARN("Cannot open the loss file " << path);
+        return false;
+    }
+    struct stat status;
+    if ((fstat(fd, &status) != 0) || (static_cast<size_t>(status.st_size) < sizeof(Header)))
+    {
+        NS_LOG_WARN("Loss file " << path << " is too short");
+        close(fd);
+        return false;
+    }
+    m_size = status.st_size;
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        NS_LOG_WARN("Cannot map the loss file " << path);
+        m_size = 0;
+        return false;
+    }
+    m_mapping = mapping;
+    const char* data = static_cast<const char*>(m_mapping);
+#else
+    std::ifstream file(path, std::ios::binary);
+    m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    m_size = m_buffer.size();
+    if (m_size < sizeof(Header))
+    {
+        NS_LOG_WARN("Cannot read the loss file " << path);
+        Close();
+        return false;
+    }
+    const char* data = m_buffer.data();
+#endif
+
+    m_header = reinterpret_cast<const Header*>(data);
+    const uint64_t n = m_header->nNodes;
+    if ((std::memcmp(m_header->magic, LOSS_FILE_MAGIC, sizeof(LOSS_FILE_MAGIC)) != 0) ||
+        (m_header->version != LOSS_FILE_VERSION) ||
+        (m_size != sizeof(Header) + n * sizeof(NodeRecord) + n * n * sizeof(int16_t)))
+    {
+        NS_LOG_WARN(path << " is not a loss file of version " << LOSS_FILE_VERSION
+                         << " written on a machine with the same byte order");
+        Close();
+        return false;
+    }
+    m_nodes = reinterpret_cast<const NodeRecord*>(data + sizeof(Header));
+    m_losses = reinterpret_cast<const int16_t*>(data + sizeof(Header) + n * sizeof(NodeRecord));
+    return true;
+}
+
+void
+LossMatrixFile::Close()
+{
+#ifdef FOBA_LOSS_FILE_MMAP
+    if (m_mapping)
+    {
+        munmap(m_mapping, m_size);
+    }
+#endif
+    m_mapping = nullptr;
+    m_buffer.clear();
+    m_size = 0;
+    m_header = nullptr;
+    m_nodes = nullptr;
+    m_losses = nullptr;
+    m_index.clear();
+}
+
+bool
+LossMatrixFile::IsOpen() const
+{
+    return m_header != nullptr;
+}
+
+uint32_t
+LossMatrixFile::GetNNodes() const
+{
+    return m_header ? m_header->nNodes : 0;
+}
+
+bool
+LossMatrixFile::Check(double frequency,
+                      double txGain,
+                      uint32_t diffractionMode,
+                      std::string& reason)
+{
+    NS_LOG_FUNCTION(this << frequency << txGain << diffractionMode);
+    NS_ASSERT_MSG(IsOpen(), "No loss file to check");
+    m_index.clear();
+
+    std::ostringstream difference;
+    if ((m_header->frequency != frequency) || (m_header->txGain != txGain))
+    {
+        difference << "written for a frequency of " << m_header->frequency << " Hz and a gain of "
+                   << m_header->txGain << " dB";
+    }
+    else if (m_header->diffraction != diffractionMode)
+    {
+        difference << "written for the diffraction mode " << m_header->diffraction;
+    }
+    else if (m_header->buildingsHash != HashBuildings())
+    {
+        difference << "written for other buildings";
+    }
+    for (uint32_t i = 0; (i < m_header->nNodes) && difference.str().empty(); ++i)
+    {
+        const NodeRecord& record = m_nodes[i];
+        Ptr<MobilityModel> mobility;
+        if (record.id < NodeList::GetNNodes())
+        {
+            mobility = NodeList::GetNode(record.id)->GetObject<MobilityModel>();
+        }
+        if (!mobility)
+        {
+            difference << "node " << record.id << " has no MobilityModel";
+        }
+        else if (Vector position(record.x, record.y, record.z); mobility->GetPosition() != position)
+        {
+            difference << "node " << record.id << " was at " << position;
+        }
+        else
+        {
+            m_index[PeekPointer(mobility)] = i;
+        }
+    }
+    reason = difference.str();
+    if (!reason.empty())
+    {
+        m_index.clear();
+        return false;
+    }
+    return true;
+}
+
+bool
+LossMatrixFile::Lookup(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx, double& loss) const
+{
+    auto a = m_index.find(PeekPointer(rx));
+    auto b = m_index.find(PeekPointer(tx));
+    if ((a == m_index.end()) || (b == m_index.end()))
+    {
+        return false;
+    }
+    // The nodes may have moved since the check
+    const NodeRecord& recordA = m_nodes[a->second];
+    const NodeRecord& recordB = m_nodes[b->second];
+    if ((rx->GetPosition() != Vector(recordA.x, recordA.y, recordA.z)) ||
+        (tx->GetPosition() != Vector(recordB.x, recordB.y, recordB.z)))
+    {
+        return false;
+    }
+    int16_t quantized = m_losses[static_cast<uint64_t>(a->second) * m_header->nNodes + b->second];
+    if (quantized == LOSS_FILE_MISSING)
+    {
+        return false;
+    }
+    loss = quantized / LOSS_FILE_SCALE;
+    return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_LOSS_FILE_H
+#define FOBA_LOSS_FILE_H
+
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief File of the losses between all the pairs of a set of static nodes, served without
+ * parsing.
+ *
+ * The file holds, in the byte order of the machine that wrote it:
+ * - a header: magic "FOBALOSS", format version, number of nodes, frequency, gain and diffraction
+ *   mode of the model, hash of the buildings (see HashBuildings);
+ * - one record per node: its NodeList index and its position;
+ * - the losses without noise, in centi-dB as int16_t (0.005 dB precision, saturated at
+ *   +/-327.67 dB), row i holding the losses GetLoss(node i, node j) of each node j. A loss that
+ *   was not finite is written as -32768, and is not served by Lookup.
+ *
+ * The file is mapped in memory when it is opened, the losses are only read by the lookups. Check
+ * rejects a file written for other buildings, other nodes, or another frequency, gain or
+ * diffraction mode.
+ */
+class LossMatrixFile : public Object
+{
+  public:
+    /**
+     * @brief Get the type ID.
+     * @return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    LossMatrixFile();
+    ~LossMatrixFile() override;
+
+    /**
+     * @brief Write the losses between all the pairs of nodes
+     *
+     * @param path the file to write
+     * @param nodes the nodes, with a MobilityModel aggregated
+     * @param losses the loss GetLoss(node i, node j) (in dB) at i * nodes.GetN() + j
+     * @param frequency the frequency of the model (in Hz)
+     * @param txGain the gain of the model (in dB)
+     * @param diffractionMode the diffraction mode of the model
+     */
+    static void Write(const std::string& path,
+                      NodeContainer nodes,
+                      std::span<const double> losses,
+                      double frequency,
+                      double txGain,
+                      uint32_t diffractionMode);
+
+    /**
+     * @brief Hash the boundaries and the wall types of the buildings of the BuildingList
+     * @return the hash
+     */
+    static uint64_t HashBuildings();
+
+    /**
+     * @brief Map a file in memory
+     *
+     * @param path the file to open
+     * @return false if the file cannot be read or is not a loss file of this version
+     */
+    bool Open(const std::string& path);
+
+    /**
+     * @brief Unmap the file
+     */
+    void Close();
+
+    /**
+     * @return true if a file is mapped
+     */
+    bool IsOpen() const;
+
+    /**
+     * @brief Check that the file was written for the current scenario, and prepare the lookups
+     *
+     * @param frequency the frequency of the model (in Hz)
+     * @param txGain the gain of the model (in dB)
+     * @param diffractionMode the diffraction mode of the model
+     * @param reason set to the first difference with the scenario
+     * @return false if the buildings, the positions of the nodes, the frequency, the gain or the
+     * diffraction mode differ from the ones of the file
+     */
+    bool Check(double frequency, double txGain, uint32_t diffractionMode, std::string& reason);
+
+    /**
+     * @brief Get the loss of a link from the file
+     *
+     * @param rx the first node
+     * @param tx the second node
+     * @param loss set to the loss (in dB) if found
+     * @return false if one of the nodes is not in the file or is no longer at its position, or if
+     * the loss of the link was not finite when the file was written
+     */
+    bool Lookup(Ptr<MobilityModel> rx, Ptr<MobilityModel> tx, double& loss) const;
+
+    /**
+     * @return the number of nodes of the file, 0 if no file is mapped
+     */
+    uint32_t GetNNodes() const;
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * @brief Start of the file
+     */
+    struct Header
+    {
+        char magic[8];          ///< "FOBALOSS"
+        uint32_t version;       ///< format version
+        uint32_t nNodes;        ///< number of nodes
+        double frequency;       ///< frequency of the model (in Hz)
+        double txGain;          ///< gain of the model (in dB)
+        uint64_t buildingsHash; ///< hash of the buildings (see HashBuildings)
+        uint32_t diffraction;   ///< diffraction mode of the model
+        uint32_t reserved;      ///< padding, 0
+    };
+
+    /**
+     * @brief A node of the file
+     */
+    struct NodeRecord
+    {
+        uint32_t id;       ///< NodeList index of the node
+        uint32_t reserved; ///< padding, 0
+        double x;          ///< x coordinate of the node (in m)
+        double y;          ///< y coordinate of the node (in m)
+        double z;          ///< z coordinate of the node (in m)
+    };
+
+    const Header* m_header;                                     ///< Header of the mapped file
+    const NodeRecord* m_nodes;                                  ///< Nodes of the mapped file
+    const int16_t* m_losses;                                    ///< Losses of the mapped file
+    void* m_mapping;                                            ///< Mapped file, or nullptr
+    size_t m_size;                                              ///< Size of the mapped file
+    std::vector<char> m_buffer;                                 ///< File, without mmap support
+    std::unordered_map<const MobilityModel*, uint32_t> m_index; ///< Record of the checked nodes
+};
+
+} // namespace ns3
+
+#endif /* FOBA_LOSS_FILE_H */
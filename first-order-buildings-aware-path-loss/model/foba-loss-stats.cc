@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-loss-stats.h"
+
+#include "ns3/log.h"
+
+#include <cmath>
+#include <fstream>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("LossStatistics");
+
+NS_OBJECT_ENSURE_REGISTERED(LossStatistics);
+
+TypeId
+LossStatistics::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::LossStatistics")
+                            .SetParent<Object>()
+                            .SetGroupName("Buildings")
+                            .AddConstructor<LossStatistics>();
+    return tid;
+}
+
+LossStatistics::LossStatistics()
+    : m_enabled(false)
+{
+    Reset();
+}
+
+LossStatistics::~LossStatistics()
+{
+}
+
+void
+LossStatistics::SetEnabled(bool enabled)
+{
+    NS_LOG_FUNCTION(this << enabled);
+    m_enabled = enabled;
+}
+
+bool
+LossStatistics::IsEnabled() const
+{
+    return m_enabled;
+}
+
+uint64_t
+LossStatistics::GetCount(Counter counter) const
+{
+    return m_counters[counter].load(std::memory_order_relaxed);
+}
+
+uint64_t
+LossStatistics::GetPhaseCount(Phase phase) const
+{
+    uint64_t count = 0;
+    for (const auto& bucket : m_phases[phase].buckets)
+    {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t
+LossStatistics::GetPhaseTotal(Phase phase) const
+{
+    return m_phases[phase].total.load(std::memory_order_relaxed);
+}
+
+uint64_t
+LossStatistics::GetBucket(Phase phase, uint32_t bucket) const
+{
+    NS_ASSERT_MSG(bucket < N_BUCKETS, "No bucket " << bucket);
+    return m_phases[phase].buckets[bucket].load(std::memory_order_relaxed);
+}
+
+double
+LossStatistics::GetPhaseQuantile(Phase phase, double quantile) const
+{
+    uint64_t count = GetPhaseCount(phase);
+    if (count == 0)
+    {
+        return 0.0;
+    }
+    // Rank of the quantile, from 1 to count
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(quantile * count));
+    uint64_t seen = 0;
+    for (uint32_t bucket = 0; bucket < N_BUCKETS; ++bucket)
+    {
+        seen += GetBucket(phase, bucket);
+        if (seen >= rank)
+        {
+            return std::ldexp(1.0, bucket);
+        }
+    }
+    return std::ldexp(1.0, N_BUCKETS - 1);
+}
+
+void
+LossStatistics::Reset()
+{
+    NS_LOG_FUNCTION(this);
+    for (auto& counter : m_counters)
+    {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (auto& phase : m_phases)
+    {
+        phase.total.store(0, std::memory_order_relaxed);
+        for (auto& bucket : phase.buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void
+LossStatistics::Print(std::ostream& os) const
+{
+    os << "counter,count\n";
+    for (uint32_t counter = 0; counter < N_COUNTERS; ++counter)
+    {
+        os << GetCounterName(static_cast<Counter>(counter)) << ","
+           << GetCount(static_cast<Counter>(counter)) << "\n";
+    }
+    os << "\nphase,count,total_ns,mean_ns,p50_ns,p90_ns,p99_ns\n";
+    for (uint32_t i = 0; i < N_PHASES; ++i)
+    {
+        auto phase = static_cast<Phase>(i);
+        uint64_t count = GetPhaseCount(phase);
+        uint64_t total = GetPhaseTotal(phase);
+        os << GetPhaseName(phase) << "," << count << "," << total << ","
+           << ((count > 0) ? static_cast<double>(total) / count : 0.0) << ","
+           << GetPhaseQuantile(phase, 0.5) << "," << GetPhaseQuantile(phase, 0.9) << ","
+           << GetPhaseQuantile(phase, 0.99) << "\n";
+    }
+    // One column per bucket, named after the upper bound of its durations
+    os << "\nphase";
+    for (uint32_t bucket = 0; bucket + 1 < N_BUCKETS; ++bucket)
+    {
+        os << ",lt_" << (uint64_t{1} << bucket) << "ns";
+    }
+    os << ",longer\n";
+    for (uint32_t i = 0; i < N_PHASES; ++i)
+    {
+        auto phase = static_cast<Phase>(i);
+        os << GetPhaseName(phase);
+        for (uint32_t bucket = 0; bucket < N_BUCKETS; ++bucket)
+        {
+            os << "," << GetBucket(phase, bucket);
+        }
+        os << "\n";
+    }
+}
+
+void
+LossStatistics::Dump(std::string path) const
+{
+    NS_LOG_FUNCTION(this << path);
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        NS_LOG_ERROR("Could not open " << path << " to write the loss statistics");
+        return;
+    }
+    Print(file);
+}
+
+std::string
+LossStatistics::GetCounterName(Counter counter)
+{
+    switch (counter)
+    {
+    case CALLS:
+        return "calls";
+    case LINKS:
+        return "links";
+    case FAR_LINKS:
+        return "far_links";
+    case LOS_LINKS:
+        return "los_links";
+    case NLOS_LINKS:
+        return "nlos_links";
+    case BUILDINGS_TESTED:
+        return "buildings_tested";
+    case BUILDINGS_PRUNED:
+        return "buildings_pruned";
+    case CORNERS_EVALUATED:
+        return "corners_evaluated";
+    case REFLECTIONS_EVALUATED:
+        return "reflections_evaluated";
+    case DIFFRACTIONS_PRUNED:
+        return "diffractions_pruned";
+    case REFLECTIONS_PRUNED:
+        return "reflections_pruned";
+    case FACADES_PRUNED:
+        return "facades_pruned";
+    default:
+        return "unknown";
+    }
+}
+
+std::string
+LossStatistics::GetPhaseName(Phase phase)
+{
+    switch (phase)
+    {
+    case LINK_PHASE:
+        return "link";
+    case BUILDING_SCAN_PHASE:
+        return "building_scan";
+    case CORNER_VISIBILITY_PHASE:
+        return "corner_visibility";
+    case REFLECTION_PHASE:
+        return "reflection";
+    case NOISE_PHASE:
+        return "noise";
+    default:
+        return "unknown";
+    }
+}
+
+} // namespace ns3
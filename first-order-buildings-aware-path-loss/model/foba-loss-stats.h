@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_LOSS_STATS_H
+#define FOBA_LOSS_STATS_H
+
+#include "ns3/object.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * @brief Counters and latency histograms of the phases of the loss computation.
+ *
+ * The statistics are only collected while enabled; when disabled, counting or timing a phase is
+ * a single test of a flag and the clock is not read. The counters and the histograms are relaxed
+ * atomics, the threads computing losses at the same time may update them.
+ *
+ * A histogram has one bucket per power of two of nanoseconds: bucket k holds the durations in
+ * [2^(k-1), 2^k) ns, bucket 0 the null durations and the last bucket every longer duration.
+ */
+class LossStatistics : public Object
+{
+  public:
+    /**
+     * @brief Events counted during the loss computation
+     */
+    enum Counter
+    {
+        CALLS,                 ///< losses asked to the model
+        LINKS,                 ///< losses computed from the buildings
+        FAR_LINKS,             ///< links lossy enough to skip the buildings
+        LOS_LINKS,             ///< links with a clear direct path
+        NLOS_LINKS,            ///< links whose direct path crosses buildings
+        BUILDINGS_TESTED,      ///< buildings tested against the direct path of a link
+        BUILDINGS_PRUNED,      ///< buildings skipped by the spatial index
+        CORNERS_EVALUATED,     ///< corner visibilities computed, the cached ones excluded
+        REFLECTIONS_EVALUATED, ///< facades whose reflection point was computed
+        DIFFRACTIONS_PRUNED,   ///< NLOS links whose diffracted path was skipped by its bound
+        REFLECTIONS_PRUNED,    ///< NLOS links whose reflected path was skipped by its bound
+        FACADES_PRUNED,        ///< facades of the search ellipses skipped by their bound
+        N_COUNTERS             ///< number of counters
+    };
+
+    /**
+     * @brief Timed phases of the loss computation
+     */
+    enum Phase
+    {
+        LINK_PHASE,              ///< loss of a link from the buildings, the phases below included
+        BUILDING_SCAN_PHASE,     ///< buildings crossed by the direct path
+        CORNER_VISIBILITY_PHASE, ///< visibility of a diffraction corner
+        REFLECTION_PHASE,        ///< search of the reflected paths
+        NOISE_PHASE,             ///< draw of the noise
+        N_PHASES                 ///< number of phases
+    };
+
+    /// Number of buckets of a histogram
+    static constexpr uint32_t N_BUCKETS = 40;
+
+    /**
+     * @brief Times a phase from its construction to its destruction, if the statistics are
+     * enabled
+     */
+    class Timer
+    {
+      public:
+        /**
+         * @brief Start timing a phase
+         * @param stats the statistics recording the phase
+         * @param phase the phase
+         */
+        Timer(const LossStatistics& stats, Phase phase)
+            : m_stats(stats.m_enabled ? &stats : nullptr),
+              m_phase(phase)
+        {
+            if (m_stats)
+            {
+                m_start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~Timer()
+        {
+            if (m_stats)
+            {
+                auto duration = std::chrono::steady_clock::now() - m_start;
+                m_stats->Record(
+                    m_phase,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+            }
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+      private:
+        const LossStatistics* m_stats;                 ///< Statistics, null if disabled
+        Phase m_phase;                                 ///< Timed phase
+        std::chrono::steady_clock::time_point m_start; ///< Start of the phase
+    };
+
+    /**
+     * @brief Get the type ID.
+     * @return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    LossStatistics();
+    ~LossStatistics() override;
+
+    /**
+     * @brief Enable or disable the collection of the statistics, the collected ones are kept
+     * @param enabled true to collect the statistics
+     */
+    void SetEnabled(bool enabled);
+
+    /**
+     * @return true if the statistics are collected
+     */
+    bool IsEnabled() const;
+
+    /**
+     * @brief Count events, if the statistics are enabled
+     * @param counter the counter of the events
+     * @param n the number of events
+     */
+    void Add(Counter counter, uint64_t n = 1) const
+    {
+        if (m_enabled)
+        {
+            m_counters[counter].fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @param counter a counter
+     * @return the number of events counted
+     */
+    uint64_t GetCount(Counter counter) const;
+
+    /**
+     * @param phase a phase
+     * @return the number of times the phase was timed
+     */
+    uint64_t GetPhaseCount(Phase phase) const;
+
+    /**
+     * @param phase a phase
+     * @return the total duration of the phase (in ns)
+     */
+    uint64_t GetPhaseTotal(Phase phase) const;
+
+    /**
+     * @param phase a phase
+     * @param bucket a bucket of the histogram (0 to N_BUCKETS - 1)
+     * @return the number of durations of the phase in the bucket
+     */
+    uint64_t GetBucket(Phase phase, uint32_t bucket) const;
+
+    /**
+     * @brief Upper bound of a quantile of the durations of a phase, from its histogram
+     * @param phase a phase
+     * @param quantile the quantile (0 to 1)
+     * @return the upper bound of the bucket holding the quantile (in ns), 0 if the phase was never
+     * timed
+     */
+    double GetPhaseQuantile(Phase phase, double quantile) const;
+
+    /**
+     * @brief Clear the counters and the histograms
+     */
+    void Reset();
+
+    /**
+     * @brief Print the counters, and the duration and histogram of each phase
+     * @param os the output stream
+     */
+    void Print(std::ostream& os) const;
+
+    /**
+     * @brief Print the statistics to a file, replacing its content
+     * @param path the path of the file
+     */
+    void Dump(std::string path) const;
+
+    /**
+     * @param counter a counter
+     * @return the name of the counter
+     */
+    static std::string GetCounterName(Counter counter);
+
+    /**
+     * @param phase a phase
+     * @return the name of the phase
+     */
+    static std::string GetPhaseName(Phase phase);
+
+  private:
+    /**
+     * @brief Add a duration to a phase
+     * @param phase the phase
+     * @param nanoseconds the duration (in ns)
+     */
+    void Record(Phase phase, uint64_t nanoseconds) const
+    {
+        uint32_t bucket = std::min<uint32_t>(std::bit_width(nanoseconds), N_BUCKETS - 1);
+        m_phases[phase].buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_phases[phase].total.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Durations of a phase
+     */
+    struct PhaseDurations
+    {
+        std::atomic<uint64_t> total;                          ///< total duration (in ns)
+        std::array<std::atomic<uint64_t>, N_BUCKETS> buckets; ///< histogram of the durations
+    };
+
+    bool m_enabled;                                                   ///< True to collect
+    mutable std::array<std::atomic<uint64_t>, N_COUNTERS> m_counters; ///< Counted events
+    mutable std::array<PhaseDurations, N_PHASES> m_phases;            ///< Durations of the phases
+};
+
+} // namespace ns3
+
+#endif /* FOBA_LOSS_STATS_H */
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-philox.h"
+
+namespace ns3
+{
+
+/// Multipliers of the Philox4x32 rounds
+static const uint32_t PHILOX_M0 = 0xD2511F53;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57;
+/// Increments of the key between the rounds (golden ratio and sqrt(3) - 1)
+static const uint32_t PHILOX_W0 = 0x9E3779B9;
+static const uint32_t PHILOX_W1 = 0xBB67AE85;
+
+PhiloxCounter
+Philox4x32(PhiloxCounter counter, uint64_t key)
+{
+    uint32_t k0 = static_cast<uint32_t>(key);
+    uint32_t k1 = static_cast<uint32_t>(key >> 32);
+    for (int round = 0; round < 10; ++round)
+    {
+        uint64_t product0 = static_cast<uint64_t>(PHILOX_M0) * counter[0];
+        uint64_t product1 = static_cast<uint64_t>(PHILOX_M1) * counter[2];
+        counter = {static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ k0,
+                   static_cast<uint32_t>(product1),
+                   static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ k1,
+                   static_cast<uint32_t>(product0)};
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    return counter;
+}
+
+double
+PhiloxUniform(const PhiloxCounter& counter, uint64_t key)
+{
+    PhiloxCounter words = Philox4x32(counter, key);
+    uint64_t bits = (static_cast<uint64_t>(words[0]) << 32) | words[1];
+    return static_cast<double>(bits >> 11) * 0x1.0p-53;
+}
+
+} // namespace ns3
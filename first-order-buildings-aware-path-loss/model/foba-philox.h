@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_PHILOX_H
+#define FOBA_PHILOX_H
+
+#include <array>
+#include <cstdint>
+
+namespace ns3
+{
+
+/**
+ * @brief Counter of a Philox4x32 draw
+ */
+using PhiloxCounter = std::array<uint32_t, 4>;
+
+/**
+ * @brief Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy
+ * as 1, 2, 3", SC 2011).
+ *
+ * A draw only depends on its key and its counter: the draws of distinct counters can be made in
+ * any order, by any thread, and the generator has no state.
+ *
+ * @param counter the counter of the draw
+ * @param key the key of the draw, the low 32 bits being the first word of the Philox key
+ * @return 4 random words
+ */
+PhiloxCounter Philox4x32(PhiloxCounter counter, uint64_t key);
+
+/**
+ * @brief Uniform draw in [0, 1) from the first two words of Philox4x32(counter, key)
+ *
+ * @param counter the counter of the draw
+ * @param key the key of the draw
+ * @return a uniform value in [0, 1), with 53 random bits
+ */
+double PhiloxUniform(const PhiloxCounter& counter, uint64_t key);
+
+} // namespace ns3
+
+#endif /* FOBA_PHILOX_H */
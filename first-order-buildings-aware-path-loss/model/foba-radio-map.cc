@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-radio-map.h"
+
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("RadioMapCache");
+
+NS_OBJECT_ENSURE_REGISTERED(RadioMapCache);
+
+TypeId
+RadioMapCache::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::RadioMapCache")
+            .SetParent<Object>()
+            .SetGroupName("Buildings")
+            .AddConstructor<RadioMapCache>()
+            .AddAttribute("Resolution",
+                          "Edge length of the cells of the maps (in m).",
+                          DoubleValue(2.0),
+                          MakeDoubleAccessor(&RadioMapCache::SetResolution,
+                                             &RadioMapCache::GetResolution),
+                          MakeDoubleChecker<double>(0.01))
+            .AddAttribute("Tolerance",
+                          "Largest spread of the losses of the vertices of an interpolated cell "
+                          "(in dB), the other cells are computed exactly. An interpolated loss "
+                          "is within the tolerance of the loss of each vertex of its cell, not "
+                          "necessarily of the exact loss at its position.",
+                          DoubleValue(1.0),
+                          MakeDoubleAccessor(&RadioMapCache::SetTolerance,
+                                             &RadioMapCache::GetTolerance),
+                          MakeDoubleChecker<double>(0.0))
+            .AddAttribute("LayerHeight",
+                          "Distance between the horizontal layers of the maps (in m), the "
+                          "heights between two layers are interpolated from both.",
+                          DoubleValue(0.5),
+                          MakeDoubleAccessor(&RadioMapCache::SetLayerHeight,
+                                             &RadioMapCache::GetLayerHeight),
+                          MakeDoubleChecker<double>(0.01))
+            .AddAttribute("MaxVertices",
+                          "Number of vertices of all the maps above which the maps are dropped "
+                          "(about 64 bytes per vertex).",
+                          UintegerValue(1000000),
+                          MakeUintegerAccessor(&RadioMapCache::SetMaxVertices,
+                                               &RadioMapCache::GetMaxVertices),
+                          MakeUintegerChecker<uint64_t>(8));
+    return tid;
+}
+
+RadioMapCache::RadioMapCache()
+    : m_resolution(2.0),
+      m_tolerance(1.0),
+      m_layerHeight(0.5),
+      m_maxVertices(1000000),
+      m_nVertices(0),
+      m_epoch(0),
+      m_interpolated(0),
+      m_rejected(0)
+{
+}
+
+RadioMapCache::~RadioMapCache()
+{
+    // The models may outlive a cache that was not disposed
+    Clear();
+}
+
+void
+RadioMapCache::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Clear();
+    Object::DoDispose();
+}
+
+void
+RadioMapCache::SetResolution(double resolution)
+{
+    NS_LOG_FUNCTION(this << resolution);
+    NS_ASSERT_MSG(resolution > 0, "Empty cells");
+    Clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_resolution = resolution;
+}
+
+double
+RadioMapCache::GetResolution() const
+{
+    return m_resolution;
+}
+
+void
+RadioMapCache::SetTolerance(double tolerance)
+{
+    NS_LOG_FUNCTION(this << tolerance);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tolerance = tolerance;
+}
+
+double
+RadioMapCache::GetTolerance() const
+{
+    return m_tolerance;
+}
+
+void
+RadioMapCache::SetLayerHeight(double height)
+{
+    NS_LOG_FUNCTION(this << height);
+    NS_ASSERT_MSG(height > 0, "Empty layers");
+    Clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_layerHeight = height;
+}
+
+double
+RadioMapCache::GetLayerHeight() const
+{
+    return m_layerHeight;
+}
+
+void
+RadioMapCache::SetMaxVertices(uint64_t vertices)
+{
+    NS_LOG_FUNCTION(this << vertices);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxVertices = vertices;
+    if (m_nVertices > m_maxVertices)
+    {
+        DropMaps();
+    }
+}
+
+uint64_t
+RadioMapCache::GetMaxVertices() const
+{
+    return m_maxVertices;
+}
+
+size_t
+RadioMapCache::VertexHash::operator()(const Vertex& vertex) const
+{
+    size_t hash = std::hash<int64_t>()(vertex.x);
+    hash = hash * 31 + std::hash<int64_t>()(vertex.y);
+    return hash * 31 + std::hash<int64_t>()(vertex.z);
+}
+
+bool
+RadioMapCache::Interpolate(Ptr<MobilityModel> fixed,
+                           bool fixedIsSource,
+                           const Vector& position,
+                           const std::function<double(const Vector&)>& compute,
+                           double& loss)
+{
+    // The vertices of the cell, on the layers below and above the position, or on the layer of
+    // the position
+    std::array<Vertex, 8> vertices;
+    std::array<double, 8> losses;
+    std::array<bool, 8> missing{};
+    double u = 0;
+    double v = 0;
+    double w = 0;
+    int n = 4;
+    uint64_t epoch = 0;
+    double resolution = 0;
+    double layerHeight = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        DisconnectReleased();
+        auto [it, inserted] = m_tracked.try_emplace(PeekPointer(fixed));
+        if (inserted)
+        {
+            NS_LOG_FUNCTION(this << fixed);
+            it->second.model = fixed;
+            fixed->TraceConnectWithoutContext(
+                "CourseChange",
+                MakeCallback(&RadioMapCache::NotifyCourseChange, this));
+        }
+        const Map& map = it->second.maps[fixedIsSource ? 1 : 0];
+        resolution = m_resolution;
+        layerHeight = m_layerHeight;
+        u = position.x / resolution;
+        v = position.y / resolution;
+        w = position.z / layerHeight;
+        if (w < 1)
+        {
+            // Below the first layer above the ground, whose losses are not defined
+            ++m_rejected;
+            return false;
+        }
+        const int64_t x = std::floor(u);
+        const int64_t y = std::floor(v);
+        const int64_t z = std::floor(w);
+        n = (w > z) ? 8 : 4;
+        for (int k = 0; k < n; ++k)
+        {
+            vertices[k] = Vertex{x + (k & 1), y + ((k >> 1) & 1), z + (k >> 2)};
+            auto vertexIt = map.find(vertices[k]);
+            missing[k] = (vertexIt == map.end());
+            losses[k] = missing[k] ? 0 : vertexIt->second;
+        }
+        epoch = m_epoch;
+    }
+
+    for (int k = 0; k < n; ++k)
+    {
+        if (missing[k])
+        {
+            losses[k] = compute(Vector(vertices[k].x * resolution,
+                                       vertices[k].y * resolution,
+                                       vertices[k].z * layerHeight));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_tracked.find(PeekPointer(fixed));
+    if ((m_epoch == epoch) && (it != m_tracked.end()))
+    {
+        // The maps did not drop vertices meanwhile, the losses are of the current position
+        Map& map = it->second.maps[fixedIsSource ? 1 : 0];
+        for (int k = 0; k < n; ++k)
+        {
+            if (missing[k] && map.try_emplace(vertices[k], losses[k]).second)
+            {
+                ++m_nVertices;
+            }
+        }
+        if (m_nVertices > m_maxVertices)
+        {
+            NS_LOG_DEBUG("Dropping the maps, " << m_nVertices << " vertices");
+            DropMaps();
+        }
+    }
+    auto [lowest, highest] = std::minmax_element(losses.begin(), losses.begin() + n);
+    if (*highest - *lowest > m_tolerance)
+    {
+        ++m_rejected;
+        return false;
+    }
+    const double fx = u - vertices[0].x;
+    const double fy = v - vertices[0].y;
+    auto bilinear = [fx, fy](const double* corners) {
+        return (1 - fy) * ((1 - fx) * corners[0] + fx * corners[1]) +
+               fy * ((1 - fx) * corners[2] + fx * corners[3]);
+    };
+    loss = bilinear(losses.data());
+    if (n == 8)
+    {
+        const double fz = w - vertices[0].z;
+        loss = (1 - fz) * loss + fz * bilinear(losses.data() + 4);
+    }
+    ++m_interpolated;
+    return true;
+}
+
+void
+RadioMapCache::Clear()
+{
+    NS_LOG_FUNCTION(this);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    DisconnectReleased();
+    for (auto& [address, tracked] : m_tracked)
+    {
+        tracked.model->TraceDisconnectWithoutContext(
+            "CourseChange",
+            MakeCallback(&RadioMapCache::NotifyCourseChange, this));
+    }
+    m_tracked.clear();
+    m_nVertices = 0;
+    ++m_epoch;
+}
+
+void
+RadioMapCache::DropMaps()
+{
+    for (auto& [address, tracked] : m_tracked)
+    {
+        tracked.maps[0].clear();
+        tracked.maps[1].clear();
+    }
+    m_nVertices = 0;
+    ++m_epoch;
+}
+
+uint64_t
+RadioMapCache::GetNVertices() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_nVertices;
+}
+
+uint64_t
+RadioMapCache::GetInterpolated() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_interpolated;
+}
+
+uint64_t
+RadioMapCache::GetRejected() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rejected;
+}
+
+void
+RadioMapCache::NotifyCourseChange(Ptr<const MobilityModel> model)
+{
+    NS_LOG_FUNCTION(this << model);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_tracked.find(PeekPointer(model));
+    if (it != m_tracked.end())
+    {
+        // The node is followed again on its next lookup as a fixed node
+        m_nVertices -= it->second.maps[0].size() + it->second.maps[1].size();
+        m_released.push_back(it->second.model);
+        m_tracked.erase(it);
+        ++m_epoch;
+    }
+}
+
+void
+RadioMapCache::DisconnectReleased()
+{
+    for (const auto& model : m_released)
+    {
+        // Called before any new connection, so a node followed again keeps its new one
+        model->TraceDisconnectWithoutContext(
+            "CourseChange",
+            MakeCallback(&RadioMapCache::NotifyCourseChange, this));
+    }
+    m_released.clear();
+}
+
+} // namespace ns3
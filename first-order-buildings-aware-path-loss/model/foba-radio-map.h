@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_RADIO_MAP_H
+#define FOBA_RADIO_MAP_H
+
+#include "ns3/mobility-model.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/vector.h"
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Radio maps of the fixed nodes: the loss between a fixed node and the vertices of a
+ * regular grid, interpolated for the positions in between.
+ *
+ * The grid has horizontal layers every LayerHeight, the heights of the other end of the links
+ * falling between two layers. The vertices are computed the first time a position of one of their
+ * cells is looked up, so a map only covers the area its links go through. A cell is only
+ * interpolated (trilinear, bilinear on a layer) if the losses of its vertices are within the
+ * tolerance of each other: the cells crossed by the edge of a shadow, or close to the fixed node,
+ * are computed exactly. A node is no longer followed once its CourseChange trace fires, its maps
+ * being dropped, and the maps of all the nodes are dropped once they hold more than MaxVertices
+ * vertices.
+ *
+ * The tolerance bounds the spread of the losses of the vertices, so an interpolated loss is within
+ * the tolerance of the exact loss of each vertex of its cell. It does not bound the error at the
+ * position itself: a building, or a gap between buildings, smaller than the resolution can hide
+ * between the vertices of a cell, so the resolution should stay below the size of the buildings
+ * and of the streets.
+ *
+ * The vertices missing from a map are computed without holding the lock of the cache, so that
+ * the threads looking up other maps, or other cells, do not wait for them.
+ */
+class RadioMapCache : public Object
+{
+  public:
+    /**
+     * @brief Get the type ID.
+     * @return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    RadioMapCache();
+    ~RadioMapCache() override;
+
+    /**
+     * @brief Set the edge length of the cells of the maps, and drop the maps
+     * @param resolution the edge length (in m)
+     */
+    void SetResolution(double resolution);
+
+    /**
+     * @return the edge length of the cells of the maps (in m)
+     */
+    double GetResolution() const;
+
+    /**
+     * @brief Set the largest spread of the losses of the vertices of an interpolated cell
+     * @param tolerance the spread (in dB)
+     */
+    void SetTolerance(double tolerance);
+
+    /**
+     * @return the largest spread of the losses of the vertices of an interpolated cell (in dB)
+     */
+    double GetTolerance() const;
+
+    /**
+     * @brief Set the distance between the layers of the maps, and drop the maps
+     * @param height the distance (in m)
+     */
+    void SetLayerHeight(double height);
+
+    /**
+     * @return the distance between the layers of the maps (in m)
+     */
+    double GetLayerHeight() const;
+
+    /**
+     * @brief Set the number of vertices above which all the maps are dropped
+     * @param vertices the number of vertices
+     */
+    void SetMaxVertices(uint64_t vertices);
+
+    /**
+     * @return the number of vertices above which all the maps are dropped
+     */
+    uint64_t GetMaxVertices() const;
+
+    /**
+     * @brief Interpolate the loss between a fixed node and a position from the map of the node
+     *
+     * @param fixed the mobility model of the fixed node
+     * @param fixedIsSource true if the fixed node is the source of the links (tx of GetLoss)
+     * @param position the position of the other end of the link
+     * @param compute computes the loss between the fixed node and a vertex of the map, called
+     * without holding the lock of the cache
+     * @param loss set to the interpolated loss (in dB)
+     * @return false if the cell of the position is not smooth enough to be interpolated
+     */
+    bool Interpolate(Ptr<MobilityModel> fixed,
+                     bool fixedIsSource,
+                     const Vector& position,
+                     const std::function<double(const Vector&)>& compute,
+                     double& loss);
+
+    /**
+     * @brief Drop all the maps
+     */
+    void Clear();
+
+    /**
+     * @return the number of vertices computed in all the maps
+     */
+    uint64_t GetNVertices() const;
+
+    /**
+     * @return the number of lookups served by an interpolation
+     */
+    uint64_t GetInterpolated() const;
+
+    /**
+     * @return the number of lookups whose cell was not smooth enough
+     */
+    uint64_t GetRejected() const;
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * @brief A vertex of a map: its indices along x and y, and the index of its layer
+     */
+    struct Vertex
+    {
+        int64_t x; ///< index along x
+        int64_t y; ///< index along y
+        int64_t z; ///< index of the layer
+
+        /**
+         * @brief Compare two vertices
+         * @param other the other vertex
+         * @return true if the vertices are the same
+         */
+        bool operator==(const Vertex& other) const
+        {
+            return (x == other.x) && (y == other.y) && (z == other.z);
+        }
+    };
+
+    /**
+     * @brief Hash of a vertex
+     */
+    struct VertexHash
+    {
+        /**
+         * @brief Hash a vertex
+         * @param vertex the vertex
+         * @return the hash
+         */
+        size_t operator()(const Vertex& vertex) const;
+    };
+
+    /// Loss of the computed vertices of a map
+    using Map = std::unordered_map<Vertex, double, VertexHash>;
+
+    /**
+     * @brief A fixed node followed by the cache
+     */
+    struct Tracked
+    {
+        Ptr<MobilityModel> model; ///< the model, kept to disconnect from its trace
+        Map maps[2];              ///< map of the node as destination (0) and as source (1)
+    };
+
+    /**
+     * @brief Drop the maps of a node and stop following it
+     *
+     * The node is only disconnected from its trace on the next Interpolate or Clear, as its trace
+     * is running.
+     *
+     * @param model the model whose course changed
+     */
+    void NotifyCourseChange(Ptr<const MobilityModel> model);
+
+    /**
+     * @brief Disconnect the nodes no longer followed from their trace, called with m_mutex held
+     */
+    void DisconnectReleased();
+
+    /**
+     * @brief Drop the maps of all the nodes, keeping them followed, called with m_mutex held
+     */
+    void DropMaps();
+
+    double m_resolution;                                         ///< Edge of the cells (in m)
+    double m_tolerance;                                          ///< Spread of a cell (in dB)
+    double m_layerHeight;                                        ///< Between the layers (in m)
+    uint64_t m_maxVertices;                                      ///< Vertices before a drop
+    std::unordered_map<const MobilityModel*, Tracked> m_tracked; ///< Followed fixed nodes
+    std::vector<Ptr<MobilityModel>> m_released;                  ///< To disconnect from trace
+    uint64_t m_nVertices;                                        ///< Vertices of all the maps
+    uint64_t m_epoch;                                            ///< Drops of vertices
+    uint64_t m_interpolated;                                     ///< Interpolated lookups
+    uint64_t m_rejected;                                         ///< Lookups of uneven cells
+    mutable std::mutex m_mutex;                                  ///< Protects the maps
+};
+
+} // namespace ns3
+
+#endif /* FOBA_RADIO_MAP_H */
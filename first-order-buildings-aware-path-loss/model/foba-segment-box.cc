@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-segment-box.h"
+
+#include "ns3/log.h"
+
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define FOBA_SEGMENT_BOX_X86
+#include <immintrin.h>
+#endif
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("FobaSegmentBox");
+
+/**
+ * @brief A segment, as used by the tests against each box
+ */
+struct Segment
+{
+    double origin[3]; ///< first end of the segment
+    double delta[3];  ///< second end minus first end
+    bool moving[3];   ///< true if the segment moves along the axis
+};
+
+/**
+ * @brief Build the segment between two points
+ * @param a first end of the segment
+ * @param b second end of the segment
+ * @return the segment
+ */
+static Segment
+MakeSegment(const Vector& a, const Vector& b)
+{
+    Segment s;
+    s.origin[0] = a.x;
+    s.origin[1] = a.y;
+    s.origin[2] = a.z;
+    s.delta[0] = b.x - a.x;
+    s.delta[1] = b.y - a.y;
+    s.delta[2] = b.z - a.z;
+    for (int k = 0; k < 3; ++k)
+    {
+        s.moving[k] = (s.delta[k] != 0);
+    }
+    return s;
+}
+
+/**
+ * @brief Slab test of a segment against one box
+ * @param s the segment
+ * @param lo lower bounds of the box (x, y, z)
+ * @param hi upper bounds of the box (x, y, z)
+ * @return true if the segment intersects the box
+ */
+static inline bool
+SlabTest(const Segment& s, const double lo[3], const double hi[3])
+{
+    double tMin = 0;
+    double tMax = 1;
+    for (int k = 0; k < 3; ++k)
+    {
+        if (!s.moving[k])
+        {
+            if ((lo[k] > s.origin[k]) || (s.origin[k] > hi[k]))
+            {
+                return false;
+            }
+            continue;
+        }
+        double t1 = (lo[k] - s.origin[k]) / s.delta[k];
+        double t2 = (hi[k] - s.origin[k]) / s.delta[k];
+        tMin = std::max(tMin, std::min(t1, t2));
+        tMax = std::min(tMax, std::max(t1, t2));
+    }
+    return tMin <= tMax;
+}
+
+/**
+ * @brief Slab test of a segment against one box of a set
+ * @param s the segment
+ * @param boxes the bounds of the boxes
+ * @param index index of the box
+ * @return true if the segment intersects the box
+ */
+static inline bool
+SlabTest(const Segment& s, const BoxArrays& boxes, uint32_t index)
+{
+    const double lo[3] = {boxes.xMin[index], boxes.yMin[index], boxes.zMin[index]};
+    const double hi[3] = {boxes.xMax[index], boxes.yMax[index], boxes.zMax[index]};
+    return SlabTest(s, lo, hi);
+}
+
+/**
+ * @brief Scalar implementation of FilterSegmentIntersections
+ * @param s the segment
+ * @param boxes the bounds of the boxes
+ * @param indices indices of the boxes to test, or nullptr
+ * @param first position of the first box to test in indices (or its index)
+ * @param n position after the last box to test in indices (or its index)
+ * @param out indices of the intersected boxes
+ * @param count number of intersected boxes already in out
+ * @return the number of intersected boxes in out
+ */
+static uint32_t
+FilterScalar(const Segment& s,
+             const BoxArrays& boxes,
+             const uint32_t* indices,
+             uint32_t first,
+             uint32_t n,
+             uint32_t* out,
+             uint32_t count)
+{
+    for (uint32_t i = first; i < n; ++i)
+    {
+        uint32_t index = indices ? indices[i] : i;
+        if (SlabTest(s, boxes, index))
+        {
+            out[count++] = index;
+        }
+    }
+    return count;
+}
+
+#ifdef FOBA_SEGMENT_BOX_X86
+
+/**
+ * @brief Append the indices of a block of boxes selected by a mask
+ * @param mask bit i set if the box i of the block is intersected
+ * @param lanes number of boxes in the block
+ * @param indices indices of the boxes to test, or nullptr
+ * @param first position of the block in indices (or index of its first box)
+ * @param out indices of the intersected boxes
+ * @param count number of intersected boxes already in out
+ * @return the number of intersected boxes in out
+ */
+static inline uint32_t
+AppendMasked(uint32_t mask,
+             uint32_t lanes,
+             const uint32_t* indices,
+             uint32_t first,
+             uint32_t* out,
+             uint32_t count)
+{
+    for (uint32_t lane = 0; lane < lanes; ++lane)
+    {
+        if (mask & (1U << lane))
+        {
+            out[count++] = indices ? indices[first + lane] : first + lane;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief AVX2 implementation of FilterSegmentIntersections, 4 boxes at a time
+ * @param s the segment
+ * @param boxes the bounds of the boxes
+ * @param indices indices of the boxes to test, or nullptr
+ * @param n number of boxes to test
+ * @param out indices of the intersected boxes
+ * @return the number of intersected boxes
+ */
+__attribute__((target("avx2"))) static uint32_t
+FilterAvx2(const Segment& s,
+           const BoxArrays& boxes,
+           const uint32_t* indices,
+           uint32_t n,
+           uint32_t* out)
+{
+    const double* lo[3] = {boxes.xMin, boxes.yMin, boxes.zMin};
+    const double* hi[3] = {boxes.xMax, boxes.yMax, boxes.zMax};
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i index = indices ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i))
+                                : _mm_setzero_si128();
+        __m256d tMin = _mm256_setzero_pd();
+        __m256d tMax = _mm256_set1_pd(1.0);
+        __m256d inside = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        for (int k = 0; k < 3; ++k)
+        {
+            __m256d l = indices ? _mm256_i32gather_pd(lo[k], index, 8) : _mm256_loadu_pd(lo[k] + i);
+            __m256d h = indices ? _mm256_i32gather_pd(hi[k], index, 8) : _mm256_loadu_pd(hi[k] + i);
+            __m256d o = _mm256_set1_pd(s.origin[k]);
+            if (!s.moving[k])
+            {
+                inside = _mm256_and_pd(inside,
+                                       _mm256_and_pd(_mm256_cmp_pd(l, o, _CMP_LE_OQ),
+                                                     _mm256_cmp_pd(o, h, _CMP_LE_OQ)));
+                continue;
+            }
+            __m256d d = _mm256_set1_pd(s.delta[k]);
+            __m256d t1 = _mm256_div_pd(_mm256_sub_pd(l, o), d);
+            __m256d t2 = _mm256_div_pd(_mm256_sub_pd(h, o), d);
+            tMin = _mm256_max_pd(tMin, _mm256_min_pd(t1, t2));
+            tMax = _mm256_min_pd(tMax, _mm256_max_pd(t1, t2));
+        }
+        __m256d hit = _mm256_and_pd(inside, _mm256_cmp_pd(tMin, tMax, _CMP_LE_OQ));
+        count = AppendMasked(_mm256_movemask_pd(hit), 4, indices, i, out, count);
+    }
+    return FilterScalar(s, boxes, indices, i, n, out, count);
+}
+
+/**
+ * @brief AVX-512 implementation of FilterSegmentIntersections, 8 boxes at a time
+ * @param s the segment
+ * @param boxes the bounds of the boxes
+ * @param indices indices of the boxes to test, or nullptr
+ * @param n number of boxes to test
+ * @param out indices of the intersected boxes
+ * @return the number of intersected boxes
+ */
+__attribute__((target("avx512f"))) static uint32_t
+FilterAvx512(const Segment& s,
+             const BoxArrays& boxes,
+             const uint32_t* indices,
+             uint32_t n,
+             uint32_t* out)
+{
+    const double* lo[3] = {boxes.xMin, boxes.yMin, boxes.zMin};
+    const double* hi[3] = {boxes.xMax, boxes.yMax, boxes.zMax};
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i index = indices ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i))
+                                : _mm256_setzero_si256();
+        __m512d tMin = _mm512_setzero_pd();
+        __m512d tMax = _mm512_set1_pd(1.0);
+        __mmask8 inside = 0xff;
+        for (int k = 0; k < 3; ++k)
+        {
+            __m512d l = indices ? _mm512_i32gather_pd(index, lo[k], 8) : _mm512_loadu_pd(lo[k] + i);
+            __m512d h = indices ? _mm512_i32gather_pd(index, hi[k], 8) : _mm512_loadu_pd(hi[k] + i);
+            __m512d o = _mm512_set1_pd(s.origin[k]);
+            if (!s.moving[k])
+            {
+                inside &= _mm512_cmp_pd_mask(l, o, _CMP_LE_OQ) &
+                          _mm512_cmp_pd_mask(o, h, _CMP_LE_OQ);
+                continue;
+            }
+            __m512d d = _mm512_set1_pd(s.delta[k]);
+            __m512d t1 = _mm512_div_pd(_mm512_sub_pd(l, o), d);
+            __m512d t2 = _mm512_div_pd(_mm512_sub_pd(h, o), d);
+            tMin = _mm512_max_pd(tMin, _mm512_min_pd(t1, t2));
+            tMax = _mm512_min_pd(tMax, _mm512_max_pd(t1, t2));
+        }
+        __mmask8 hit = inside & _mm512_cmp_pd_mask(tMin, tMax, _CMP_LE_OQ);
+        count = AppendMasked(hit, 8, indices, i, out, count);
+    }
+    return FilterScalar(s, boxes, indices, i, n, out, count);
+}
+
+#endif /* FOBA_SEGMENT_BOX_X86 */
+
+/// Signature of the implementations of FilterSegmentIntersections
+using FilterFunction = uint32_t (*)(const Segment&,
+                                    const BoxArrays&,
+                                    const uint32_t*,
+                                    uint32_t,
+                                    uint32_t*);
+
+/**
+ * @brief Scalar implementation of FilterSegmentIntersections, with the signature of the
+ * vectorized ones
+ * @param s the segment
+ * @param boxes the bounds of the boxes
+ * @param indices indices of the boxes to test, or nullptr
+ * @param n number of boxes to test
+ * @param out indices of the intersected boxes
+ * @return the number of intersected boxes
+ */
+static uint32_t
+FilterScalar(const Segment& s,
+             const BoxArrays& boxes,
+             const uint32_t* indices,
+             uint32_t n,
+             uint32_t* out)
+{
+    return FilterScalar(s, boxes, indices, 0, n, out, 0);
+}
+
+/**
+ * @brief Select the implementation for the instruction sets supported by the processor
+ * @return the implementation
+ */
+static FilterFunction
+SelectFilter()
+{
+#ifdef FOBA_SEGMENT_BOX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        NS_LOG_INFO("Segment-box intersections tested with AVX-512");
+        return &FilterAvx512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        NS_LOG_INFO("Segment-box intersections tested with AVX2");
+        return &FilterAvx2;
+    }
+#endif
+    NS_LOG_INFO("Segment-box intersections tested without SIMD");
+    return &FilterScalar;
+}
+
+bool
+SegmentIntersectsBox(const Vector& a, const Vector& b, const Box& box)
+{
+    const double lo[3] = {box.xMin, box.yMin, box.zMin};
+    const double hi[3] = {box.xMax, box.yMax, box.zMax};
+    return SlabTest(MakeSegment(a, b), lo, hi);
+}
+
+uint32_t
+FilterSegmentIntersections(const Vector& a,
+                           const Vector& b,
+                           const BoxArrays& boxes,
+                           const uint32_t* indices,
+                           uint32_t n,
+                           uint32_t* out)
+{
+    static const FilterFunction filter = SelectFilter();
+    return filter(MakeSegment(a, b), boxes, indices, n, out);
+}
+
+} // namespace ns3
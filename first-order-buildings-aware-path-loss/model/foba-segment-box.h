@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_SEGMENT_BOX_H
+#define FOBA_SEGMENT_BOX_H
+
+#include "ns3/box.h"
+#include "ns3/vector.h"
+
+#include <cstdint>
+
+namespace ns3
+{
+
+/**
+ * @brief Bounds of a set of axis aligned boxes, stored as structure of arrays
+ */
+struct BoxArrays
+{
+    const double* xMin; ///< lower x bound of each box
+    const double* xMax; ///< upper x bound of each box
+    const double* yMin; ///< lower y bound of each box
+    const double* yMax; ///< upper y bound of each box
+    const double* zMin; ///< lower z bound of each box
+    const double* zMax; ///< upper z bound of each box
+};
+
+/**
+ * @brief Check if the segment between two points intersects a box.
+ *
+ * Slab test: the segment intersects the box if the intervals of the segment parameter in which
+ * it is between the bounds of each axis overlap. The box is closed, a segment touching a wall,
+ * an edge or a corner intersects it. An axis along which the segment does not move only checks
+ * that the segment is between the bounds, so no division by zero occurs.
+ *
+ * @param a first end of the segment
+ * @param b second end of the segment
+ * @param box the box
+ * @return true if the segment intersects the box
+ */
+bool SegmentIntersectsBox(const Vector& a, const Vector& b, const Box& box);
+
+/**
+ * @brief Keep the boxes of a set that are intersected by the segment between two points.
+ *
+ * Same test as SegmentIntersectsBox, run on 8 (AVX-512) or 4 (AVX2) boxes at a time when the
+ * processor supports it, the instruction set is selected at run time. All the implementations
+ * give the same result.
+ *
+ * @param a first end of the segment
+ * @param b second end of the segment
+ * @param boxes the bounds of the boxes
+ * @param indices indices of the boxes to test, or nullptr to test the boxes 0 to n - 1
+ * @param n number of boxes to test
+ * @param out indices of the intersected boxes, in the order they were tested (n entries are
+ * available, may be indices)
+ * @return the number of intersected boxes
+ */
+uint32_t FilterSegmentIntersections(const Vector& a,
+                                    const Vector& b,
+                                    const BoxArrays& boxes,
+                                    const uint32_t* indices,
+                                    uint32_t n,
+                                    uint32_t* out);
+
+} // namespace ns3
+
+#endif /* FOBA_SEGMENT_BOX_H */
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-thread-pool.h"
+
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("WorkStealingPool");
+
+NS_OBJECT_ENSURE_REGISTERED(WorkStealingPool);
+
+/// Pool whose loop the current thread is running an iteration of, null if none
+static thread_local const WorkStealingPool* g_loopPool = nullptr;
+
+TypeId
+WorkStealingPool::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::WorkStealingPool")
+            .SetParent<Object>()
+            .SetGroupName("Buildings")
+            .AddConstructor<WorkStealingPool>()
+            .AddAttribute("ThreadCount",
+                          "Number of threads running the loops, the calling thread included.",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&WorkStealingPool::SetThreadCount,
+                                               &WorkStealingPool::GetThreadCount),
+                          MakeUintegerChecker<uint32_t>(1));
+    return tid;
+}
+
+WorkStealingPool::WorkStealingPool()
+    : m_threadCount(1),
+      m_ranges(std::make_unique<Range[]>(1)),
+      m_body(nullptr),
+      m_generation(0),
+      m_running(0),
+      m_stop(false)
+{
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    StopWorkers();
+}
+
+void
+WorkStealingPool::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    StopWorkers();
+    Object::DoDispose();
+}
+
+void
+WorkStealingPool::SetThreadCount(uint32_t count)
+{
+    NS_LOG_FUNCTION(this << count);
+    NS_ASSERT_MSG(count > 0, "At least the calling thread runs the loops");
+    if (count == m_threadCount)
+    {
+        return;
+    }
+    StopWorkers();
+    m_threadCount = count;
+    m_ranges = std::make_unique<Range[]>(count);
+}
+
+uint32_t
+WorkStealingPool::GetThreadCount() const
+{
+    return m_threadCount;
+}
+
+void
+WorkStealingPool::ParallelFor(uint32_t n, const std::function<void(uint32_t, uint32_t)>& body)
+{
+    NS_LOG_FUNCTION(this << n);
+    // The loop would wait on m_callMutex for the loop running the body, which waits for the body
+    NS_ASSERT_MSG(g_loopPool != this,
+                  "ParallelFor called from the body of a loop of the same pool");
+
+    if ((m_threadCount == 1) || (n < 2))
+    {
+        g_loopPool = this;
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            body(i, 0);
+        }
+        g_loopPool = nullptr;
+        return;
+    }
+    std::lock_guard<std::mutex> call(m_callMutex);
+    if (m_workers.empty())
+    {
+        NS_LOG_INFO("Starting " << m_threadCount - 1 << " worker threads");
+        m_stop = false;
+        for (uint32_t worker = 1; worker < m_threadCount; ++worker)
+        {
+            m_workers.emplace_back(&WorkStealingPool::WorkerLoop, this, worker, m_generation);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (uint32_t worker = 0; worker < m_threadCount; ++worker)
+        {
+            m_ranges[worker].next.store(static_cast<uint64_t>(n) * worker / m_threadCount);
+            m_ranges[worker].end = static_cast<uint64_t>(n) * (worker + 1) / m_threadCount;
+        }
+        m_body = &body;
+        m_running = m_threadCount - 1;
+        ++m_generation;
+    }
+    m_start.notify_all();
+
+    RunRanges(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]() { return m_running == 0; });
+    m_body = nullptr;
+}
+
+void
+WorkStealingPool::StopWorkers()
+{
+    if (m_workers.empty())
+    {
+        return;
+    }
+    NS_LOG_FUNCTION(this);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for (auto& thread : m_workers)
+    {
+        thread.join();
+    }
+    m_workers.clear();
+}
+
+void
+WorkStealingPool::WorkerLoop(uint32_t worker, uint64_t generation)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_start.wait(lock, [this, generation]() { return m_stop || (m_generation != generation); });
+        if (m_stop)
+        {
+            return;
+        }
+        generation = m_generation;
+        lock.unlock();
+        RunRanges(worker);
+        lock.lock();
+        if (--m_running == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
+
+void
+WorkStealingPool::RunRanges(uint32_t worker)
+{
+    // Own range first, then the iterations left in the ranges of the other threads
+    g_loopPool = this;
+    for (uint32_t k = 0; k < m_threadCount; ++k)
+    {
+        Range& range = m_ranges[(worker + k) % m_threadCount];
+        for (uint32_t i = range.next.fetch_add(1); i < range.end; i = range.next.fetch_add(1))
+        {
+            (*m_body)(i, worker);
+        }
+    }
+    g_loopPool = nullptr;
+}
+
+} // namespace ns3
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_THREAD_POOL_H
+#define FOBA_THREAD_POOL_H
+
+#include "ns3/object.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Pool of threads running the iterations of a loop.
+ *
+ * The iterations are split in one contiguous range per thread, the calling thread being one of
+ * them. A thread that finished its range takes the remaining iterations of the other ranges, so
+ * the threads stay busy when the iterations do not have the same cost. The worker threads are
+ * started on the first parallel loop and wait for the next one in between.
+ */
+class WorkStealingPool : public Object
+{
+  public:
+    /**
+     * @brief Get the type ID.
+     * @return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    WorkStealingPool();
+    ~WorkStealingPool() override;
+
+    /**
+     * @brief Set the number of threads running the loops, the calling thread included
+     * @param count the number of threads, 1 to run the loops in the calling thread only
+     */
+    void SetThreadCount(uint32_t count);
+
+    /**
+     * @return the number of threads running the loops, the calling thread included
+     */
+    uint32_t GetThreadCount() const;
+
+    /**
+     * @brief Run the iterations of a loop, and wait for all of them to be done
+     *
+     * The loops started by several threads at the same time run one after the other, so
+     * concurrent callers do not add parallelism. The body must not start a loop of the same pool,
+     * which would wait forever for the loop running it.
+     *
+     * @param n number of iterations
+     * @param body called with the index of each iteration (0 to n - 1) and the index of the
+     * thread running it (0 to GetThreadCount() - 1, 0 is the calling thread)
+     */
+    void ParallelFor(uint32_t n, const std::function<void(uint32_t, uint32_t)>& body);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * @brief Iterations left to a thread
+     */
+    struct Range
+    {
+        std::atomic<uint32_t> next; ///< next iteration to run
+        uint32_t end;               ///< iteration after the last one
+    };
+
+    /**
+     * @brief Stop and join the worker threads
+     */
+    void StopWorkers();
+
+    /**
+     * @brief Loop of a worker thread, running its part of each loop
+     * @param worker index of the thread
+     * @param generation number of loops started before the thread
+     */
+    void WorkerLoop(uint32_t worker, uint64_t generation);
+
+    /**
+     * @brief Run the iterations of the range of a thread, then the ones left in the other ranges
+     * @param worker index of the thread
+     */
+    void RunRanges(uint32_t worker);
+
+    uint32_t m_threadCount;                                ///< Threads running the loops
+    std::vector<std::thread> m_workers;                    ///< Worker threads
+    std::unique_ptr<Range[]> m_ranges;                     ///< Iterations left to each thread
+    const std::function<void(uint32_t, uint32_t)>* m_body; ///< Body of the current loop
+    std::mutex m_callMutex;                                ///< Serializes concurrent loops
+    std::mutex m_mutex;                                    ///< Protects the state below
+    std::condition_variable m_start;                       ///< Signals a new loop or the stop
+    std::condition_variable m_done;                        ///< Signals the end of the workers
+    uint64_t m_generation;                                 ///< Number of loops started
+    uint32_t m_running;                                    ///< Workers running the current loop
+    bool m_stop;                                           ///< True to stop the workers
+};
+
+} // namespace ns3
+
+#endif /* FOBA_THREAD_POOL_H */
@@ -8,6 +8,8 @@
 
 #include "foba-toolbox.h"
 
+#include "foba-segment-box.h"
+
 #include "ns3/building.h"
 #include "ns3/log.h"
 #include "ns3/mobility-module.h"
@@ -15,7 +17,10 @@
 #include "ns3/pointer.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <initializer_list>
 #include <iostream>
 #include <utility>
 #include <vector>
@@ -25,6 +30,112 @@ namespace ns3
 
 NS_LOG_COMPONENT_DEFINE("NLOSassess");
 
+/**
+ * @brief Wall of a building that may produce a reflection between two zones
+ */
+enum ZoneWall : uint8_t
+{
+    WALL_NONE,  ///< no reflection
+    WALL_X_MIN, ///< wall at x = xMin
+    WALL_X_MAX, ///< wall at x = xMax
+    WALL_Y_MIN, ///< wall at y = yMin
+    WALL_Y_MAX  ///< wall at y = yMax
+};
+
+/**
+ * @brief What the zones of two nodes tell about a building
+ */
+struct ZonePair
+{
+    bool los;                                    ///< LOS whatever the positions in the zones
+    uint8_t nCorners;                            ///< number of diffraction corners
+    std::array<CitySnapshot::Corner, 2> corners; ///< diffraction corners
+    ZoneWall wall;                               ///< wall of the reflection
+};
+
+/// Zone pairs indexed by the zone of the first and of the second node
+using ZoneTable = std::array<std::array<ZonePair, NLOSassess::ZONE_Z + 1>, NLOSassess::ZONE_Z + 1>;
+
+/**
+ * @brief Build the table of the zone pairs from their names
+ * @return the table
+ */
+static constexpr ZoneTable
+MakeZoneTable()
+{
+    /*
+     *      A   |   B    |   C
+     *   -------+--------+-------
+     *      H   |building|   D
+     *   -------+--------+-------
+     *      G   |   F    |   E
+     */
+    auto index = [](char zone) {
+        return (zone == 'Z') ? NLOSassess::ZONE_Z : static_cast<NLOSassess::Zone>(zone - 'A');
+    };
+    ZoneTable table{};
+    auto pair = [&table, &index](const char* name) -> ZonePair& {
+        return table[index(name[0])][index(name[1])];
+    };
+    auto setCorners = [&pair](std::initializer_list<const char*> names,
+                              std::initializer_list<CitySnapshot::Corner> corners) {
+        for (const char* name : names)
+        {
+            pair(name).nCorners = 0;
+            for (CitySnapshot::Corner corner : corners)
+            {
+                pair(name).corners[pair(name).nCorners++] = corner;
+            }
+        }
+    };
+    auto setWall = [&pair](std::initializer_list<const char*> names, ZoneWall wall) {
+        for (const char* name : names)
+        {
+            pair(name).wall = wall;
+        }
+    };
+
+    for (auto& row : table)
+    {
+        for (auto& entry : row)
+        {
+            entry = {false, 0, {CitySnapshot::TOP_LEFT, CitySnapshot::TOP_LEFT}, WALL_NONE};
+        }
+    }
+    // All LOS cases that are automatic LOS --> no assesment needed
+    for (const char* name : {"AA", "BB", "CC", "DD", "EE", "FF", "GG", "HH", "AB", "BA", "AC",
+                             "CA", "AH", "HA", "BC", "CB", "CD", "DC", "CE", "EC", "DE", "ED",
+                             "EF", "FE", "EG", "GE", "FG", "GF", "GH", "HG", "AG", "GA"})
+    {
+        pair(name).los = true;
+    }
+
+    // Areas where the diffraction happens in top left corner
+    setCorners({"BG", "GB", "HB", "BH", "HC", "CH"}, {CitySnapshot::TOP_LEFT});
+    // Areas where the diffraction happens in top right corner
+    setCorners({"BE", "EB", "DB", "BD", "DA", "AD"}, {CitySnapshot::TOP_RIGHT});
+    // Areas where the diffraction happens in bottom left corner
+    setCorners({"HE", "EH", "FH", "HF", "FA", "AF"}, {CitySnapshot::BOTTOM_LEFT});
+    // Areas of the bottom right corner, the diffraction is computed on the top left corner
+    setCorners({"DG", "GD", "FD", "DF", "FC", "CF"}, {CitySnapshot::TOP_LEFT});
+    // Two corners scenarios
+    setCorners({"CG", "GC"}, {CitySnapshot::TOP_LEFT, CitySnapshot::BOTTOM_RIGHT});
+    setCorners({"AE", "EA"}, {CitySnapshot::BOTTOM_LEFT, CitySnapshot::TOP_RIGHT});
+
+    // Areas that see each wall
+    setWall({"GF", "FG", "FE", "EF", "EG", "GE", "FF"}, WALL_Y_MIN);
+    setWall({"AB", "BA", "BC", "CB", "AC", "CA", "BB"}, WALL_Y_MAX);
+    setWall({"AH", "HA", "HG", "GH", "GA", "AG", "HH"}, WALL_X_MIN);
+    setWall({"CD", "DC", "DE", "ED", "EC", "CE", "DD"}, WALL_X_MAX);
+    return table;
+}
+
+/// What the zones of two nodes tell about a building, computed at compile time
+static constexpr ZoneTable g_zonePairs = MakeZoneTable();
+
+static_assert(g_zonePairs[NLOSassess::ZONE_G][NLOSassess::ZONE_A].los);
+static_assert(g_zonePairs[NLOSassess::ZONE_C][NLOSassess::ZONE_G].nCorners == 2);
+
 TypeId
 NLOSassess::GetTypeId()
 {
@@ -42,151 +153,179 @@ NLOSassess::GetInstanceTypeId() const
 
 NLOSassess::NLOSassess()
 {
-    buffer = 0;
 }
 
 NLOSassess::~NLOSassess()
 {
 }
 
-char
-NLOSassess::zone(Ptr<MobilityModel> mob, Ptr<Building> b)
+NLOSassess::Zone
+NLOSassess::zone(const Vector& pos, const Box& b)
 {
     NS_LOG_FUNCTION(this);
-    double x = mob->GetPosition().x;
-    double y = mob->GetPosition().y;
+    double x = pos.x;
+    double y = pos.y;
 
     // since the comparaison is strict, mob on bound is consider outside
-    if (((x < b->GetBoundaries().xMax) && (x > b->GetBoundaries().xMin)) &&
-        ((y < b->GetBoundaries().yMax) && (y > b->GetBoundaries().yMin)))
+    if (((x < b.xMax) && (x > b.xMin)) && ((y < b.yMax) && (y > b.yMin)))
     {
-        // std::cout << "here" << std::endl;
-        // std::cout << "x : " << x << ", y : " << y << std::endl;
-        // std::cout << "building bounds (xmin,xmax,ymin,ymax) : " << b->GetBoundaries().xMin <<
-        // b->GetBoundaries().xMax << b->GetBoundaries().yMin << b->GetBoundaries().yMax <<
-        // std::endl;
-        buffer += 1;
-        return 'Z'; // Node in building
+        return ZONE_Z; // Node in building
     }
 
-    if (x <= b->GetBoundaries().xMin)
+    if (x <= b.xMin)
     {
-        if (y >= b->GetBoundaries().yMax)
+        if (y >= b.yMax)
         {
-            buffer = 0;
-            return 'A';
+            return ZONE_A;
         }
-        if (y <= b->GetBoundaries().yMin)
+        if (y <= b.yMin)
         {
-            buffer = 0;
-            return 'G';
+            return ZONE_G;
         }
-        buffer = 0;
-        return 'H';
+        return ZONE_H;
     }
-    if (x >= b->GetBoundaries().xMax)
+    if (x >= b.xMax)
     {
-        if (y >= b->GetBoundaries().yMax)
+        if (y >= b.yMax)
         {
-            buffer = 0;
-            return 'C';
+            return ZONE_C;
         }
-        if (y <= b->GetBoundaries().yMin)
+        if (y <= b.yMin)
         {
-            buffer = 0;
-            return 'E';
+            return ZONE_E;
         }
-        buffer = 0;
-        return 'D';
+        return ZONE_D;
     }
     else
     {
-        if (y >= b->GetBoundaries().yMax)
+        if (y >= b.yMax)
         {
-            buffer = 0;
-            return 'B';
+            return ZONE_B;
         }
-        if (y <= b->GetBoundaries().yMin)
+        if (y <= b.yMin)
         {
-            buffer = 0;
-            return 'F';
+            return ZONE_F;
         }
     }
-    // std::cout << "x : " << x << ", y : " << y << std::endl;
-    // std::cout << "building bounds (xmin,xmax,ymin,ymax) : " << b->GetBoundaries().xMin <<
-    // b->GetBoundaries().xMax << b->GetBoundaries().yMin << b->GetBoundaries().yMax << std::endl;
-    buffer += 1;
-    return 'Z'; // Undefined zone
+    return ZONE_Z; // Undefined zone
 }
 
-/*
-return True for NLOS
-*/
-bool
-NLOSassess::NLOSplan(Ptr<MobilityModel> eva, Ptr<MobilityModel> ave, Ptr<Building> b)
+NLOSassess::Zone
+NLOSassess::zone(const Endpoint& node, const Box& b, uint32_t slot)
 {
-    NS_LOG_FUNCTION(this);
+    return node.zones ? node.zones[slot] : zone(node.position, b);
+}
 
-    double eva_x = eva->GetPosition().x;
-    double eva_y = eva->GetPosition().y;
-    double eva_z = eva->GetPosition().z;
-    double ave_x = ave->GetPosition().x;
-    double ave_y = ave->GetPosition().y;
-    double ave_z = ave->GetPosition().z;
+void
+NLOSassess::GetZones(const Vector& pos, const CitySnapshot& city, std::vector<Zone>& zones)
+{
+    NS_LOG_FUNCTION(this << pos);
 
-    double BxMax = b->GetBoundaries().xMax;
-    double ByMax = b->GetBoundaries().yMax;
-    double BzMax = b->GetBoundaries().zMax;
-    double BxMin = b->GetBoundaries().xMin;
-    double ByMin = b->GetBoundaries().yMin;
+    zones.resize(city.GetNBuildings());
+    for (uint32_t slot = 0; slot < zones.size(); ++slot)
+    {
+        zones[slot] = zone(pos, city.GetBounds(slot));
+    }
+}
 
-    double z1_diff = eva_z - BzMax;
-    double z2_diff = ave_z - BzMax;
+std::vector<Ptr<Building>>
+NLOSassess::GetBuildingsBetween(Ptr<MobilityModel> eva,
+                                Ptr<MobilityModel> ave,
+                                std::vector<Ptr<Building>> buildings)
+{
+    NS_LOG_FUNCTION(this);
 
-    if ((z1_diff > 0) && (z2_diff > 0))
-    { // both node are strictly over roof top height
-        return false;
-    }
-    if (z1_diff * z2_diff <= 0)
-    { // one of the node is below or at roof height
-
-        // Check if the line crosses the box on each plan, if so -> NLOS
-        // Parameters for the X-Z plan
-        double alpha_x = (eva_x - ave_x) / (eva_z - ave_z);
-        double beta_x = eva_z - alpha_x * eva_x;
-        // Parameters for the Y-Z plan
-        double alpha_y = (eva_y - ave_y) / (eva_z - ave_z);
-        double beta_y = eva_z - alpha_y * eva_y;
-        // Parameters for the X-Y plan
-        double alpha_z = (eva_y - ave_y) / (eva_x - ave_x);
-        double beta_z = eva_y - alpha_z * eva_x;
-
-        if (((alpha_x * BxMin - beta_x < BzMax) || (alpha_x * BxMax - beta_x < BzMax)) &&
-            ((alpha_y * ByMin - beta_y < BzMax) || (alpha_y * ByMax - beta_y < BzMax)))
+    Vector evaPos = eva->GetPosition();
+    Vector avePos = ave->GetPosition();
+    std::vector<Ptr<Building>> NLOSbuildings;
+    for (const auto& building : buildings)
+    {
+        if (IsBuildingBetween(evaPos, avePos, building->GetBoundaries()))
         {
-            if (((eva_x == ave_x) && ((eva_x == BxMax) || (eva_x == BxMin))) ||
-                ((eva_y == ave_y) && ((eva_y == ByMax) || (eva_y == ByMin))))
-            {
-                return true;
-            }
-
-            if (((alpha_z * BxMin - beta_z <= ByMax) && (alpha_z * BxMin - beta_z >= ByMin)) ||
-                ((alpha_z * BxMax - beta_z <= ByMax) && (alpha_z * BxMax - beta_z >= ByMin)))
-            {
-                return true;
-            }
+            NLOSbuildings.push_back(building);
         }
     }
-    return false; // LOS by default
+    return NLOSbuildings;
 }
 
-std::vector<Ptr<Building>>
+std::vector<uint32_t>
 NLOSassess::GetBuildingsBetween(Ptr<MobilityModel> eva,
                                 Ptr<MobilityModel> ave,
-                                std::vector<Ptr<Building>> buildings)
+                                const CitySnapshot& city,
+                                const std::vector<uint32_t>& slots)
 {
     NS_LOG_FUNCTION(this);
 
+    return GetBuildingsBetween(eva->GetPosition(), ave->GetPosition(), city, slots);
+}
+
+std::vector<uint32_t>
+NLOSassess::GetBuildingsBetween(const Vector& eva,
+                                const Vector& ave,
+                                const CitySnapshot& city,
+                                const std::vector<uint32_t>& slots)
+{
+    NS_LOG_FUNCTION(this);
+
+    return GetBuildingsBetween(eva, Endpoint{ave}, city, slots);
+}
+
+std::vector<uint32_t>
+NLOSassess::GetBuildingsBetween(const Vector& eva,
+                                const Endpoint& ave,
+                                const CitySnapshot& city,
+                                const std::vector<uint32_t>& slots)
+{
+    NS_LOG_FUNCTION(this);
+
+    // The zones discard most buildings (see IsLosFromZones), the others are tested together
+    std::vector<uint32_t> NLOSbuildings;
+    NLOSbuildings.reserve(slots.size());
+    for (uint32_t slot : slots)
+    {
+        if (!IsLosFromZones(eva, ave, city, slot))
+        {
+            NLOSbuildings.push_back(slot);
+        }
+    }
+    city.FilterIntersected(eva, ave.position, NLOSbuildings);
+    return NLOSbuildings;
+}
+
+std::vector<uint32_t>
+NLOSassess::GetBuildingsBetween(const Vector& eva, const Endpoint& ave, const CitySnapshot& city)
+{
+    NS_LOG_FUNCTION(this);
+
+    std::vector<uint32_t> NLOSbuildings;
+    for (uint32_t slot = 0; slot < city.GetNBuildings(); ++slot)
+    {
+        if (!IsLosFromZones(eva, ave, city, slot))
+        {
+            NLOSbuildings.push_back(slot);
+        }
+    }
+    city.FilterIntersected(eva, ave.position, NLOSbuildings);
+    return NLOSbuildings;
+}
+
+bool
+NLOSassess::IsLosFromZones(const Vector& eva,
+                           const Endpoint& ave,
+                           const CitySnapshot& city,
+                           uint32_t slot)
+{
+    Box bounds = city.GetBounds(slot);
+    Zone zone_a = zone(eva, bounds);
+    Zone zone_b = zone(ave, bounds, slot);
+    NS_ASSERT_MSG((zone_a != ZONE_Z) || (zone_b != ZONE_Z),
+                  "Undefined zone, check if node is note in the walls");
+    return g_zonePairs[zone_a][zone_b].los;
+}
+
+bool
+NLOSassess::IsLosFromZones(const Vector& eva, const Vector& ave, const Box& bounds)
+{
     /*
      * Buildings in NS3 are rectangles that are orthogonally aligned with the axis of the
      * environment, taking advantage of this model, we label the area surrounding a building and
@@ -195,72 +334,35 @@ NLOSassess::GetBuildingsBetween(Ptr<MobilityModel> eva,
      * the building. However, if the nodes are in zone A and F, we need to evaluate if the link
      * crosses the building, which implies calculations.
      *
-     * To assess if we are in a NLOS configuration we take the following steps:
-     * 1. Determine the zone
-     * 2. Making a quick decision based on default cases
-     * 3. If uncertainty persists, compute the linear function between the nodes and check if it
-     * crosses the building box
-     *
      *      A   |   B    |   C
      *   -------+--------+-------
      *      H   |building|   D
      *   -------+--------+-------
      *      G   |   F    |   E
      */
-    // All LOS cases that are automatic LOS --> no assesment needed
-    std::vector<std::string> default_LOS = {"AA", "BB", "CC", "DD", "EE", "FF", "GG", "HH",
-                                            "AB", "BA", "AC", "CA", "AH", "HA", "BC", "CB",
-                                            "CD", "DC", "CE", "EC", "DE", "ED", "EF", "FE",
-                                            "EG", "GE", "FG", "GF", "GH", "HG", "AG", "GA"};
-    // All LOS cases that are automatic NLOS
-    std::vector<std::string> default_NLOS = {"HD", "DH", "BF", "FB"};
-    // Zone from which we evaluate the NLOS
-    std::vector<char> evaluator = {'A', 'B', 'F', 'G', 'H'};
-
-    char zone_a;
-    char zone_b;
-    std::string zone_comb;
-    int limit = buildings.size();
-    std::vector<Ptr<Building>> NLOSbuildings;
+    Zone zone_a = zone(eva, bounds);
+    Zone zone_b = zone(ave, bounds);
+    NS_ASSERT_MSG((zone_a != ZONE_Z) || (zone_b != ZONE_Z),
+                  "Undefined zone, check if node is note in the walls");
+    return g_zonePairs[zone_a][zone_b].los;
+}
 
-    for (int index = 0; index < limit; index++)
+bool
+NLOSassess::IsBuildingBetween(const Vector& eva, const Vector& ave, const Box& bounds)
+{
+    /*
+     * To assess if we are in a NLOS configuration we take the following steps:
+     * 1. Determine the zone
+     * 2. Making a quick decision based on default LOS cases
+     * 3. If uncertainty persists, check if the segment between the nodes crosses the building
+     * box
+     */
+    if (IsLosFromZones(eva, ave, bounds))
     {
-        Ptr<Building> building = buildings[index];
-        double building_zMax = building->GetBoundaries().zMax;
-        double a_z = eva->GetPosition().z;
-        double b_z = ave->GetPosition().z;
-        zone_a = zone(eva, building);
-        zone_b = zone(ave, building);
-        zone_comb = std::string(1, zone_a) + zone_b;
-        NS_ASSERT_MSG(buffer < 2, "Undefined zone, check if node is note in the walls");
-
-        if (std::find(default_LOS.begin(), default_LOS.end(), zone_comb) != default_LOS.end())
-        {
-            // We have LOS for this building
-            continue;
-        }
-        if (std::find(default_NLOS.begin(), default_NLOS.end(), zone_comb) != default_NLOS.end())
-        {
-            // We have NLOS for this building
-            NLOSbuildings.push_back(building);
-            continue;
-        }
-        if ((a_z >= building_zMax) && (b_z >= building_zMax))
-        {
-            // We have LOS for this building
-            continue;
-        }
-        if (std::find(evaluator.begin(), evaluator.end(), zone_a) != evaluator.end())
-        {
-            if (NLOSplan(eva, ave, building))
-            {
-                NLOSbuildings.push_back(building);
-            }
-            continue;
-        }
-        NS_LOG_DEBUG("Could not asses NLOS");
+        // We have LOS for this building
+        return false;
     }
-    return NLOSbuildings;
+    return SegmentIntersectsBox(eva, ave, bounds);
 }
 
 std::vector<Vector>
@@ -268,74 +370,60 @@ NLOSassess::GetCorner(Ptr<Building> CurrBuild, Ptr<MobilityModel> rx, Ptr<Mobili
 {
     NS_LOG_FUNCTION(this);
 
-    // Area where the diffraction happens in top left corner
-    std::vector<std::string> Top_left = {"BG", "GB", "HB", "BH", "HC", "CH"};
-    // Area where the diffraction happens in top right corner
-    std::vector<std::string> Top_right = {"BE", "EB", "DB", "BD", "DA", "AD"};
-    // Area where the diffraction happens in bottom left corner
-    std::vector<std::string> Bot_left = {"HE", "EH", "FH", "HF", "FA", "AF"};
-    // Area where the diffraction happens in bottom left corner
-    std::vector<std::string> Bot_right = {"DG", "GD", "FD", "DF", "FC", "CF"};
+    Box bounds = CurrBuild->GetBoundaries();
+    std::array<Vector, 4> corners;
+    corners[CitySnapshot::TOP_LEFT] = Vector(bounds.xMin, bounds.yMax, 0);
+    corners[CitySnapshot::TOP_RIGHT] = Vector(bounds.xMax, bounds.yMax, 0);
+    corners[CitySnapshot::BOTTOM_LEFT] = Vector(bounds.xMin, bounds.yMin, 0);
+    corners[CitySnapshot::BOTTOM_RIGHT] = Vector(bounds.xMax, bounds.yMin, 0);
+    return GetCorner(corners.data(),
+                     zone(rx->GetPosition(), bounds),
+                     zone(tx->GetPosition(), bounds));
+}
 
-    Vector Corner_pos;
-    std::vector<Vector> Corners;
-    char zone_a = zone(rx, CurrBuild);
-    char zone_b = zone(tx, CurrBuild);
-    std::string zone_comb = std::string(1, zone_a) + zone_b;
+std::vector<Vector>
+NLOSassess::GetCorner(const CitySnapshot& city,
+                      uint32_t slot,
+                      Ptr<MobilityModel> rx,
+                      Ptr<MobilityModel> tx)
+{
+    NS_LOG_FUNCTION(this);
 
-    if (std::find(Top_left.begin(), Top_left.end(), zone_comb) != Top_left.end())
-    {
-        Corner_pos.x = CurrBuild->GetBoundaries().xMin;
-        Corner_pos.y = CurrBuild->GetBoundaries().yMax;
-        Corners.push_back(Corner_pos);
-        return Corners;
-    }
-    if (std::find(Top_right.begin(), Top_right.end(), zone_comb) != Top_right.end())
-    {
-        Corner_pos.x = CurrBuild->GetBoundaries().xMax;
-        Corner_pos.y = CurrBuild->GetBoundaries().yMax;
-        Corners.push_back(Corner_pos);
-        return Corners;
-    }
-    if (std::find(Bot_left.begin(), Bot_left.end(), zone_comb) != Bot_left.end())
-    {
-        Corner_pos.x = CurrBuild->GetBoundaries().xMin;
-        Corner_pos.y = CurrBuild->GetBoundaries().yMin;
-        Corners.push_back(Corner_pos);
-        return Corners;
-    }
-    if (std::find(Bot_right.begin(), Bot_right.end(), zone_comb) != Bot_right.end())
-    {
-        Corner_pos.x = CurrBuild->GetBoundaries().xMin;
-        Corner_pos.y = CurrBuild->GetBoundaries().yMax;
-        Corners.push_back(Corner_pos);
-        return Corners;
-    }
-    // Two corners scenario
-    if ((zone_comb == "CG") || (zone_comb == "GC"))
-    {
-        Vector Corner_pos_2;
-        Corner_pos.x = CurrBuild->GetBoundaries().xMin;
-        Corner_pos.y = CurrBuild->GetBoundaries().yMax;
-        Corner_pos_2.x = CurrBuild->GetBoundaries().xMax;
-        Corner_pos_2.y = CurrBuild->GetBoundaries().yMin;
-        Corners.push_back(Corner_pos);
-        Corners.push_back(Corner_pos_2);
-        return Corners;
-    }
-    // Two corners scenario
-    if ((zone_comb == "AE") || (zone_comb == "EA"))
+    return GetCorner(city, slot, Endpoint{rx->GetPosition()}, Endpoint{tx->GetPosition()});
+}
+
+std::vector<Vector>
+NLOSassess::GetCorner(const CitySnapshot& city, uint32_t slot, const Vector& rx, const Vector& tx)
+{
+    NS_LOG_FUNCTION(this);
+
+    return GetCorner(city, slot, Endpoint{rx}, Endpoint{tx});
+}
+
+std::vector<Vector>
+NLOSassess::GetCorner(const CitySnapshot& city,
+                      uint32_t slot,
+                      const Endpoint& rx,
+                      const Endpoint& tx)
+{
+    NS_LOG_FUNCTION(this);
+
+    Box bounds = city.GetBounds(slot);
+    return GetCorner(&city.GetCorner(slot, CitySnapshot::TOP_LEFT),
+                     zone(rx, bounds, slot),
+                     zone(tx, bounds, slot));
+}
+
+std::vector<Vector>
+NLOSassess::GetCorner(const Vector* corners, Zone rxZone, Zone txZone)
+{
+    const ZonePair& zones = g_zonePairs[rxZone][txZone];
+    std::vector<Vector> Corners;
+    Corners.reserve(zones.nCorners);
+    for (uint8_t i = 0; i < zones.nCorners; ++i)
     {
-        Vector Corner_pos_2;
-        Corner_pos.x = CurrBuild->GetBoundaries().xMin;
-        Corner_pos.y = CurrBuild->GetBoundaries().yMin;
-        Corner_pos_2.x = CurrBuild->GetBoundaries().xMax;
-        Corner_pos_2.y = CurrBuild->GetBoundaries().yMax;
-        Corners.push_back(Corner_pos);
-        Corners.push_back(Corner_pos_2);
-        return Corners;
+        Corners.push_back(corners[zones.corners[i]]);
     }
-
     return Corners;
 }
 
@@ -344,64 +432,79 @@ NLOSassess::Getreflectionpoint(Ptr<Building> Building, Ptr<MobilityModel> rx, Pt
 {
     NS_LOG_FUNCTION(this);
 
-    // y_min areas
-    std::vector<std::string> y_min = {"GF", "FG", "FE", "EF", "EG", "GE", "FF"};
-    // y_max areas
-    std::vector<std::string> y_max = {"AB", "BA", "BC", "CB", "AC", "CA", "BB"};
-    // y_min areas
-    std::vector<std::string> x_min = {"AH", "HA", "HG", "GH", "GA", "AG", "HH"};
-    // y_max areas
-    std::vector<std::string> x_max = {"CD", "DC", "DE", "ED", "EC", "CE", "DD"};
+    return Getreflectionpoint(Building->GetBoundaries(), rx->GetPosition(), tx->GetPosition());
+}
 
-    char zone_a = zone(rx, Building);
-    char zone_b = zone(tx, Building);
-    std::string zone_comb = std::string(1, zone_a) + zone_b;
+std::optional<Vector>
+NLOSassess::Getreflectionpoint(const Box& bounds, Ptr<MobilityModel> rx, Ptr<MobilityModel> tx)
+{
+    NS_LOG_FUNCTION(this);
+
+    return Getreflectionpoint(bounds, rx->GetPosition(), tx->GetPosition());
+}
 
-    if (std::find(y_min.begin(), y_min.end(), zone_comb) != y_min.end())
+std::optional<Vector>
+NLOSassess::Getreflectionpoint(const Box& bounds, const Vector& rx, const Vector& tx)
+{
+    NS_LOG_FUNCTION(this);
+
+    return Getreflectionpoint(bounds, rx, tx, zone(rx, bounds), zone(tx, bounds));
+}
+
+std::optional<Vector>
+NLOSassess::Getreflectionpoint(const CitySnapshot& city,
+                               uint32_t slot,
+                               const Endpoint& rx,
+                               const Endpoint& tx)
+{
+    NS_LOG_FUNCTION(this);
+
+    Box bounds = city.GetBounds(slot);
+    return Getreflectionpoint(bounds,
+                              rx.position,
+                              tx.position,
+                              zone(rx, bounds, slot),
+                              zone(tx, bounds, slot));
+}
+
+std::optional<Vector>
+NLOSassess::Getreflectionpoint(const Box& bounds,
+                               const Vector& rx,
+                               const Vector& tx,
+                               Zone rxZone,
+                               Zone txZone)
+{
+    ZoneWall wall = g_zonePairs[rxZone][txZone].wall;
+    if (wall == WALL_NONE)
     {
-        double y_refl = Building->GetBoundaries().yMin;
-        double rx_x = rx->GetPosition().x;
-        double rx_y = rx->GetPosition().y;
-        double tx_x = tx->GetPosition().x;
-        double tx_y = tx->GetPosition().y;
-        double x_refl =
-            (rx_x * (y_refl - tx_y) - tx_x * (rx_y - y_refl)) / ((y_refl - tx_y) - (rx_y - y_refl));
-        return Vector(x_refl, y_refl, 1);
+        return std::nullopt;
     }
-    if (std::find(y_max.begin(), y_max.end(), zone_comb) != y_max.end())
+
+    double rx_x = rx.x;
+    double rx_y = rx.y;
+    double tx_x = tx.x;
+    double tx_y = tx.y;
+    if ((wall == WALL_Y_MIN) || (wall == WALL_Y_MAX))
     {
-        double y_refl = Building->GetBoundaries().yMax;
-        double rx_x = rx->GetPosition().x;
-        double rx_y = rx->GetPosition().y;
-        double tx_x = tx->GetPosition().x;
-        double tx_y = tx->GetPosition().y;
+        double y_refl = (wall == WALL_Y_MIN) ? bounds.yMin : bounds.yMax;
         double x_refl =
             (rx_x * (y_refl - tx_y) - tx_x * (rx_y - y_refl)) / ((y_refl - tx_y) - (rx_y - y_refl));
+        if ((x_refl < bounds.xMin) || (x_refl > bounds.xMax))
+        {
+            // The specular point is not on the wall
+            return std::nullopt;
+        }
         return Vector(x_refl, y_refl, 1);
     }
-    if (std::find(x_min.begin(), x_min.end(), zone_comb) != x_min.end())
-    {
-        double x_refl = Building->GetBoundaries().xMin;
-        double rx_x = rx->GetPosition().x;
-        double rx_y = rx->GetPosition().y;
-        double tx_x = tx->GetPosition().x;
-        double tx_y = tx->GetPosition().y;
-        double y_refl =
-            (rx_y * (x_refl - tx_x) + tx_y * (x_refl - rx_x)) / ((x_refl - tx_y) + (x_refl - rx_x));
-        return Vector(x_refl, y_refl, 1);
-    }
-    if (std::find(x_max.begin(), x_max.end(), zone_comb) != x_max.end())
+    double x_refl = (wall == WALL_X_MIN) ? bounds.xMin : bounds.xMax;
+    double y_refl =
+        (rx_y * (x_refl - tx_x) + tx_y * (x_refl - rx_x)) / ((x_refl - tx_x) + (x_refl - rx_x));
+    if ((y_refl < bounds.yMin) || (y_refl > bounds.yMax))
     {
-        double x_refl = Building->GetBoundaries().xMax;
-        double rx_x = rx->GetPosition().x;
-        double rx_y = rx->GetPosition().y;
-        double tx_x = tx->GetPosition().x;
-        double tx_y = tx->GetPosition().y;
-        double y_refl =
-            (rx_y * (x_refl - tx_x) + tx_y * (x_refl - rx_x)) / ((x_refl - tx_y) + (x_refl - rx_x));
-        return Vector(x_refl, y_refl, 1);
+        // The specular point is not on the wall
+        return std::nullopt;
     }
-    return std::nullopt;
+    return Vector(x_refl, y_refl, 1);
 }
 
 } // namespace ns3
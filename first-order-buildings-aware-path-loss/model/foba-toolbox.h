@@ -9,6 +9,8 @@
 #ifndef NLOSASSESS_H
 #define NLOSASSESS_H
 
+#include "foba-city-snapshot.h"
+
 #include "ns3/building.h"
 #include "ns3/mobility-module.h"
 #include "ns3/object.h"
@@ -16,7 +18,10 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <optional>
 #include <utility>
 #include <vector>
@@ -39,7 +44,8 @@ class Building;
  * need the computation of the linear function and to check if this line intersect the building. In
  * short, this method is able to affirm that nodes are in LOS using only comparators (<,>,>=,<=),
  * but if they are in NLOS, their is an abiguity that is lifted by the computation of the line
- * between the nodes and it's intersection with the building.
+ * between the nodes and it's intersection with the building. This last step is the slab test of
+ * SegmentIntersectsBox, which is also used by the model to find the buildings between the nodes.
  */
 class NLOSassess : public Object
 {
@@ -51,6 +57,37 @@ class NLOSassess : public Object
     static TypeId GetTypeId();
     TypeId GetInstanceTypeId() const override;
 
+    /**
+     * @brief Zones around a building, see zone()
+     */
+    enum Zone : uint8_t
+    {
+        ZONE_A, ///< top left
+        ZONE_B, ///< top
+        ZONE_C, ///< top right
+        ZONE_D, ///< right
+        ZONE_E, ///< bottom right
+        ZONE_F, ///< bottom
+        ZONE_G, ///< bottom left
+        ZONE_H, ///< left
+        ZONE_Z  ///< in the building, or undefined
+    };
+
+    /// Visibility from a node of the building corners, indexed by their (x, y) position
+    using CornerVisibility = std::map<std::pair<double, double>, bool>;
+
+    /**
+     * @brief A node position with, when they are known, its zones relatively to the buildings of
+     * a snapshot (see GetZones)
+     */
+    struct Endpoint
+    {
+        Vector position;                    ///< position of the node
+        const Zone* zones{nullptr};         ///< zone for each slot of the snapshot, or nullptr
+        CornerVisibility* corners{nullptr}; ///< corners already checked from the node, or nullptr
+        std::mutex* cornersMutex{nullptr};  ///< protects corners if shared by concurrent calls
+    };
+
     NLOSassess();
     ~NLOSassess() override;
 
@@ -66,6 +103,62 @@ class NLOSassess : public Object
                                                    Ptr<MobilityModel> ave,
                                                    std::vector<Ptr<Building>> buildings);
 
+    /**
+     * @brief Assesses the number of buildings of a snapshot that cause NLOS.
+     *
+     * @param eva first point of the line to evaluate.
+     * @param ave second point of the line to evaluate.
+     * @param city the snapshot holding the buildings.
+     * @param slots contains the slots of the buildings to evaluate.
+     * @return the slots of the buildings that intersect the line between the two points.
+     */
+    std::vector<uint32_t> GetBuildingsBetween(Ptr<MobilityModel> eva,
+                                              Ptr<MobilityModel> ave,
+                                              const CitySnapshot& city,
+                                              const std::vector<uint32_t>& slots);
+
+    /**
+     * @brief Assesses the number of buildings of a snapshot that cause NLOS between two positions.
+     *
+     * @param eva first point of the line to evaluate.
+     * @param ave second point of the line to evaluate.
+     * @param city the snapshot holding the buildings.
+     * @param slots contains the slots of the buildings to evaluate.
+     * @return the slots of the buildings that intersect the line between the two points.
+     */
+    std::vector<uint32_t> GetBuildingsBetween(const Vector& eva,
+                                              const Vector& ave,
+                                              const CitySnapshot& city,
+                                              const std::vector<uint32_t>& slots);
+
+    /**
+     * @brief Assesses the number of buildings of a snapshot that cause NLOS between a point and a
+     * node.
+     *
+     * @param eva first point of the line to evaluate.
+     * @param ave the node at the second point of the line to evaluate.
+     * @param city the snapshot holding the buildings.
+     * @param slots contains the slots of the buildings to evaluate.
+     * @return the slots of the buildings that intersect the line between the two points.
+     */
+    std::vector<uint32_t> GetBuildingsBetween(const Vector& eva,
+                                              const Endpoint& ave,
+                                              const CitySnapshot& city,
+                                              const std::vector<uint32_t>& slots);
+
+    /**
+     * @brief Assesses the number of buildings of a snapshot that cause NLOS between a point and a
+     * node, among all the buildings of the snapshot.
+     *
+     * @param eva first point of the line to evaluate.
+     * @param ave the node at the second point of the line to evaluate.
+     * @param city the snapshot holding the buildings.
+     * @return the slots of the buildings that intersect the line between the two points.
+     */
+    std::vector<uint32_t> GetBuildingsBetween(const Vector& eva,
+                                              const Endpoint& ave,
+                                              const CitySnapshot& city);
+
     /**
      * @brief Gives the corners that may produce diffraction between Rx and Tx
      *
@@ -79,17 +172,113 @@ class NLOSassess : public Object
                                   Ptr<MobilityModel> tx);
 
     /**
-     * @brief Gives the corners that may produce reflection between Rx and Tx
+     * @brief Gives the corners of a building of a snapshot that may produce diffraction between Rx
+     * and Tx
+     *
+     * @param city the snapshot holding the building
+     * @param slot slot of the building to evaluate
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @return the corners of buildings that may produce a diffraction
+     */
+    std::vector<Vector> GetCorner(const CitySnapshot& city,
+                                  uint32_t slot,
+                                  Ptr<MobilityModel> rx,
+                                  Ptr<MobilityModel> tx);
+
+    /**
+     * @brief Gives the corners of a building of a snapshot that may produce diffraction between
+     * two positions
+     *
+     * @param city the snapshot holding the building
+     * @param slot slot of the building to evaluate
+     * @param rx the position of the destination
+     * @param tx the position of the source
+     * @return the corners of buildings that may produce a diffraction
+     */
+    std::vector<Vector> GetCorner(const CitySnapshot& city,
+                                  uint32_t slot,
+                                  const Vector& rx,
+                                  const Vector& tx);
+
+    /**
+     * @brief Gives the corners of a building of a snapshot that may produce diffraction between
+     * two nodes
+     *
+     * @param city the snapshot holding the building
+     * @param slot slot of the building to evaluate
+     * @param rx the destination
+     * @param tx the source
+     * @return the corners of buildings that may produce a diffraction
+     */
+    std::vector<Vector> GetCorner(const CitySnapshot& city,
+                                  uint32_t slot,
+                                  const Endpoint& rx,
+                                  const Endpoint& tx);
+
+    /**
+     * @brief Gives the point of the building walls that may produce reflection between Rx and Tx
+     *
+     * The wall is selected from the zones of the nodes, the specular point is then computed on
+     * this wall. No point is returned if the specular point falls outside of the wall.
      *
      * @param Building Current Building to evaluate
      * @param rx the mobility model of the destination
      * @param tx the mobility model of the source
-     * @return the coordinates on the surface that may produce a diffraction
+     * @return the coordinates on the surface that may produce a reflection
      */
     std::optional<Vector> Getreflectionpoint(Ptr<Building> Building,
                                              Ptr<MobilityModel> rx,
                                              Ptr<MobilityModel> tx);
 
+    /**
+     * @brief Gives the point of the walls of a building, given by its bounds, that may produce
+     * reflection between Rx and Tx
+     *
+     * @param bounds bounds of the building to evaluate
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @return the coordinates on the surface that may produce a reflection
+     */
+    std::optional<Vector> Getreflectionpoint(const Box& bounds,
+                                             Ptr<MobilityModel> rx,
+                                             Ptr<MobilityModel> tx);
+
+    /**
+     * @brief Gives the point of the walls of a building, given by its bounds, that may produce
+     * reflection between two positions
+     *
+     * @param bounds bounds of the building to evaluate
+     * @param rx the position of the destination
+     * @param tx the position of the source
+     * @return the coordinates on the surface that may produce a reflection
+     */
+    std::optional<Vector> Getreflectionpoint(const Box& bounds, const Vector& rx, const Vector& tx);
+
+    /**
+     * @brief Gives the point of the walls of a building of a snapshot that may produce reflection
+     * between two nodes
+     *
+     * @param city the snapshot holding the building
+     * @param slot slot of the building to evaluate
+     * @param rx the destination
+     * @param tx the source
+     * @return the coordinates on the surface that may produce a reflection
+     */
+    std::optional<Vector> Getreflectionpoint(const CitySnapshot& city,
+                                             uint32_t slot,
+                                             const Endpoint& rx,
+                                             const Endpoint& tx);
+
+    /**
+     * @brief Gives the zones of a point relatively to all the buildings of a snapshot
+     *
+     * @param pos the point to locate
+     * @param city the snapshot holding the buildings
+     * @param zones set to the zone of the point for each slot of the snapshot
+     */
+    void GetZones(const Vector& pos, const CitySnapshot& city, std::vector<Zone>& zones);
+
   private:
     /** @brief The point is allocated to one of the zone detailed in the figure bellow.
      *
@@ -99,27 +288,88 @@ class NLOSassess : public Object
      *     -------+--------+-------
      *        G   |   F    |   E
      *
-     * @param mob point to locate relatively to the building.
-     * @param b building that will be used to categorize the point.
+     * @param pos point to locate relatively to the building.
+     * @param b bounds of the building that will be used to categorize the point.
      * @return the zone in which the point belong relatively to the building.
      */
-    char zone(Ptr<MobilityModel> mob, Ptr<Building> b);
+    Zone zone(const Vector& pos, const Box& b);
+
+    /**
+     * @brief Zone of a node relatively to a building, from its zones if they are known
+     *
+     * @param node the node to locate
+     * @param b bounds of the building
+     * @param slot slot of the building in the snapshot of the zones of the node
+     * @return the zone in which the node belong relatively to the building.
+     */
+    Zone zone(const Endpoint& node, const Box& b, uint32_t slot);
+
+    /**
+     * @brief Check if the zones of a point and a node are enough to tell that a building of a
+     * snapshot does not block the line between them.
+     *
+     * @param eva the point
+     * @param ave the node
+     * @param city the snapshot holding the building
+     * @param slot slot of the building in the snapshot
+     * @return true if the building cannot block the line
+     */
+    bool IsLosFromZones(const Vector& eva,
+                        const Endpoint& ave,
+                        const CitySnapshot& city,
+                        uint32_t slot);
+
+    /**
+     * @brief Check if the zones of two points relatively to a building are enough to tell that
+     * the building does not block the line between them.
+     *
+     * A point on a wall is outside of the building, so a line touching the building from its
+     * outside (for instance from one of its corners) is in LOS.
+     *
+     * @param eva first point of the line to evaluate.
+     * @param ave second point of the line to evaluate.
+     * @param bounds bounds of the building to evaluate.
+     * @return true if there is LOS between eva and ave, false if the line has to be evaluated
+     */
+    bool IsLosFromZones(const Vector& eva, const Vector& ave, const Box& bounds);
 
     /**
-     * @brief Assesses if the building causes NLOS.
+     * @brief Assesses if a building is between two points, from the zones of the points and, if
+     * needed, SegmentIntersectsBox.
      *
      * @param eva first point of the line to evaluate.
      * @param ave second point of the line to evaluate.
-     * @param b building to evaluate.
-     * @return true if the building causes a NLOS, false if there is LOS
-     * between eva and ave.
+     * @param bounds bounds of the building to evaluate.
+     * @return true if the building causes a NLOS
      */
-    bool NLOSplan(Ptr<MobilityModel> eva, Ptr<MobilityModel> ave, Ptr<Building> b);
+    bool IsBuildingBetween(const Vector& eva, const Vector& ave, const Box& bounds);
 
     /**
-     * @brief buffer for asserting collision.
+     * @brief Gives the corners that may produce diffraction between two nodes, from their zones
+     *
+     * @param corners corners of the building, indexed by CitySnapshot::Corner
+     * @param rxZone the zone of the destination
+     * @param txZone the zone of the source
+     * @return the corners of buildings that may produce a diffraction
+     */
+    std::vector<Vector> GetCorner(const Vector* corners, Zone rxZone, Zone txZone);
+
+    /**
+     * @brief Gives the point of the walls of a building that may produce reflection between two
+     * positions, from their zones
+     *
+     * @param bounds bounds of the building to evaluate
+     * @param rx the position of the destination
+     * @param tx the position of the source
+     * @param rxZone the zone of the destination
+     * @param txZone the zone of the source
+     * @return the coordinates on the surface that may produce a reflection
      */
-    int buffer;
+    std::optional<Vector> Getreflectionpoint(const Box& bounds,
+                                             const Vector& rx,
+                                             const Vector& tx,
+                                             Zone rxZone,
+                                             Zone txZone);
 };
 
 } // namespace ns3
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#include "foba-zone-cache.h"
+
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("NodeZoneCache");
+
+NS_OBJECT_ENSURE_REGISTERED(NodeZoneCache);
+
+TypeId
+NodeZoneCache::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::NodeZoneCache")
+            .SetParent<Object>()
+            .SetGroupName("Buildings")
+            .AddConstructor<NodeZoneCache>()
+            .AddAttribute("MaxCorners",
+                          "Number of corners above which the visibility of the corners of a node "
+                          "is dropped, on its next use.",
+                          UintegerValue(1024),
+                          MakeUintegerAccessor(&NodeZoneCache::SetMaxCorners,
+                                               &NodeZoneCache::GetMaxCorners),
+                          MakeUintegerChecker<uint32_t>(1));
+    return tid;
+}
+
+NodeZoneCache::NodeZoneCache()
+    : m_maxCorners(1024)
+{
+}
+
+NodeZoneCache::~NodeZoneCache()
+{
+    // The models may outlive a cache that was not disposed
+    Clear();
+}
+
+void
+NodeZoneCache::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Clear();
+    Object::DoDispose();
+}
+
+void
+NodeZoneCache::SetMaxCorners(uint32_t maxCorners)
+{
+    NS_LOG_FUNCTION(this << maxCorners);
+    m_maxCorners = maxCorners;
+}
+
+uint32_t
+NodeZoneCache::GetMaxCorners() const
+{
+    return m_maxCorners;
+}
+
+NLOSassess::Endpoint
+NodeZoneCache::GetEndpoint(Ptr<MobilityModel> node, const CitySnapshot& city, NLOSassess& assess)
+{
+    NLOSassess::Endpoint endpoint{node->GetPosition()};
+    if (node->GetVelocity().GetLength() != 0)
+    {
+        return endpoint;
+    }
+    auto [it, inserted] = m_tracked.try_emplace(PeekPointer(node));
+    Tracked& tracked = it->second;
+    if (inserted)
+    {
+        NS_LOG_FUNCTION(this << node);
+        tracked.model = node;
+        tracked.valid = false;
+        node->TraceConnectWithoutContext("CourseChange",
+                                         MakeCallback(&NodeZoneCache::NotifyCourseChange, this));
+    }
+    // The corners of an endpoint given by an earlier call may still be filled by its users
+    std::lock_guard<std::mutex> lock(tracked.cornersMutex);
+    if (!tracked.valid || (tracked.version != city.GetVersion()))
+    {
+        // The zones are rewritten in place, so no call using them may be running (see the class)
+        assess.GetZones(endpoint.position, city, tracked.zones);
+        tracked.corners.clear();
+        tracked.valid = true;
+        tracked.version = city.GetVersion();
+    }
+    else if (tracked.corners.size() > m_maxCorners)
+    {
+        // The corners are checked again rather than kept without bound
+        tracked.corners.clear();
+    }
+    endpoint.zones = tracked.zones.data();
+    endpoint.corners = &tracked.corners;
+    endpoint.cornersMutex = &tracked.cornersMutex;
+    return endpoint;
+}
+
+void
+NodeZoneCache::Clear()
+{
+    NS_LOG_FUNCTION(this);
+    for (auto& [address, tracked] : m_tracked)
+    {
+        tracked.model->TraceDisconnectWithoutContext(
+            "CourseChange",
+            MakeCallback(&NodeZoneCache::NotifyCourseChange, this));
+    }
+    m_tracked.clear();
+}
+
+void
+NodeZoneCache::NotifyCourseChange(Ptr<const MobilityModel> model)
+{
+    NS_LOG_FUNCTION(this << model);
+    auto it = m_tracked.find(PeekPointer(model));
+    if (it != m_tracked.end())
+    {
+        it->second.valid = false;
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024 Office National d'Etude et de Recherche Aérospatiale (ONERA)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
+ */
+
+#ifndef FOBA_ZONE_CACHE_H
+#define FOBA_ZONE_CACHE_H
+
+#include "foba-city-snapshot.h"
+#include "foba-toolbox.h"
+
+#include "ns3/mobility-model.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Zones of the nodes relatively to all the buildings of a snapshot (see
+ * NLOSassess::GetZones), and visibility of the building corners from the nodes.
+ *
+ * The zones of a node are computed on its first use, and again after its CourseChange trace fired
+ * or the snapshot was rebuilt, instead of once per building and per link. The visibility of the
+ * corners is filled by the users of the endpoints, and reset at the same time as the zones. As a
+ * node moving at a constant velocity does not fire CourseChange, nothing is kept for a moving node
+ * (non zero velocity).
+ *
+ * The zones take one byte per building for each static node, and the visibility of the corners
+ * of a node is dropped once it holds more than MaxCorners corners, so the memory of the cache grows
+ * with the number of static nodes times the number of buildings.
+ *
+ * The cache is not thread-safe, but the visibility of the corners of an endpoint may be filled by
+ * concurrent calls under the mutex of the endpoint, which GetEndpoint also takes to reset it. The
+ * zones of an endpoint are read without lock by its users, so a node must not change its course,
+ * nor the snapshot be rebuilt, while calls using an endpoint of the node are running: the next
+ * GetEndpoint would rewrite the zones under them.
+ */
+class NodeZoneCache : public Object
+{
+  public:
+    /**
+     * @brief Get the type ID.
+     * @return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    NodeZoneCache();
+    ~NodeZoneCache() override;
+
+    /**
+     * @brief Set the number of corners above which the visibility of the corners of a node is
+     * dropped, on its next use
+     * @param maxCorners the number of corners (at least 1)
+     */
+    void SetMaxCorners(uint32_t maxCorners);
+
+    /**
+     * @return the number of corners above which the visibility of the corners of a node is dropped
+     */
+    uint32_t GetMaxCorners() const;
+
+    /**
+     * @brief Get a node with its zones
+     *
+     * @param node the mobility model of the node
+     * @param city the snapshot holding the buildings
+     * @param assess the toolbox computing the zones
+     * @return the node, without zones nor corners if it is moving. Its zones stay valid until
+     * the next GetEndpoint of the node after a CourseChange or a rebuild of the snapshot.
+     */
+    NLOSassess::Endpoint GetEndpoint(Ptr<MobilityModel> node,
+                                     const CitySnapshot& city,
+                                     NLOSassess& assess);
+
+    /**
+     * @brief Forget the zones and the corners of all the nodes
+     */
+    void Clear();
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * @brief A node followed by the cache
+     */
+    struct Tracked
+    {
+        Ptr<MobilityModel> model;             ///< the model, kept to disconnect from its trace
+        bool valid;                           ///< false once the node changed its course
+        uint32_t version;                     ///< version of the snapshot of the zones
+        std::vector<NLOSassess::Zone> zones;  ///< zone of the node for each slot of the snapshot
+        NLOSassess::CornerVisibility corners; ///< visibility of the corners from the node
+        std::mutex cornersMutex;              ///< protects corners from concurrent calls
+    };
+
+    /**
+     * @brief Invalidate the zones of a node
+     * @param model the model whose course changed
+     */
+    void NotifyCourseChange(Ptr<const MobilityModel> model);
+
+    std::unordered_map<const MobilityModel*, Tracked> m_tracked; ///< Followed nodes
+    uint32_t m_maxCorners; ///< Corners above which the visibility of a node is dropped
+};
+
+} // namespace ns3
+
+#endif /* FOBA_ZONE_CACHE_H */
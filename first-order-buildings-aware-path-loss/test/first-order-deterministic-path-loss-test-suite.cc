@@ -6,20 +6,105 @@
  * Author: Hugo LE DIRACH  <hugo.le_dirach@onera.fr>
  */
 
+#include "ns3/building-list.h"
 #include "ns3/constant-position-mobility-model.h"
+#include "ns3/constant-velocity-mobility-model.h"
 #include "ns3/core-module.h"
 #include "ns3/double.h"
 #include "ns3/enum.h"
 #include "ns3/first-order-buildings-aware-propagation-loss-model.h"
+#include "ns3/foba-loss-file.h"
+#include "ns3/foba-loss-matrix-helper.h"
+#include "ns3/foba-loss-stats.h"
+#include "ns3/foba-philox.h"
+#include "ns3/foba-rem-helper.h"
+#include "ns3/foba-scenario-helper.h"
+#include "ns3/foba-segment-box.h"
+#include "ns3/foba-toolbox.h"
+#include "ns3/itu-r-1411-los-propagation-loss-model.h"
 #include "ns3/log.h"
+#include "ns3/node-container.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/string.h"
 #include "ns3/test.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <thread>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("FirstOrderBuildingsAwarePropagationLossModelTest");
 
+/**
+ * @brief Create a city of n x n blocks of 30 m, 12 m high, separated by 20 m wide streets, the
+ * lowest corner of the city being at (0, 0)
+ *
+ * @param n number of blocks along x and along y
+ */
+static void
+CreateBlocks(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        for (uint32_t j = 0; j < n; ++j)
+        {
+            Ptr<Building> b = CreateObject<Building>();
+            b->SetBoundaries(Box(i * 50.0, i * 50.0 + 30.0, j * 50.0, j * 50.0 + 30.0, 0.0, 12.0));
+        }
+    }
+}
+
+/**
+ * @brief Nodes along lines of constant y, every xStep from xFirst up to xEnd (excluded)
+ */
+struct NodeSweep
+{
+    double xFirst;          ///< x of the first node of each line
+    double xEnd;            ///< x bound of the lines (excluded)
+    double xStep;           ///< distance between the nodes of a line
+    std::vector<double> ys; ///< y of each line
+    double z;               ///< height of the nodes
+};
+
+/// Nodes in the streets of CreateBlocks(4) and just outside of the city
+static const NodeSweep STREET_NODES{-20.0, 220.0, 23.0, {-10.0, 40.0, 85.0, 140.0}, 1.5};
+/// Nodes in the streets of CreateBlocks(4) and far from it, with links above 90 dB
+static const NodeSweep SURROUNDING_NODES{-100.0,
+                                         400.0,
+                                         45.0,
+                                         {-60.0, 40.0, 90.0, 140.0, 350.0},
+                                         1.5};
+
+/**
+ * @brief Create the nodes of a sweep
+ *
+ * @param sweep the positions of the nodes
+ * @returns the mobility models of the nodes, by increasing x then in the order of the lines
+ */
+static std::vector<Ptr<MobilityModel>>
+CreateNodes(const NodeSweep& sweep)
+{
+    std::vector<Ptr<MobilityModel>> mobs;
+    for (double x = sweep.xFirst; x < sweep.xEnd; x += sweep.xStep)
+    {
+        for (double y : sweep.ys)
+        {
+            Ptr<MobilityModel> mob = CreateObject<ConstantPositionMobilityModel>();
+            mob->SetPosition(Vector(x, y, sweep.z));
+            mobs.push_back(mob);
+        }
+    }
+    return mobs;
+}
+
 /**
  * @ingroup propagation-tests
  *
@@ -158,6 +243,2186 @@ FirstOrderBuildingsAwarePropagationLossModelTestCase::DoRun()
     // NS_LOG_INFO("Theoretical loss: " << m_lossRef);
 }
 
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the grid spatial index gives the same losses as the exhaustive evaluation
+ *
+ */
+class FirstOrderBuildingsAwareSpatialIndexTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareSpatialIndexTestCase();
+
+  private:
+    /**
+     * Builds a small city and compares both evaluation modes
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareSpatialIndexTestCase::FirstOrderBuildingsAwareSpatialIndexTestCase()
+    : TestCase("Grid spatial index gives the same loss as the exhaustive evaluation")
+{
+}
+
+void
+FirstOrderBuildingsAwareSpatialIndexTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    // 6x6 blocks of 30 m separated by 20 m wide streets, with different heights and materials
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        for (uint32_t j = 0; j < 6; ++j)
+        {
+            Ptr<Building> b = CreateObject<Building>();
+            b->SetBoundaries(Box(i * 50.0,
+                                 i * 50.0 + 30.0,
+                                 j * 50.0,
+                                 j * 50.0 + 30.0,
+                                 0.0,
+                                 10.0 + 5.0 * ((i + j) % 3)));
+            b->SetExtWallsType(static_cast<Building::ExtWallsType_t>((i * 6 + j) % 4));
+        }
+    }
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> exhaustive =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    exhaustive->SetAttribute("NoiseEnabled", BooleanValue(false));
+    // The reference also classifies the nodes against each building for each link
+    exhaustive->SetAttribute("ZoneCache", BooleanValue(false));
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> indexed =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    indexed->SetAttribute("NoiseEnabled", BooleanValue(false));
+    indexed->SetAttribute("ZoneCache", BooleanValue(true));
+    indexed->SetAttribute("SpatialIndex", StringValue("Grid"));
+    indexed->SetAttribute("GridCellSize", DoubleValue(25.0));
+
+    Ptr<MobilityModel> tx_mob = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<MobilityModel> rx_mob = CreateObject<ConstantPositionMobilityModel>();
+
+    // Nodes in the streets, including links running along the building facades
+    for (double tx = -10; tx < 300; tx += 40)
+    {
+        for (double rx = 277.5; rx > -10; rx -= 35)
+        {
+            tx_mob->SetPosition(Vector(tx, 40.0, 1.5));
+            rx_mob->SetPosition(Vector(rx, tx / 2.0 + 140.0, 12.0));
+            NS_TEST_ASSERT_MSG_EQ(indexed->GetLoss(rx_mob, tx_mob),
+                                  exhaustive->GetLoss(rx_mob, tx_mob),
+                                  "Grid index changed the loss from " << tx_mob->GetPosition()
+                                                                      << " to "
+                                                                      << rx_mob->GetPosition());
+            tx_mob->SetPosition(Vector(tx, 31.0, 5.0));
+            rx_mob->SetPosition(Vector(rx, 31.0, 5.0));
+            NS_TEST_ASSERT_MSG_EQ(indexed->GetLoss(rx_mob, tx_mob),
+                                  exhaustive->GetLoss(rx_mob, tx_mob),
+                                  "Grid index changed the loss along the facade at y = 31");
+        }
+    }
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the city snapshot of the model follows the changes of the BuildingList
+ *
+ */
+class FirstOrderBuildingsAwareCitySnapshotTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareCitySnapshotTestCase();
+
+  private:
+    /**
+     * Adds a building between two nodes after a first evaluation of the loss
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareCitySnapshotTestCase::FirstOrderBuildingsAwareCitySnapshotTestCase()
+    : TestCase("City snapshot is rebuilt when the BuildingList changes")
+{
+}
+
+void
+FirstOrderBuildingsAwareCitySnapshotTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    // Buildings added in an order that differs from their position along the street
+    for (double x : {200.0, 0.0, 100.0, 300.0})
+    {
+        Ptr<Building> b = CreateObject<Building>();
+        b->SetBoundaries(Box(x, x + 40.0, 20.0, 60.0, 0.0, 15.0));
+    }
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    model->SetAttribute("NoiseEnabled", BooleanValue(false));
+
+    Ptr<MobilityModel> tx_mob = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<MobilityModel> rx_mob = CreateObject<ConstantPositionMobilityModel>();
+    tx_mob->SetPosition(Vector(90.0, 0.0, 1.5));
+    rx_mob->SetPosition(Vector(150.0, 10.0, 1.5));
+    double losLoss = model->GetLoss(rx_mob, tx_mob);
+
+    // Wooden shed across the street, between the nodes
+    Ptr<Building> shed = CreateObject<Building>();
+    shed->SetBoundaries(Box(110.0, 120.0, -10.0, 15.0, 0.0, 5.0));
+    shed->SetExtWallsType(Building::Wood);
+
+    double nlosLoss = model->GetLoss(rx_mob, tx_mob);
+    NS_TEST_ASSERT_MSG_GT(nlosLoss, losLoss, "The new building was not taken into account");
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> fresh =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    fresh->SetAttribute("NoiseEnabled", BooleanValue(false));
+    NS_TEST_ASSERT_MSG_EQ(nlosLoss,
+                          fresh->GetLoss(rx_mob, tx_mob),
+                          "The rebuilt snapshot differs from a new one");
+
+    // The shed is moved away from the link, which is only seen once the model is notified
+    shed->SetBoundaries(Box(110.0, 120.0, -40.0, -30.0, 0.0, 5.0));
+    NS_TEST_ASSERT_MSG_EQ(model->GetLoss(rx_mob, tx_mob), nlosLoss, "Unexpected snapshot update");
+    model->NotifyBuildingsChanged();
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> moved =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    moved->SetAttribute("NoiseEnabled", BooleanValue(false));
+    NS_TEST_ASSERT_MSG_EQ(model->GetLoss(rx_mob, tx_mob),
+                          moved->GetLoss(rx_mob, tx_mob),
+                          "The moved building was not taken into account");
+
+    // Same number of buildings in a new BuildingList, the stone shed now blocks the link
+    Simulator::Destroy();
+    for (double x : {200.0, 0.0, 100.0, 300.0})
+    {
+        Ptr<Building> b = CreateObject<Building>();
+        b->SetBoundaries(Box(x, x + 40.0, 20.0, 60.0, 0.0, 15.0));
+    }
+    Ptr<Building> stone = CreateObject<Building>();
+    stone->SetBoundaries(Box(130.0, 135.0, -10.0, 15.0, 0.0, 5.0));
+    stone->SetExtWallsType(Building::StoneBlocks);
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> recreated =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    recreated->SetAttribute("NoiseEnabled", BooleanValue(false));
+    NS_TEST_ASSERT_MSG_EQ(model->GetLoss(rx_mob, tx_mob),
+                          recreated->GetLoss(rx_mob, tx_mob),
+                          "The buildings of the new BuildingList were not taken into account");
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the link cache gives the same losses as the computation, and follows the
+ * moves of the nodes
+ *
+ */
+class FirstOrderBuildingsAwareLinkCacheTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareLinkCacheTestCase();
+
+  private:
+    /**
+     * Evaluates the same links with and without the cache, before and after moving a node
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareLinkCacheTestCase::FirstOrderBuildingsAwareLinkCacheTestCase()
+    : TestCase("Link cache gives the same loss and is invalidated by the moves of the nodes")
+{
+}
+
+void
+FirstOrderBuildingsAwareLinkCacheTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    for (double x : {0.0, 100.0, 200.0})
+    {
+        Ptr<Building> b = CreateObject<Building>();
+        b->SetBoundaries(Box(x, x + 40.0, 20.0, 60.0, 0.0, 15.0));
+    }
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> computed =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    computed->SetAttribute("NoiseEnabled", BooleanValue(false));
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> cached =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    cached->SetAttribute("NoiseEnabled", BooleanValue(false));
+    cached->SetAttribute("LinkCache", BooleanValue(true));
+    Ptr<LinkLossCache> cache = cached->GetLinkCache();
+
+    Ptr<MobilityModel> a_mob = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<MobilityModel> b_mob = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<MobilityModel> c_mob = CreateObject<ConstantPositionMobilityModel>();
+    a_mob->SetPosition(Vector(20.0, 0.0, 1.5));
+    b_mob->SetPosition(Vector(170.0, 80.0, 3.0));
+    c_mob->SetPosition(Vector(120.0, 10.0, 1.5));
+
+    // Both directions of each link, twice: the second pass only hits the cache
+    std::vector<std::pair<Ptr<MobilityModel>, Ptr<MobilityModel>>> links = {{a_mob, b_mob},
+                                                                          {b_mob, a_mob},
+                                                                          {a_mob, c_mob},
+                                                                          {c_mob, a_mob},
+                                                                          {b_mob, c_mob},
+                                                                          {c_mob, b_mob}};
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (const auto& [rx, tx] : links)
+        {
+            NS_TEST_ASSERT_MSG_EQ(cached->GetLoss(rx, tx),
+                                  computed->GetLoss(rx, tx),
+                                  "Link cache changed the loss from " << tx->GetPosition() << " to "
+                                                                      << rx->GetPosition());
+        }
+    }
+    NS_TEST_ASSERT_MSG_EQ(cache->GetMisses(), links.size(), "Unexpected number of misses");
+    NS_TEST_ASSERT_MSG_EQ(cache->GetHits(), links.size(), "Unexpected number of hits");
+    NS_TEST_ASSERT_MSG_EQ(cache->GetNEntries(), 3, "Unexpected number of links");
+
+    // Moving a node invalidates its links only
+    b_mob->SetPosition(Vector(60.0, 80.0, 3.0));
+    for (const auto& [rx, tx] : links)
+    {
+        NS_TEST_ASSERT_MSG_EQ(cached->GetLoss(rx, tx),
+                              computed->GetLoss(rx, tx),
+                              "Link cache kept the loss of a moved node");
+    }
+    NS_TEST_ASSERT_MSG_EQ(cache->GetMisses(), links.size() + 4, "Moved links not invalidated");
+    NS_TEST_ASSERT_MSG_EQ(cache->GetHits(), links.size() + 2, "Static link invalidated");
+
+    // The least recently used links are evicted
+    cached->SetAttribute("LinkCacheMaxEntries", UintegerValue(1));
+    NS_TEST_ASSERT_MSG_EQ(cache->GetNEntries(), 1, "Links not evicted");
+    NS_TEST_ASSERT_MSG_EQ(cache->GetEvictions(), 2, "Unexpected number of evictions");
+    NS_TEST_ASSERT_MSG_EQ(cached->GetLoss(c_mob, b_mob),
+                          computed->GetLoss(c_mob, b_mob),
+                          "Most recently used link evicted");
+    NS_TEST_ASSERT_MSG_EQ(cache->GetHits(), links.size() + 3, "Most recently used link evicted");
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the batch loss gives the same losses as GetLoss for each destination, with one
+ * or several threads
+ *
+ */
+class FirstOrderBuildingsAwareLossBatchTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareLossBatchTestCase();
+
+  private:
+    /**
+     * Evaluates a source against destinations spread in a small city, in one batch and one by one
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareLossBatchTestCase::FirstOrderBuildingsAwareLossBatchTestCase()
+    : TestCase("Batch loss gives the same loss as GetLoss for each destination")
+{
+}
+
+void
+FirstOrderBuildingsAwareLossBatchTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    CreateBlocks(4);
+
+    Ptr<MobilityModel> tx_mob = CreateObject<ConstantPositionMobilityModel>();
+    tx_mob->SetPosition(Vector(40.0, 90.0, 1.5));
+    std::vector<Ptr<MobilityModel>> rx_mobs =
+        CreateNodes({-10.0, 200.0, 25.0, {-10.0, 40.0, 140.0, 190.0}, 3.0});
+
+    // Same noise draws in both models, the reference does not keep anything about the nodes
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> batch =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    batch->SetAttribute("ZoneCache", BooleanValue(true));
+    batch->AssignStreams(1);
+    // The visibility of the corners of the source is dropped between the passes
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> threaded =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    threaded->SetAttribute("ZoneCache", BooleanValue(true));
+    threaded->SetAttribute("ZoneCacheMaxCorners", UintegerValue(4));
+    threaded->SetAttribute("ThreadCount", UintegerValue(4));
+    threaded->AssignStreams(1);
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> single =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    single->SetAttribute("ZoneCache", BooleanValue(false));
+    single->AssignStreams(1);
+
+    std::vector<double> losses(rx_mobs.size());
+    std::vector<double> threadedLosses(rx_mobs.size());
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        batch->GetLossBatch(tx_mob, rx_mobs, losses);
+        threaded->GetLossBatch(tx_mob, rx_mobs, threadedLosses);
+        for (size_t i = 0; i < rx_mobs.size(); ++i)
+        {
+            NS_TEST_ASSERT_MSG_EQ(losses[i],
+                                  single->GetLoss(rx_mobs[i], tx_mob),
+                                  "Batch changed the loss to " << rx_mobs[i]->GetPosition());
+            NS_TEST_ASSERT_MSG_EQ(threadedLosses[i],
+                                  losses[i],
+                                  "Threads changed the loss to " << rx_mobs[i]->GetPosition());
+        }
+    }
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that threads sharing one model get the same losses as a model used by one thread
+ *
+ */
+class FirstOrderBuildingsAwareReentrancyTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareReentrancyTestCase();
+
+  private:
+    /**
+     * Computes the links of disjoint groups of nodes from several threads at the same time
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareReentrancyTestCase::FirstOrderBuildingsAwareReentrancyTestCase()
+    : TestCase("Threads sharing a model get the same losses as a single thread")
+{
+}
+
+void
+FirstOrderBuildingsAwareReentrancyTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    CreateBlocks(4);
+
+    // Each thread only uses its own nodes, the reference counts of the Ptr are not atomic
+    const uint32_t threadCount = 4;
+    std::vector<std::vector<Ptr<MobilityModel>>> groups(threadCount);
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        groups[t] =
+            CreateNodes({-10.0 + t * 5.0, 200.0, 40.0, {-10.0, 40.0, 140.0, 190.0}, 1.5 + t});
+    }
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> single =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    single->SetAttribute("NoiseEnabled", BooleanValue(false));
+    std::vector<std::vector<double>> expected(threadCount);
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        for (const auto& rx : groups[t])
+        {
+            for (const auto& tx : groups[t])
+            {
+                expected[t].push_back(single->GetLoss(rx, tx));
+            }
+        }
+    }
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> shared =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    shared->SetAttribute("NoiseEnabled", BooleanValue(false));
+    shared->SetAttribute("LinkCache", BooleanValue(true));
+    shared->SetAttribute("ThreadCount", UintegerValue(2));
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> noisy =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    noisy->AssignStreams(1);
+    // The buildings are snapshot before the threads, nothing changes while they run
+    shared->GetLoss(groups[0][0], groups[0][1]);
+    noisy->GetLoss(groups[0][0], groups[0][1]);
+
+    std::vector<std::vector<double>> losses(threadCount);
+    std::vector<std::vector<double>> batchLosses(threadCount);
+    std::vector<uint8_t> finite(threadCount, 1);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            const auto& group = groups[t];
+            std::vector<double> out(group.size());
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                losses[t].clear();
+                batchLosses[t].clear();
+                for (const auto& tx : group)
+                {
+                    for (const auto& rx : group)
+                    {
+                        losses[t].push_back(shared->GetLoss(rx, tx));
+                        if (rx != tx)
+                        {
+                            finite[t] = finite[t] && std::isfinite(noisy->GetLoss(rx, tx));
+                        }
+                    }
+                    shared->GetLossBatch(tx, group, out);
+                    batchLosses[t].insert(batchLosses[t].end(), out.begin(), out.end());
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        NS_TEST_ASSERT_MSG_EQ(finite[t], 1, "Noisy loss not finite in thread " << t);
+        size_t n = groups[t].size();
+        for (size_t k = 0; k < losses[t].size(); ++k)
+        {
+            // Computed source by source in the threads, destination by destination above
+            double loss = expected[t][(k % n) * n + k / n];
+            NS_TEST_ASSERT_MSG_EQ(losses[t][k], loss, "Thread " << t << " changed loss " << k);
+            NS_TEST_ASSERT_MSG_EQ(batchLosses[t][k],
+                                  loss,
+                                  "Thread " << t << " changed batch loss " << k);
+        }
+    }
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check the Philox generator against its known answers, and that the Philox noise of a
+ * link does not depend on the order in which the links are evaluated
+ *
+ */
+class FirstOrderBuildingsAwarePhiloxNoiseTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwarePhiloxNoiseTestCase();
+
+  private:
+    /**
+     * Evaluates the links of a few nodes in two orders, one by one and in batches
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwarePhiloxNoiseTestCase::FirstOrderBuildingsAwarePhiloxNoiseTestCase()
+    : TestCase("Philox noise does not depend on the order of the links")
+{
+}
+
+void
+FirstOrderBuildingsAwarePhiloxNoiseTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    // Known answers of Philox4x32-10 (Random123)
+    PhiloxCounter words = Philox4x32({0, 0, 0, 0}, 0);
+    NS_TEST_ASSERT_MSG_EQ(words[0], 0x6627e8d5U, "Wrong Philox4x32 word 0");
+    NS_TEST_ASSERT_MSG_EQ(words[3], 0x9b00dbd8U, "Wrong Philox4x32 word 3");
+    words = Philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, 0x299f31d0a4093822);
+    NS_TEST_ASSERT_MSG_EQ(words[0], 0xd16cfe09U, "Wrong Philox4x32 word 0");
+    NS_TEST_ASSERT_MSG_EQ(words[1], 0x94fdccebU, "Wrong Philox4x32 word 1");
+    NS_TEST_ASSERT_MSG_EQ(words[2], 0x5001e420U, "Wrong Philox4x32 word 2");
+    NS_TEST_ASSERT_MSG_EQ(words[3], 0x24126ea1U, "Wrong Philox4x32 word 3");
+
+    Ptr<Building> b = CreateObject<Building>();
+    b->SetBoundaries(Box(20.0, 50.0, 20.0, 50.0, 0.0, 12.0));
+
+    // The draws are keyed by the ids of the nodes
+    NodeContainer nodes;
+    nodes.Create(6);
+    std::vector<Ptr<MobilityModel>> mobs;
+    for (uint32_t i = 0; i < nodes.GetN(); ++i)
+    {
+        Ptr<MobilityModel> mob = CreateObject<ConstantPositionMobilityModel>();
+        mob->SetPosition(Vector(35.0 * (i / 2), 70.0 * (i % 2), 1.5));
+        nodes.Get(i)->AggregateObject(mob);
+        mobs.push_back(mob);
+    }
+    const size_t n = mobs.size();
+
+    auto createModel = [](uint32_t threads) {
+        Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+            CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+        model->SetAttribute("NoiseEngine", StringValue("Philox"));
+        model->SetAttribute("ThreadCount", UintegerValue(threads));
+        model->AssignStreams(7);
+        return model;
+    };
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> forward = createModel(1);
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> backward = createModel(1);
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> batch = createModel(4);
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> deterministic = createModel(1);
+    deterministic->SetAttribute("NoiseEnabled", BooleanValue(false));
+
+    // Two draws for each link, the links being evaluated in opposite orders
+    std::vector<double> forwardLosses(2 * n * n);
+    std::vector<double> backwardLosses(2 * n * n);
+    std::vector<double> batchLosses(2 * n * n);
+    for (size_t pass = 0; pass < 2; ++pass)
+    {
+        for (size_t k = 0; k < n * n; ++k)
+        {
+            size_t l = n * n - 1 - k;
+            forwardLosses[pass * n * n + k] = forward->GetLoss(mobs[k / n], mobs[k % n]);
+            backwardLosses[pass * n * n + l] = backward->GetLoss(mobs[l / n], mobs[l % n]);
+        }
+        for (size_t j = 0; j < n; ++j)
+        {
+            std::vector<double> out(n);
+            batch->GetLossBatch(mobs[n - 1 - j], mobs, out);
+            for (size_t i = 0; i < n; ++i)
+            {
+                batchLosses[pass * n * n + i * n + n - 1 - j] = out[i];
+            }
+        }
+    }
+
+    for (size_t k = 0; k < 2 * n * n; ++k)
+    {
+        if ((k % (n * n)) / n == k % n)
+        {
+            // No loss from a node to itself
+            continue;
+        }
+        NS_TEST_ASSERT_MSG_EQ(backwardLosses[k], forwardLosses[k], "Order changed noise " << k);
+        NS_TEST_ASSERT_MSG_EQ(batchLosses[k], forwardLosses[k], "Batch changed noise " << k);
+    }
+    // The noise changes from a draw of a link to the next
+    size_t i = 1;
+    double loss = deterministic->GetLoss(mobs[i / n], mobs[i % n]);
+    NS_TEST_ASSERT_MSG_NE(forwardLosses[i], loss, "No noise drawn");
+    NS_TEST_ASSERT_MSG_NE(forwardLosses[n * n + i], forwardLosses[i], "Same draw twice");
+
+    // Without assigned stream, each model takes its own automatic stream
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> first =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    first->SetAttribute("NoiseEngine", StringValue("Philox"));
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> second =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    second->SetAttribute("NoiseEngine", StringValue("Philox"));
+    NS_TEST_ASSERT_MSG_NE(first->GetLoss(mobs[0], mobs[1]),
+                          second->GetLoss(mobs[0], mobs[1]),
+                          "Same noise for two models without assigned stream");
+
+    // The draws of the mobility models without node are counted apart from those of the nodes
+    Ptr<MobilityModel> unbound = CreateObject<ConstantPositionMobilityModel>();
+    unbound->SetPosition(mobs[1]->GetPosition());
+    double unboundLoss = forward->GetLoss(mobs[0], unbound);
+    NS_TEST_ASSERT_MSG_NE(unboundLoss, forward->GetLoss(mobs[0], unbound), "Same draw twice");
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the ITU-R 1411 loss of the model matches ItuR1411LosPropagationLossModel
+ *
+ */
+class FirstOrderBuildingsAwareItuR1411TestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareItuR1411TestCase();
+
+  private:
+    /**
+     * Compares the losses of links without buildings, on both sides of the breakpoint, for two
+     * frequencies
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareItuR1411TestCase::FirstOrderBuildingsAwareItuR1411TestCase()
+    : TestCase("ITU-R 1411 loss matches ItuR1411LosPropagationLossModel")
+{
+}
+
+void
+FirstOrderBuildingsAwareItuR1411TestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    // Without buildings, the loss is the ITU-R 1411 loss of the direct path
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    model->SetAttribute("NoiseEnabled", BooleanValue(false));
+    model->SetAttribute("ZoneCache", BooleanValue(false));
+    Ptr<ItuR1411LosPropagationLossModel> itu = CreateObject<ItuR1411LosPropagationLossModel>();
+
+    Ptr<MobilityModel> a = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<MobilityModel> b = CreateObject<ConstantPositionMobilityModel>();
+    for (double frequency : {2160e6, 5.9e9})
+    {
+        model->SetAttribute("Frequency", DoubleValue(frequency));
+        itu->SetAttribute("Frequency", DoubleValue(frequency));
+        for (double height : {1.0, 1.5, 10.0})
+        {
+            // The breakpoint is between 40 m and 1.2 km
+            for (double distance : {2.0, 15.0, 120.0, 900.0, 4000.0})
+            {
+                a->SetPosition(Vector(0.0, 0.0, 1.5));
+                b->SetPosition(Vector(distance, 0.0, height));
+                NS_TEST_ASSERT_MSG_EQ_TOL(model->GetLoss(a, b),
+                                          itu->GetLoss(a, b),
+                                          1e-9,
+                                          "Wrong loss at " << distance << " m, height " << height
+                                                           << " m, " << frequency << " Hz");
+            }
+        }
+    }
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the table diffraction mode stays within its largest error of the exact mode
+ *
+ */
+class FirstOrderBuildingsAwareDiffractionTableTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareDiffractionTableTestCase();
+
+  private:
+    /**
+     * Compares the losses of the links of nodes spread in and around a small city in both modes
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareDiffractionTableTestCase::FirstOrderBuildingsAwareDiffractionTableTestCase()
+    : TestCase("Table diffraction mode stays within its largest error")
+{
+}
+
+void
+FirstOrderBuildingsAwareDiffractionTableTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    CreateBlocks(4);
+
+    std::vector<Ptr<MobilityModel>> mobs = CreateNodes(STREET_NODES);
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> exact =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    exact->SetAttribute("NoiseEnabled", BooleanValue(false));
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> table =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    table->SetAttribute("NoiseEnabled", BooleanValue(false));
+    table->SetAttribute("DiffractionMode", StringValue("Table"));
+
+    double maxError = table->GetDiffractionMaxError();
+    NS_TEST_ASSERT_MSG_EQ(exact->GetDiffractionMaxError(), 0.0, "Exact mode with an error");
+    NS_TEST_ASSERT_MSG_GT(maxError, 0.0, "Table error not measured");
+    NS_TEST_ASSERT_MSG_LT(maxError, 0.01, "Table error above its documented bound");
+    double largest = 0.0;
+    for (const auto& rx : mobs)
+    {
+        for (const auto& tx : mobs)
+        {
+            if (rx == tx)
+            {
+                continue;
+            }
+            double difference = std::abs(table->GetLoss(rx, tx) - exact->GetLoss(rx, tx));
+            largest = std::max(largest, difference);
+            NS_TEST_ASSERT_MSG_LT_OR_EQ(difference,
+                                        maxError + 1e-9,
+                                        "Table changed the loss from " << tx->GetPosition()
+                                                                       << " to "
+                                                                       << rx->GetPosition());
+        }
+    }
+    NS_TEST_ASSERT_MSG_GT(largest, 0.0, "No diffraction in the scenario");
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the LOS diffraction loss of the corners near the edge of the diffraction
+ * corridor is the one of the exhaustive evaluation of the corner
+ *
+ */
+class FirstOrderBuildingsAwareDiffractionCorridorTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareDiffractionCorridorTestCase();
+
+  private:
+    /**
+     * Places LOS links passing a building corner at deviations around the angle where the
+     * diffraction loss crosses 0 dB, and compares with the loss computed by hand
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareDiffractionCorridorTestCase::
+    FirstOrderBuildingsAwareDiffractionCorridorTestCase()
+    : TestCase("LOS diffraction corridor keeps the corners with a positive loss")
+{
+}
+
+void
+FirstOrderBuildingsAwareDiffractionCorridorTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    // The only corner of the link is the top left one, at (0, 0)
+    Ptr<Building> b = CreateObject<Building>();
+    b->SetBoundaries(Box(0.0, 60.0, -60.0, 0.0, 0.0, 12.0));
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    model->SetAttribute("NoiseEnabled", BooleanValue(false));
+    model->SetAttribute("Frequency", DoubleValue(2160e6));
+    Ptr<ItuR1411LosPropagationLossModel> itu = CreateObject<ItuR1411LosPropagationLossModel>();
+    itu->SetAttribute("Frequency", DoubleValue(2160e6));
+
+    // DiffFunct of the model, of the opposite of the deviation of a LOS path
+    auto diffFunct = [](double angle) { return -0.70 / std::exp(-angle / 24.9 - 3.555) + 31.7; };
+    // The loss crosses 0 dB at about 6.42 deg, the edge of the corridor for a corner half way
+    const double edge = -24.9 * (3.555 + std::log(0.70 / 31.7));
+    NS_TEST_ASSERT_MSG_EQ_TOL(diffFunct(edge), 0.0, 1e-9, "Wrong angle of the corridor edge");
+
+    // Links of 100 m at 45 deg, passing the corner at a fraction of their length
+    const double length = 100.0;
+    const double ux = std::sqrt(0.5);
+    const double uy = std::sqrt(0.5);
+    auto halfWayOffset = [&](double angle) {
+        return 0.5 * length * std::tan(0.5 * angle * M_PI / 180.0);
+    };
+    struct Case
+    {
+        double along;  ///< fraction of the link before the corner
+        double offset; ///< distance from the corner to the link (in m)
+        bool positive; ///< expected sign of the diffraction loss
+    };
+
+    std::vector<Case> cases = {
+        {0.5, halfWayOffset(edge - 0.12), true},  // just inside the corridor
+        {0.5, halfWayOffset(edge + 0.12), false}, // just outside the corridor
+        {0.25, 2.0, true},                        // in the corridor, off the middle
+        {0.25, 2.5, false},                       // in the corridor, beyond the angle
+        {0.5, halfWayOffset(edge - 2.0), true},   // well inside the corridor
+    };
+
+    Ptr<MobilityModel> tx = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<MobilityModel> rx = CreateObject<ConstantPositionMobilityModel>();
+    for (const auto& c : cases)
+    {
+        // Point of the link closest to the corner, on the side of the link away from the building
+        double px = -uy * c.offset;
+        double py = ux * c.offset;
+        tx->SetPosition(Vector(px - c.along * length * ux, py - c.along * length * uy, 1.5));
+        rx->SetPosition(Vector(px + (1 - c.along) * length * ux,
+                               py + (1 - c.along) * length * uy,
+                               1.5));
+
+        double deviation = (std::atan(c.offset / (c.along * length)) +
+                            std::atan(c.offset / ((1 - c.along) * length))) *
+                           180.0 / M_PI;
+        double cornerLoss = diffFunct(deviation);
+        NS_TEST_ASSERT_MSG_EQ((cornerLoss > 0),
+                              c.positive,
+                              "Wrong scenario at a deviation of " << deviation << " deg");
+        double expected = itu->GetLoss(rx, tx) + std::max(0.0, cornerLoss);
+        NS_TEST_ASSERT_MSG_EQ_TOL(model->GetLoss(rx, tx),
+                                  expected,
+                                  1e-9,
+                                  "Wrong loss at a deviation of " << deviation << " deg");
+        NS_TEST_ASSERT_MSG_EQ_TOL(model->GetLoss(tx, rx),
+                                  expected,
+                                  1e-9,
+                                  "Wrong reverse loss at a deviation of " << deviation << " deg");
+    }
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check the reflection points and losses against hand computed ones, and the reflection
+ * search against the evaluation of every building
+ *
+ */
+class FirstOrderBuildingsAwareReflectionTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareReflectionTestCase();
+
+  private:
+    /**
+     * Checks the reflection points on the walls of single buildings, then compares the losses of
+     * the links of nodes spread in a small layout with the best reflection on any building
+     */
+    void DoRun() override;
+
+    /**
+     * Sink of the LossBreakdown trace source, keeps the last terms
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @param breakdown the terms of the loss
+     */
+    void Breakdown(Ptr<const MobilityModel> rx,
+                   Ptr<const MobilityModel> tx,
+                   const FirstOrderBuildingsAwarePropagationLossModel::LossBreakdown& breakdown);
+
+    FirstOrderBuildingsAwarePropagationLossModel::LossBreakdown m_breakdown; ///< Last terms
+};
+
+FirstOrderBuildingsAwareReflectionTestCase::FirstOrderBuildingsAwareReflectionTestCase()
+    : TestCase("Reflection points and losses match the hand computed and exhaustive ones")
+{
+}
+
+void
+FirstOrderBuildingsAwareReflectionTestCase::Breakdown(
+    Ptr<const MobilityModel> rx,
+    Ptr<const MobilityModel> tx,
+    const FirstOrderBuildingsAwarePropagationLossModel::LossBreakdown& breakdown)
+{
+    m_breakdown = breakdown;
+}
+
+void
+FirstOrderBuildingsAwareReflectionTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    using Model = FirstOrderBuildingsAwarePropagationLossModel;
+
+    /*
+     * The link from (5, -5) to (5, 15) crosses the blocker from its bottom to its top side, which
+     * has no diffraction corner, and is reflected by the x-wall of the reflector at (20, 5):
+     * - the far reflector gives a longer reflected path, at (-30, 5);
+     * - the specular point of the short wall, at y = 5, is below its extent;
+     * - both nodes are on the line of the x-wall of the thin building.
+     */
+    const Box blocker(0.0, 10.0, 0.0, 10.0, 0.0, 12.0);
+    const Box reflector(20.0, 30.0, -20.0, 30.0, 0.0, 12.0);
+    const Box farReflector(-40.0, -30.0, -20.0, 30.0, 0.0, 12.0);
+    const Box shortWall(-20.0, -12.0, 8.0, 40.0, 0.0, 12.0);
+    const Box thin(5.0, 8.0, -10.0, 0.0, 0.0, 12.0);
+    const Vector txPos(5.0, -5.0, 1.5);
+    const Vector rxPos(5.0, 15.0, 1.5);
+
+    Ptr<NLOSassess> assess = CreateObject<NLOSassess>();
+    auto checkPoint = [&](const Box& bounds, const Vector& rx, const Vector& tx, Vector expected) {
+        std::optional<Vector> point = assess->Getreflectionpoint(bounds, rx, tx);
+        NS_TEST_ASSERT_MSG_EQ(point.has_value(), true, "No reflection point for " << bounds);
+        if (point)
+        {
+            NS_TEST_ASSERT_MSG_EQ_TOL(point->x, expected.x, 1e-12, "Wrong x on " << bounds);
+            NS_TEST_ASSERT_MSG_EQ_TOL(point->y, expected.y, 1e-12, "Wrong y on " << bounds);
+        }
+    };
+    checkPoint(reflector, rxPos, txPos, Vector(20.0, 5.0, 1.0));
+    checkPoint(farReflector, rxPos, txPos, Vector(-30.0, 5.0, 1.0));
+    // Nodes at 5 m and 15 m of the wall, the specular point is at a quarter of their y distance
+    checkPoint(reflector, Vector(5.0, 25.0, 1.5), Vector(15.0, -5.0, 1.5), Vector(20.0, 2.5, 1.0));
+    checkPoint(Box(-20.0, 30.0, 20.0, 30.0, 0.0, 12.0),
+               Vector(15.0, 5.0, 1.5),
+               Vector(-5.0, 5.0, 1.5),
+               Vector(5.0, 20.0, 1.0));
+    NS_TEST_ASSERT_MSG_EQ(assess->Getreflectionpoint(blocker, rxPos, txPos).has_value(),
+                          false,
+                          "Reflection between the opposite sides of a building");
+    NS_TEST_ASSERT_MSG_EQ(assess->Getreflectionpoint(shortWall, rxPos, txPos).has_value(),
+                          false,
+                          "Reflection point outside of the wall");
+    std::optional<Vector> collinear = assess->Getreflectionpoint(thin, rxPos, txPos);
+    NS_TEST_ASSERT_MSG_EQ((!collinear || std::isnan(collinear->y)),
+                          true,
+                          "Reflection point of nodes on the line of the wall");
+
+    for (const Box& bounds : {blocker, reflector, farReflector, shortWall, thin})
+    {
+        Ptr<Building> b = CreateObject<Building>();
+        b->SetBoundaries(bounds);
+        b->SetExtWallsType(Building::StoneBlocks);
+    }
+
+    const double txGain = 20.0;
+    const double reflectionCoef = 0.9; // StoneBlocks
+    Ptr<ItuR1411LosPropagationLossModel> itu = CreateObject<ItuR1411LosPropagationLossModel>();
+    itu->SetAttribute("Frequency", DoubleValue(2160e6));
+    auto reflectedLoss = [&](Ptr<MobilityModel> rx, Ptr<MobilityModel> tx, Ptr<MobilityModel> p) {
+        double firstHalf = txGain - itu->GetLoss(tx, p);
+        double coef = (firstHalf > 0) ? reflectionCoef : 2 - reflectionCoef;
+        return txGain - (firstHalf * coef - itu->GetLoss(p, rx));
+    };
+    // Best reflection on any building, the legs are only checked against the reflecting one
+    Ptr<MobilityModel> point = CreateObject<ConstantPositionMobilityModel>();
+    auto exhaustiveLoss = [&](Ptr<MobilityModel> rx, Ptr<MobilityModel> tx) {
+        double best = std::numeric_limits<double>::infinity();
+        for (auto it = BuildingList::Begin(); it != BuildingList::End(); ++it)
+        {
+            std::optional<Vector> p = assess->Getreflectionpoint(*it, rx, tx);
+            if (!p)
+            {
+                continue;
+            }
+            point->SetPosition(*p);
+            if (assess->GetBuildingsBetween(point, rx, {*it}).empty() &&
+                assess->GetBuildingsBetween(point, tx, {*it}).empty())
+            {
+                double loss = reflectedLoss(rx, tx, point);
+                best = std::isnan(loss) ? best : std::min(best, loss);
+            }
+        }
+        return best;
+    };
+
+    Ptr<MobilityModel> tx = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<MobilityModel> rx = CreateObject<ConstantPositionMobilityModel>();
+    tx->SetPosition(txPos);
+    rx->SetPosition(rxPos);
+    point->SetPosition(Vector(20.0, 5.0, 1.0));
+    const double expected = reflectedLoss(rx, tx, point);
+    NS_TEST_ASSERT_MSG_LT(expected,
+                          itu->GetLoss(rx, tx) + 80,
+                          "The reflection does not beat the penetration of the blocker");
+
+    // Nodes around the buildings, those inside of one are dropped
+    std::vector<Ptr<MobilityModel>> mobs =
+        CreateNodes({-25.0, 20.0, 10.0, {-15.0, -5.0, 5.0, 15.0, 25.0, 35.0}, 1.5});
+    std::erase_if(mobs, [](Ptr<MobilityModel> mob) {
+        Vector p = mob->GetPosition();
+        return std::any_of(BuildingList::Begin(), BuildingList::End(), [&p](Ptr<Building> b) {
+            Box box = b->GetBoundaries();
+            return (p.x > box.xMin) && (p.x < box.xMax) && (p.y > box.yMin) && (p.y < box.yMax);
+        });
+    });
+
+    for (const char* index : {"None", "Grid"})
+    {
+        Ptr<Model> model = CreateObject<Model>();
+        model->SetAttribute("NoiseEnabled", BooleanValue(false));
+        model->SetAttribute("Frequency", DoubleValue(2160e6));
+        model->SetAttribute("TxGain", DoubleValue(txGain));
+        model->SetAttribute("SpatialIndex", StringValue(index));
+        model->TraceConnectWithoutContext(
+            "LossBreakdown",
+            MakeCallback(&FirstOrderBuildingsAwareReflectionTestCase::Breakdown, this));
+
+        for (const auto& [a, b] : {std::pair(rx, tx), std::pair(tx, rx)})
+        {
+            NS_TEST_ASSERT_MSG_EQ_TOL(model->GetLoss(a, b),
+                                      expected,
+                                      1e-9,
+                                      "Wrong reflected loss with the " << index << " index");
+            NS_TEST_ASSERT_MSG_EQ(m_breakdown.path, Model::REFLECTION_PATH, "Not reflected");
+            NS_TEST_ASSERT_MSG_EQ(m_breakdown.reflectionPoint,
+                                  Vector(20.0, 5.0, 1.0),
+                                  "Wrong reflection point");
+            NS_TEST_ASSERT_MSG_EQ(m_breakdown.reflectionWall,
+                                  FacadeIndex::X_MIN,
+                                  "Wrong reflecting wall");
+        }
+
+        // No reflection below the loss is missed, and the selected one is the best
+        uint32_t reflected = 0;
+        for (const auto& a : mobs)
+        {
+            for (const auto& b : mobs)
+            {
+                if (a == b)
+                {
+                    continue;
+                }
+                double loss = model->GetLoss(a, b);
+                double best = exhaustiveLoss(a, b);
+                NS_TEST_ASSERT_MSG_LT_OR_EQ(loss,
+                                            best + 1e-9,
+                                            "Reflection missed from " << b->GetPosition() << " to "
+                                                                      << a->GetPosition());
+                if (m_breakdown.path == Model::REFLECTION_PATH)
+                {
+                    ++reflected;
+                    NS_TEST_ASSERT_MSG_EQ_TOL(loss,
+                                              best,
+                                              1e-9,
+                                              "Not the best reflection from "
+                                                  << b->GetPosition() << " to "
+                                                  << a->GetPosition());
+                }
+            }
+        }
+        NS_TEST_ASSERT_MSG_GT(reflected, 0, "No reflected link in the layout");
+    }
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the lower bounds of the NLOS paths prune some work, and that the counters of
+ * the pruned work in the loss statistics are consistent
+ *
+ */
+class FirstOrderBuildingsAwarePruningTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwarePruningTestCase();
+
+  private:
+    /**
+     * Computes the losses of the links of nodes spread in and around a small city, and checks the
+     * counters with the statistics disabled, enabled and after a reset
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwarePruningTestCase::FirstOrderBuildingsAwarePruningTestCase()
+    : TestCase("Lower bounds of the NLOS paths prune work")
+{
+}
+
+void
+FirstOrderBuildingsAwarePruningTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    CreateBlocks(4);
+
+    std::vector<Ptr<MobilityModel>> mobs = CreateNodes(STREET_NODES);
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    model->SetAttribute("NoiseEnabled", BooleanValue(false));
+    auto computeLosses = [&]() {
+        for (const auto& rx : mobs)
+        {
+            for (const auto& tx : mobs)
+            {
+                if (rx != tx)
+                {
+                    model->GetLoss(rx, tx);
+                }
+            }
+        }
+    };
+    Ptr<LossStatistics> stats = model->GetStatistics();
+    auto prunedWork = [&stats]() {
+        return stats->GetCount(LossStatistics::NLOS_LINKS) +
+               stats->GetCount(LossStatistics::DIFFRACTIONS_PRUNED) +
+               stats->GetCount(LossStatistics::REFLECTIONS_PRUNED) +
+               stats->GetCount(LossStatistics::REFLECTIONS_EVALUATED) +
+               stats->GetCount(LossStatistics::FACADES_PRUNED);
+    };
+
+    // The counters are only updated while the statistics are collected
+    computeLosses();
+    NS_TEST_ASSERT_MSG_EQ(prunedWork(), 0, "Counters updated while the statistics are disabled");
+
+    model->SetAttribute("StatsEnabled", BooleanValue(true));
+    computeLosses();
+    uint64_t nlosLinks = stats->GetCount(LossStatistics::NLOS_LINKS);
+    uint64_t diffractionsPruned = stats->GetCount(LossStatistics::DIFFRACTIONS_PRUNED);
+    uint64_t reflectionsPruned = stats->GetCount(LossStatistics::REFLECTIONS_PRUNED);
+    NS_TEST_ASSERT_MSG_GT(nlosLinks, 0, "No NLOS link in the scenario");
+    NS_TEST_ASSERT_MSG_LT_OR_EQ(diffractionsPruned,
+                                nlosLinks,
+                                "More diffractions pruned than NLOS links");
+    NS_TEST_ASSERT_MSG_LT_OR_EQ(reflectionsPruned,
+                                nlosLinks,
+                                "More reflections pruned than NLOS links");
+    NS_TEST_ASSERT_MSG_GT(diffractionsPruned + reflectionsPruned,
+                          0,
+                          "No path pruned by its lower bound");
+    NS_TEST_ASSERT_MSG_GT(stats->GetCount(LossStatistics::REFLECTIONS_EVALUATED),
+                          0,
+                          "No reflection on a facade");
+    NS_TEST_ASSERT_MSG_GT(stats->GetCount(LossStatistics::FACADES_PRUNED),
+                          0,
+                          "No facade pruned by its lower bound");
+
+    stats->Reset();
+    NS_TEST_ASSERT_MSG_EQ(prunedWork(), 0, "Counters not cleared by the reset");
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the statistics of the loss computation add up, stay empty when disabled, and
+ * are written at Simulator::Destroy
+ *
+ */
+class FirstOrderBuildingsAwareStatisticsTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareStatisticsTestCase();
+
+  private:
+    /**
+     * Computes the losses of the links of nodes spread in and around a small city, with and
+     * without statistics
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareStatisticsTestCase::FirstOrderBuildingsAwareStatisticsTestCase()
+    : TestCase("Statistics of the loss computation")
+{
+}
+
+void
+FirstOrderBuildingsAwareStatisticsTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    CreateBlocks(4);
+
+    std::vector<Ptr<MobilityModel>> mobs = CreateNodes(SURROUNDING_NODES);
+
+    std::string path = CreateTempDirFilename("foba-stats.csv");
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    model->SetAttribute("StatsEnabled", BooleanValue(true));
+    model->SetAttribute("StatsFile", StringValue(path));
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> disabled =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+
+    uint64_t calls = 0;
+    for (const auto& rx : mobs)
+    {
+        for (const auto& tx : mobs)
+        {
+            if (rx != tx)
+            {
+                model->GetLoss(rx, tx);
+                disabled->GetLoss(rx, tx);
+                ++calls;
+            }
+        }
+    }
+
+    Ptr<LossStatistics> stats = model->GetStatistics();
+    uint64_t links = stats->GetCount(LossStatistics::LINKS);
+    uint64_t los = stats->GetCount(LossStatistics::LOS_LINKS);
+    uint64_t nlos = stats->GetCount(LossStatistics::NLOS_LINKS);
+    NS_TEST_ASSERT_MSG_EQ(stats->GetCount(LossStatistics::CALLS), calls, "Calls not counted");
+    NS_TEST_ASSERT_MSG_EQ(links, calls, "Links computed without the caches not counted");
+    NS_TEST_ASSERT_MSG_EQ(stats->GetCount(LossStatistics::FAR_LINKS) + los + nlos,
+                          links,
+                          "Links neither far, LOS nor NLOS");
+    NS_TEST_ASSERT_MSG_GT(los, 0, "No LOS link in the scenario");
+    NS_TEST_ASSERT_MSG_GT(nlos, 0, "No NLOS link in the scenario");
+    NS_TEST_ASSERT_MSG_GT(stats->GetCount(LossStatistics::BUILDINGS_TESTED),
+                          0,
+                          "No building tested");
+    NS_TEST_ASSERT_MSG_GT(stats->GetCount(LossStatistics::CORNERS_EVALUATED),
+                          0,
+                          "No corner evaluated");
+    NS_TEST_ASSERT_MSG_GT(stats->GetCount(LossStatistics::REFLECTIONS_EVALUATED),
+                          0,
+                          "No reflection evaluated");
+    NS_TEST_ASSERT_MSG_EQ(stats->GetPhaseCount(LossStatistics::LINK_PHASE),
+                          links,
+                          "Link phase not timed once per link");
+    NS_TEST_ASSERT_MSG_EQ(stats->GetPhaseCount(LossStatistics::BUILDING_SCAN_PHASE),
+                          los + nlos,
+                          "Building scan not timed once per LOS or NLOS link");
+    NS_TEST_ASSERT_MSG_EQ(stats->GetPhaseCount(LossStatistics::NOISE_PHASE),
+                          calls,
+                          "Noise not timed once per call");
+    NS_TEST_ASSERT_MSG_LT_OR_EQ(stats->GetPhaseQuantile(LossStatistics::LINK_PHASE, 0.5),
+                                stats->GetPhaseQuantile(LossStatistics::LINK_PHASE, 0.99),
+                                "Quantiles not ordered");
+
+    Ptr<LossStatistics> empty = disabled->GetStatistics();
+    for (uint32_t counter = 0; counter < LossStatistics::N_COUNTERS; ++counter)
+    {
+        NS_TEST_ASSERT_MSG_EQ(empty->GetCount(static_cast<LossStatistics::Counter>(counter)),
+                              0,
+                              "Disabled statistics counted "
+                                  << LossStatistics::GetCounterName(
+                                         static_cast<LossStatistics::Counter>(counter)));
+    }
+    for (uint32_t phase = 0; phase < LossStatistics::N_PHASES; ++phase)
+    {
+        NS_TEST_ASSERT_MSG_EQ(empty->GetPhaseCount(static_cast<LossStatistics::Phase>(phase)),
+                              0,
+                              "Disabled statistics timed "
+                                  << LossStatistics::GetPhaseName(
+                                         static_cast<LossStatistics::Phase>(phase)));
+    }
+
+    Simulator::Destroy();
+
+    std::ifstream file(path);
+    std::string line;
+    NS_TEST_ASSERT_MSG_EQ(file.is_open(), true, "Statistics not written at Simulator::Destroy");
+    std::getline(file, line);
+    NS_TEST_ASSERT_MSG_EQ(line, "counter,count", "Unexpected statistics header");
+    std::getline(file, line);
+    NS_TEST_ASSERT_MSG_EQ(line, "calls," + std::to_string(calls), "Unexpected calls line");
+    file.close();
+    std::remove(path.c_str());
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the terms given by the LossBreakdown trace source add up to the loss of the
+ * path they report, and that connecting a sink does not change the losses
+ *
+ */
+class FirstOrderBuildingsAwareLossBreakdownTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareLossBreakdownTestCase();
+
+  private:
+    /**
+     * Computes the losses of the links of nodes spread in and around a small city, with and
+     * without a sink connected
+     */
+    void DoRun() override;
+
+    /**
+     * Sink of the LossBreakdown trace source, keeps the last terms
+     *
+     * @param rx the mobility model of the destination
+     * @param tx the mobility model of the source
+     * @param breakdown the terms of the loss
+     */
+    void Breakdown(Ptr<const MobilityModel> rx,
+                   Ptr<const MobilityModel> tx,
+                   const FirstOrderBuildingsAwarePropagationLossModel::LossBreakdown& breakdown);
+
+    FirstOrderBuildingsAwarePropagationLossModel::LossBreakdown m_breakdown; ///< Last terms
+    uint32_t m_traced;                                                        ///< Traced calls
+};
+
+FirstOrderBuildingsAwareLossBreakdownTestCase::FirstOrderBuildingsAwareLossBreakdownTestCase()
+    : TestCase("LossBreakdown trace source gives the terms of the loss"),
+      m_traced(0)
+{
+}
+
+void
+FirstOrderBuildingsAwareLossBreakdownTestCase::Breakdown(
+    Ptr<const MobilityModel> rx,
+    Ptr<const MobilityModel> tx,
+    const FirstOrderBuildingsAwarePropagationLossModel::LossBreakdown& breakdown)
+{
+    m_breakdown = breakdown;
+    ++m_traced;
+}
+
+void
+FirstOrderBuildingsAwareLossBreakdownTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    using Model = FirstOrderBuildingsAwarePropagationLossModel;
+
+    CreateBlocks(4);
+
+    std::vector<Ptr<MobilityModel>> mobs = CreateNodes(SURROUNDING_NODES);
+
+    Ptr<Model> model = CreateObject<Model>();
+    model->SetAttribute("NoiseEnabled", BooleanValue(false));
+    model->TraceConnectWithoutContext(
+        "LossBreakdown",
+        MakeCallback(&FirstOrderBuildingsAwareLossBreakdownTestCase::Breakdown, this));
+    Ptr<Model> untraced = CreateObject<Model>();
+    untraced->SetAttribute("NoiseEnabled", BooleanValue(false));
+
+    std::map<Model::PathType, uint32_t> paths;
+    uint32_t calls = 0;
+    for (const auto& rx : mobs)
+    {
+        for (const auto& tx : mobs)
+        {
+            if (rx == tx)
+            {
+                continue;
+            }
+            double loss = model->GetLoss(rx, tx);
+            ++calls;
+            NS_TEST_ASSERT_MSG_EQ(m_traced, calls, "GetLoss not traced");
+            NS_TEST_ASSERT_MSG_EQ(loss, untraced->GetLoss(rx, tx), "Sink changed the loss");
+            NS_TEST_ASSERT_MSG_EQ(m_breakdown.loss, loss, "Traced loss is not the loss");
+            NS_TEST_ASSERT_MSG_EQ(m_breakdown.noise, 0.0, "Noise traced without noise");
+            ++paths[m_breakdown.path];
+
+            double expected = m_breakdown.ituLoss;
+            switch (m_breakdown.path)
+            {
+            case Model::PENETRATION_PATH:
+                expected = m_breakdown.ituLoss + m_breakdown.penetrationLoss;
+                break;
+            case Model::LOS_PATH:
+            case Model::DIFFRACTION_PATH:
+                expected = m_breakdown.ituLoss + m_breakdown.diffractionLoss;
+                break;
+            case Model::REFLECTION_PATH:
+                expected = m_breakdown.reflectionLoss;
+                NS_TEST_ASSERT_MSG_NE(m_breakdown.reflectionBuilding,
+                                      std::numeric_limits<uint32_t>::max(),
+                                      "No reflecting building");
+                break;
+            default:
+                break;
+            }
+            NS_TEST_ASSERT_MSG_EQ_TOL(loss,
+                                      expected,
+                                      1e-9,
+                                      "Terms do not add up from " << tx->GetPosition() << " to "
+                                                                  << rx->GetPosition());
+            if (m_breakdown.path == Model::DIFFRACTION_PATH)
+            {
+                NS_TEST_ASSERT_MSG_EQ(std::isnan(m_breakdown.diffractionAngle),
+                                      false,
+                                      "No angle for the diffracted path");
+            }
+        }
+    }
+    NS_TEST_ASSERT_MSG_GT(paths[Model::LOS_PATH], 0, "No LOS link in the scenario");
+    NS_TEST_ASSERT_MSG_GT(paths[Model::PENETRATION_PATH] + paths[Model::DIFFRACTION_PATH] +
+                              paths[Model::REFLECTION_PATH],
+                          0,
+                          "No NLOS link in the scenario");
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the lower bound stays below the loss, and that the culling only changes the
+ * links that cannot be received
+ *
+ */
+class FirstOrderBuildingsAwareCullingTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareCullingTestCase();
+
+  private:
+    /**
+     * Compares the bound, the loss and the received power of the links of nodes spread in and
+     * around a small city
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareCullingTestCase::FirstOrderBuildingsAwareCullingTestCase()
+    : TestCase("Loss lower bound and receiver sensitivity culling")
+{
+}
+
+void
+FirstOrderBuildingsAwareCullingTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    CreateBlocks(4);
+
+    std::vector<Ptr<MobilityModel>> mobs = CreateNodes(SURROUNDING_NODES);
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    model->SetAttribute("NoiseEnabled", BooleanValue(false));
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> culling =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    culling->SetAttribute("NoiseEnabled", BooleanValue(false));
+    culling->SetAttribute("Culling", BooleanValue(true));
+    culling->SetAttribute("RxSensitivity", DoubleValue(-70.0));
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> noisy =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    noisy->AssignStreams(1);
+    // Same noise stream, the culled calls must not shift the draws of the others
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> noisyCulling =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    noisyCulling->SetAttribute("Culling", BooleanValue(true));
+    noisyCulling->SetAttribute("RxSensitivity", DoubleValue(-70.0));
+    noisyCulling->AssignStreams(2);
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> noisyReference =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    noisyReference->AssignStreams(2);
+
+    const double txPower = 0.0;
+    uint32_t culled = 0;
+    uint32_t noisyCulled = 0;
+    for (const auto& rx : mobs)
+    {
+        for (const auto& tx : mobs)
+        {
+            if (rx == tx)
+            {
+                continue;
+            }
+            double loss = model->GetLoss(rx, tx);
+            NS_TEST_ASSERT_MSG_LT_OR_EQ(culling->GetLossLowerBound(rx, tx),
+                                        loss,
+                                        "Bound above the loss from " << tx->GetPosition() << " to "
+                                                                     << rx->GetPosition());
+            NS_TEST_ASSERT_MSG_LT_OR_EQ(noisy->GetLossLowerBound(rx, tx),
+                                        noisy->GetLoss(rx, tx),
+                                        "Bound above the noisy loss from " << tx->GetPosition());
+
+            double rxPower = culling->CalcRxPower(txPower, rx, tx);
+            if (txPower - loss >= -70.0)
+            {
+                NS_TEST_ASSERT_MSG_EQ(rxPower,
+                                      txPower - loss,
+                                      "Culled a received link from " << tx->GetPosition() << " to "
+                                                                     << rx->GetPosition());
+            }
+            else
+            {
+                NS_TEST_ASSERT_MSG_LT(rxPower, -70.0, "Culling made a link received");
+                culled += (rxPower != txPower - loss) ? 1 : 0;
+            }
+
+            double noisyPower = noisyCulling->CalcRxPower(txPower, rx, tx);
+            double referencePower = noisyReference->CalcRxPower(txPower, rx, tx);
+            if (txPower - noisyCulling->GetLossLowerBound(rx, tx) < -70.0)
+            {
+                NS_TEST_ASSERT_MSG_GT_OR_EQ(noisyPower,
+                                            referencePower,
+                                            "Culled power below the power of the link");
+                ++noisyCulled;
+            }
+            else
+            {
+                NS_TEST_ASSERT_MSG_EQ(noisyPower,
+                                      referencePower,
+                                      "Noise shifted by the culled links, from "
+                                          << tx->GetPosition() << " to " << rx->GetPosition());
+            }
+        }
+    }
+    NS_TEST_ASSERT_MSG_GT(culled, 0, "No link culled, the scenario does not test the culling");
+    NS_TEST_ASSERT_MSG_GT(noisyCulled, 0, "No noisy link culled");
+
+    // The interpolated losses are not bounded, the links of a radio map are never culled
+    Ptr<MobilityModel> fixed = mobs.front();
+    Ptr<ConstantVelocityMobilityModel> moving = CreateObject<ConstantVelocityMobilityModel>();
+    moving->SetVelocity(Vector(1.0, 0.0, 0.0));
+    moving->SetPosition(mobs.back()->GetPosition());
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> mapped =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    mapped->SetAttribute("NoiseEnabled", BooleanValue(false));
+    mapped->SetAttribute("RadioMap", BooleanValue(true));
+    mapped->SetAttribute("Culling", BooleanValue(true));
+    mapped->SetAttribute("RxSensitivity", DoubleValue(0.0));
+    NS_TEST_ASSERT_MSG_EQ(mapped->CalcRxPower(txPower, moving, fixed),
+                          txPower - mapped->GetLoss(moving, fixed),
+                          "Culled a link of a radio map");
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the all-pairs matrix, its link cache install and its export give the losses of
+ * the model
+ *
+ */
+class FirstOrderBuildingsAwareLossMatrixTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareLossMatrixTestCase();
+
+  private:
+    /**
+     * Evaluates all the pairs of nodes spread in a small city, by tiles and one by one
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareLossMatrixTestCase::FirstOrderBuildingsAwareLossMatrixTestCase()
+    : TestCase("All-pairs matrix gives the same loss as GetDeterministicLoss for each pair")
+{
+}
+
+void
+FirstOrderBuildingsAwareLossMatrixTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    CreateBlocks(3);
+
+    NodeContainer nodes;
+    nodes.Create(13);
+    for (uint32_t k = 0; k < nodes.GetN(); ++k)
+    {
+        Ptr<MobilityModel> mob = CreateObject<ConstantPositionMobilityModel>();
+        mob->SetPosition(Vector(-10.0 + 13.0 * k, (k % 4) * 45.0 - 5.0, 1.5 + (k % 3)));
+        nodes.Get(k)->AggregateObject(mob);
+    }
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    model->SetNoiseEnabled(false);
+    model->SetZoneCacheEnabled(true);
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> single =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    single->SetAttribute("ZoneCache", BooleanValue(false));
+
+    // Tiles not dividing the nodes, and more threads than the model has
+    FobaLossMatrixHelper helper;
+    helper.SetThreadCount(3);
+    helper.SetTileSize(5);
+    std::vector<double> losses = helper.Compute(model, nodes);
+    NS_TEST_ASSERT_MSG_EQ(model->GetThreadCount(), 1, "The threads of the model were not restored");
+    helper.Install(model, nodes);
+    const uint32_t n = nodes.GetN();
+    NS_TEST_ASSERT_MSG_EQ(model->GetLinkCache()->GetNEntries(),
+                          n * (n - 1) / 2,
+                          "All the links should be in the cache");
+    Ptr<MatrixPropagationLossModel> matrix = helper.CreateMatrixModel(model, nodes);
+
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        Ptr<MobilityModel> a = nodes.Get(i)->GetObject<MobilityModel>();
+        for (uint32_t j = 0; j < n; ++j)
+        {
+            if (i == j)
+            {
+                NS_TEST_ASSERT_MSG_EQ(losses[i * n + j], 0.0, "Loss of a node to itself");
+                continue;
+            }
+            Ptr<MobilityModel> b = nodes.Get(j)->GetObject<MobilityModel>();
+            double loss = single->GetDeterministicLoss(a, b);
+            NS_TEST_ASSERT_MSG_EQ(losses[i * n + j],
+                                  loss,
+                                  "Matrix changed the loss from " << j << " to " << i);
+            NS_TEST_ASSERT_MSG_EQ(model->GetLoss(a, b), loss, "Install changed the loss");
+            NS_TEST_ASSERT_MSG_EQ(matrix->CalcRxPower(0.0, a, b), -loss, "Export changed the loss");
+        }
+    }
+    NS_TEST_ASSERT_MSG_EQ(model->GetLinkCache()->GetMisses(), 0, "Installed links were computed");
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that a loss file serves the losses it was written with, and is rejected once the
+ * scenario changed
+ *
+ */
+class FirstOrderBuildingsAwareLossFileTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareLossFileTestCase();
+
+  private:
+    /**
+     * Writes the losses of nodes spread in a small city, serves them, then changes the scenario
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareLossFileTestCase::FirstOrderBuildingsAwareLossFileTestCase()
+    : TestCase("Loss file gives the losses of the model, and is rejected for another scenario")
+{
+}
+
+void
+FirstOrderBuildingsAwareLossFileTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        Ptr<Building> b = CreateObject<Building>();
+        b->SetBoundaries(Box(i * 60.0, i * 60.0 + 30.0, 0.0, 30.0, 0.0, 12.0));
+    }
+
+    NodeContainer nodes;
+    nodes.Create(6);
+    for (uint32_t k = 0; k < nodes.GetN(); ++k)
+    {
+        Ptr<MobilityModel> mob = CreateObject<ConstantPositionMobilityModel>();
+        mob->SetPosition(Vector(-10.0 + 23.0 * k, (k % 2) * 50.0 - 10.0, 1.5));
+        nodes.Get(k)->AggregateObject(mob);
+    }
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> reference =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    std::string path = CreateTempDirFilename("foba-losses.bin");
+    FobaLossMatrixHelper helper;
+    helper.WriteFile(path, reference, nodes);
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> served =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    served->SetAttribute("LossFile", StringValue(path));
+    served->SetAttribute("NoiseEnabled", BooleanValue(false));
+    for (uint32_t i = 0; i < nodes.GetN(); ++i)
+    {
+        Ptr<MobilityModel> a = nodes.Get(i)->GetObject<MobilityModel>();
+        for (uint32_t j = 0; j < nodes.GetN(); ++j)
+        {
+            Ptr<MobilityModel> b = nodes.Get(j)->GetObject<MobilityModel>();
+            if (i != j)
+            {
+                NS_TEST_ASSERT_MSG_EQ_TOL(served->GetLoss(a, b),
+                                          reference->GetDeterministicLoss(a, b),
+                                          0.005,
+                                          "File changed the loss from " << j << " to " << i);
+            }
+        }
+    }
+
+    // A node that moved is computed again
+    Ptr<MobilityModel> moved = nodes.Get(0)->GetObject<MobilityModel>();
+    Ptr<MobilityModel> other = nodes.Get(3)->GetObject<MobilityModel>();
+    moved->SetPosition(Vector(45.0, -5.0, 1.5));
+    NS_TEST_ASSERT_MSG_EQ(served->GetLoss(moved, other),
+                          reference->GetDeterministicLoss(moved, other),
+                          "A moved node was served from the file");
+
+    Ptr<LossMatrixFile> file = CreateObject<LossMatrixFile>();
+    NS_TEST_ASSERT_MSG_EQ(file->Open(path), true, "Cannot read the loss file");
+    double frequency = reference->GetFrequency();
+    double gain = reference->GetGain();
+    uint32_t exact = FirstOrderBuildingsAwarePropagationLossModel::EXACT_DIFFRACTION;
+    std::string reason;
+    NS_TEST_ASSERT_MSG_EQ(file->Check(frequency, gain, exact, reason), false, "The node moved");
+    moved->SetPosition(Vector(-10.0, -10.0, 1.5));
+    NS_TEST_ASSERT_MSG_EQ(file->Check(frequency, gain, exact, reason), true, reason);
+    NS_TEST_ASSERT_MSG_EQ(file->Check(5e9, gain, exact, reason), false, "The frequency changed");
+    NS_TEST_ASSERT_MSG_EQ(
+        file->Check(frequency,
+                    gain,
+                    FirstOrderBuildingsAwarePropagationLossModel::TABLE_DIFFRACTION,
+                    reason),
+        false,
+        "The diffraction mode changed");
+
+    // The losses that are not finite are written, but not served
+    file->Close();
+    std::vector<double> losses(nodes.GetN() * nodes.GetN(), 100.0);
+    losses[1] = std::numeric_limits<double>::quiet_NaN();
+    losses[2] = std::numeric_limits<double>::infinity();
+    LossMatrixFile::Write(path, nodes, losses, frequency, gain, exact);
+    NS_TEST_ASSERT_MSG_EQ(file->Open(path), true, "Cannot read the loss file");
+    NS_TEST_ASSERT_MSG_EQ(file->Check(frequency, gain, exact, reason), true, reason);
+    Ptr<MobilityModel> first = nodes.Get(0)->GetObject<MobilityModel>();
+    double loss = 0.0;
+    NS_TEST_ASSERT_MSG_EQ(file->Lookup(first, nodes.Get(1)->GetObject<MobilityModel>(), loss),
+                          false,
+                          "A NaN loss was served");
+    NS_TEST_ASSERT_MSG_EQ(file->Lookup(first, nodes.Get(2)->GetObject<MobilityModel>(), loss),
+                          false,
+                          "An infinite loss was served");
+    NS_TEST_ASSERT_MSG_EQ(file->Lookup(first, nodes.Get(3)->GetObject<MobilityModel>(), loss),
+                          true,
+                          "A finite loss was not served");
+    NS_TEST_ASSERT_MSG_EQ_TOL(loss, 100.0, 0.005, "Wrong finite loss");
+
+    Ptr<Building> added = CreateObject<Building>();
+    added->SetBoundaries(Box(200.0, 220.0, 0.0, 20.0, 0.0, 10.0));
+    NS_TEST_ASSERT_MSG_EQ(file->Check(frequency, gain, exact, reason),
+                          false,
+                          "The buildings changed");
+    file->Close();
+    std::remove(path.c_str());
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the radio map of a fixed node interpolates the losses to the moving nodes
+ * within the tolerance, and is dropped when the fixed node moves
+ *
+ */
+class FirstOrderBuildingsAwareRadioMapTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareRadioMapTestCase();
+
+  private:
+    /**
+     * Evaluates a fixed source against moving destinations spread in a small city
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareRadioMapTestCase::FirstOrderBuildingsAwareRadioMapTestCase()
+    : TestCase("Radio map interpolates the losses of a fixed node within the tolerance")
+{
+}
+
+void
+FirstOrderBuildingsAwareRadioMapTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    CreateBlocks(3);
+
+    Ptr<MobilityModel> ap = CreateObject<ConstantPositionMobilityModel>();
+    ap->SetPosition(Vector(40.0, 40.0, 6.0));
+    Ptr<ConstantVelocityMobilityModel> client = CreateObject<ConstantVelocityMobilityModel>();
+    client->SetVelocity(Vector(1.0, 0.0, 0.0));
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> mapped =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    mapped->SetAttribute("RadioMap", BooleanValue(true));
+    mapped->SetAttribute("RadioMapResolution", DoubleValue(1.0));
+    mapped->SetAttribute("RadioMapTolerance", DoubleValue(0.5));
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> exact =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+
+    for (double x = -20.3; x < 140.0; x += 3.7)
+    {
+        for (double y : {-10.6, 40.2, 90.9, 135.5})
+        {
+            client->SetPosition(Vector(x, y, 1.5));
+            double loss = mapped->GetDeterministicLoss(client, ap);
+            NS_TEST_ASSERT_MSG_EQ_TOL(loss,
+                                      exact->GetDeterministicLoss(client, ap),
+                                      0.5,
+                                      "Wrong interpolation at " << client->GetPosition());
+            NS_TEST_ASSERT_MSG_EQ_TOL(mapped->GetDeterministicLoss(ap, client),
+                                      exact->GetDeterministicLoss(ap, client),
+                                      0.5,
+                                      "Wrong interpolation at " << client->GetPosition());
+        }
+    }
+    Ptr<RadioMapCache> maps = mapped->GetRadioMaps();
+    NS_TEST_ASSERT_MSG_GT(maps->GetInterpolated(), 0, "No loss was interpolated");
+    NS_TEST_ASSERT_MSG_GT(maps->GetRejected(), 0, "The edges of the shadows were interpolated");
+
+    // The heights between two layers are interpolated from both, and share their vertices
+    uint64_t interpolated = maps->GetInterpolated();
+    uint64_t vertices = maps->GetNVertices();
+    for (double z : {1.6, 1.7, 1.9})
+    {
+        client->SetPosition(Vector(120.3, 40.2, z));
+        NS_TEST_ASSERT_MSG_EQ_TOL(mapped->GetDeterministicLoss(client, ap),
+                                  exact->GetDeterministicLoss(client, ap),
+                                  0.5,
+                                  "Wrong interpolation at " << client->GetPosition());
+    }
+    NS_TEST_ASSERT_MSG_EQ(maps->GetInterpolated(),
+                          interpolated + 3,
+                          "The heights between two layers were not interpolated");
+    NS_TEST_ASSERT_MSG_LT_OR_EQ(maps->GetNVertices(),
+                                vertices + 8,
+                                "A layer was created for each height");
+
+    // Below the first layer the losses are computed exactly
+    client->SetPosition(Vector(120.3, 40.2, 0.3));
+    NS_TEST_ASSERT_MSG_EQ_TOL(mapped->GetDeterministicLoss(client, ap),
+                              exact->GetDeterministicLoss(client, ap),
+                              1e-9,
+                              "A height below the first layer was interpolated");
+
+    // The maps are dropped once they hold more vertices than the cap
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> capped =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    capped->SetAttribute("RadioMap", BooleanValue(true));
+    capped->SetAttribute("RadioMapResolution", DoubleValue(1.0));
+    capped->SetAttribute("RadioMapMaxVertices", UintegerValue(20));
+    for (double x = -20.3; x < 140.0; x += 3.7)
+    {
+        client->SetPosition(Vector(x, -10.6, 1.5));
+        capped->GetDeterministicLoss(client, ap);
+        NS_TEST_ASSERT_MSG_LT_OR_EQ(capped->GetRadioMaps()->GetNVertices(),
+                                    20,
+                                    "The radio maps grew past the cap");
+    }
+
+    // The map is built again around the new position of the fixed node
+    ap->SetPosition(Vector(90.0, 40.0, 6.0));
+    NS_TEST_ASSERT_MSG_EQ(maps->GetNVertices(), 0, "The map of the node was kept");
+    client->SetPosition(Vector(120.0, 37.0, 1.5));
+    NS_TEST_ASSERT_MSG_EQ_TOL(mapped->GetDeterministicLoss(client, ap),
+                              exact->GetDeterministicLoss(client, ap),
+                              1e-9,
+                              "The map of the former position was used");
+
+    // A moving node in a pause does not get a map
+    Ptr<ConstantVelocityMobilityModel> paused = CreateObject<ConstantVelocityMobilityModel>();
+    paused->SetPosition(Vector(70.0, 40.0, 6.0));
+    uint64_t pausedVertices = maps->GetNVertices();
+    uint64_t pausedInterpolated = maps->GetInterpolated();
+    NS_TEST_ASSERT_MSG_EQ_TOL(mapped->GetDeterministicLoss(client, paused),
+                              exact->GetDeterministicLoss(client, paused),
+                              1e-9,
+                              "The link of a paused node was interpolated");
+    NS_TEST_ASSERT_MSG_EQ(maps->GetNVertices(), pausedVertices, "A paused node got a map");
+    NS_TEST_ASSERT_MSG_EQ(maps->GetInterpolated(),
+                          pausedInterpolated,
+                          "A paused node got a map");
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the radio environment map gives the loss of the model at each point, in both
+ * formats
+ *
+ */
+class FirstOrderBuildingsAwareRemTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareRemTestCase();
+
+  private:
+    /**
+     * Writes the map of a source in a small city, and reads it back
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareRemTestCase::FirstOrderBuildingsAwareRemTestCase()
+    : TestCase("Radio environment map gives the loss of the model at each point")
+{
+}
+
+void
+FirstOrderBuildingsAwareRemTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        Ptr<Building> b = CreateObject<Building>();
+        b->SetBoundaries(Box(i * 50.0, i * 50.0 + 30.0, 10.0, 40.0, 0.0, 12.0));
+    }
+    Ptr<MobilityModel> tx = CreateObject<ConstantPositionMobilityModel>();
+    tx->SetPosition(Vector(40.0, 0.0, 6.0));
+    Ptr<MobilityModel> point = CreateObject<ConstantPositionMobilityModel>();
+
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> model =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+    Ptr<FirstOrderBuildingsAwarePropagationLossModel> exact =
+        CreateObject<FirstOrderBuildingsAwarePropagationLossModel>();
+
+    // Tiles not dividing the rows nor the columns
+    FobaRemHelper rem;
+    rem.SetArea(-10.0, 90.0, 5.0, 65.0);
+    rem.SetResolution(5.0);
+    rem.SetHeight(1.5);
+    rem.SetThreadCount(2);
+    rem.SetTileSize(3);
+    std::string csvPath = CreateTempDirFilename("foba-rem.csv");
+    rem.Generate(model, tx, csvPath);
+    rem.SetOutputFormat(FobaRemHelper::BINARY);
+    std::string binaryPath = CreateTempDirFilename("foba-rem.bin");
+    rem.Generate(model, tx, binaryPath);
+
+    std::ifstream csv(csvPath);
+    std::string line;
+    std::getline(csv, line);
+    NS_TEST_ASSERT_MSG_EQ(line, "x,y,loss", "Wrong CSV header");
+    uint32_t points = 0;
+    while (std::getline(csv, line))
+    {
+        std::istringstream fields(line);
+        double x;
+        double y;
+        double loss;
+        char comma;
+        fields >> x >> comma >> y >> comma >> loss;
+        NS_TEST_ASSERT_MSG_EQ(x, -10.0 + (points % 21) * 5.0, "Points out of order");
+        NS_TEST_ASSERT_MSG_EQ(y, 5.0 + (points / 21) * 5.0, "Points out of order");
+        point->SetPosition(Vector(x, y, 1.5));
+        NS_TEST_ASSERT_MSG_EQ_TOL(loss,
+                                  exact->GetDeterministicLoss(point, tx),
+                                  1e-3,
+                                  "Wrong loss at " << point->GetPosition());
+        ++points;
+    }
+    NS_TEST_ASSERT_MSG_EQ(points, 21 * 13, "Wrong number of points");
+
+    std::ifstream binary(binaryPath, std::ios::binary);
+    binary.seekg(0, std::ios::end);
+    NS_TEST_ASSERT_MSG_EQ(binary.tellg(), 56 + 21 * 13 * 4, "Wrong size of the binary map");
+    binary.seekg(56 + (2 * 21 + 7) * 4);
+    float loss;
+    binary.read(reinterpret_cast<char*>(&loss), sizeof(loss));
+    point->SetPosition(Vector(25.0, 15.0, 1.5));
+    NS_TEST_ASSERT_MSG_EQ_TOL(loss,
+                              exact->GetDeterministicLoss(point, tx),
+                              1e-3,
+                              "Wrong loss in the binary map");
+    std::remove(csvPath.c_str());
+    std::remove(binaryPath.c_str());
+
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check the segment-box intersection test, and that its vectorized version agrees with it
+ *
+ */
+class FirstOrderBuildingsAwareSegmentBoxTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareSegmentBoxTestCase();
+
+  private:
+    /**
+     * Tests segments crossing, touching and missing a box
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareSegmentBoxTestCase::FirstOrderBuildingsAwareSegmentBoxTestCase()
+    : TestCase("Segment-box intersection test")
+{
+}
+
+void
+FirstOrderBuildingsAwareSegmentBoxTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    Box box(0.0, 10.0, 0.0, 10.0, 0.0, 5.0);
+    struct Case
+    {
+        Vector a;       ///< first end of the segment
+        Vector b;       ///< second end of the segment
+        bool intersect; ///< expected result
+    };
+
+    std::vector<Case> cases = {
+        {Vector(-5.0, 5.0, 1.0), Vector(15.0, 5.0, 1.0), true},    // through
+        {Vector(0.0, -5.0, 1.0), Vector(0.0, 15.0, 1.0), true},    // along a wall
+        {Vector(-5.0, 5.0, 1.0), Vector(5.0, 15.0, 1.0), true},    // through a corner
+        {Vector(-1.0, -5.0, 1.0), Vector(-1.0, 15.0, 1.0), false}, // along a wall, outside
+        {Vector(-5.0, 5.0, 6.0), Vector(15.0, 5.0, 6.0), false},   // over the roof
+        {Vector(-5.0, 5.0, 6.0), Vector(15.0, 5.0, 2.0), true},    // down through the roof
+        {Vector(-5.0, 5.0, 1.0), Vector(-1.0, 5.0, 1.0), false},   // stops before the wall
+        {Vector(5.0, 5.0, 1.0), Vector(5.0, 5.0, 1.0), true},      // single point inside
+        {Vector(5.0, 5.0, 6.0), Vector(5.0, 5.0, 6.0), false},     // single point outside
+    };
+
+    // Enough copies of the box for full vector blocks and a remainder
+    const uint32_t n = 11;
+    std::vector<double> xMin(n, box.xMin);
+    std::vector<double> xMax(n, box.xMax);
+    std::vector<double> yMin(n, box.yMin);
+    std::vector<double> yMax(n, box.yMax);
+    std::vector<double> zMin(n, box.zMin);
+    std::vector<double> zMax(n, box.zMax);
+    BoxArrays boxes{xMin.data(), xMax.data(), yMin.data(), yMax.data(), zMin.data(), zMax.data()};
+
+    for (const auto& c : cases)
+    {
+        NS_TEST_ASSERT_MSG_EQ(SegmentIntersectsBox(c.a, c.b, box),
+                              c.intersect,
+                              "Wrong intersection of " << c.a << " - " << c.b);
+
+        std::vector<uint32_t> out(n);
+        uint32_t count = FilterSegmentIntersections(c.a, c.b, boxes, nullptr, n, out.data());
+        NS_TEST_ASSERT_MSG_EQ(count,
+                              (c.intersect ? n : 0),
+                              "Wrong number of boxes for " << c.a << " - " << c.b);
+
+        std::vector<uint32_t> slots = {10, 3, 7, 0, 9};
+        count = FilterSegmentIntersections(c.a, c.b, boxes, slots.data(), 5, slots.data());
+        NS_TEST_ASSERT_MSG_EQ(count,
+                              (c.intersect ? 5 : 0),
+                              "Wrong number of indexed boxes for " << c.a << " - " << c.b);
+        if (c.intersect)
+        {
+            NS_TEST_ASSERT_MSG_EQ(slots[0], 10, "The order of the boxes was not kept");
+            NS_TEST_ASSERT_MSG_EQ(slots[4], 9, "The order of the boxes was not kept");
+        }
+    }
+}
+
+/**
+ * @ingroup propagation-tests
+ *
+ * @brief Check that the generated cities are reproducible, and their nodes in the streets
+ *
+ */
+class FirstOrderBuildingsAwareScenarioTestCase : public TestCase
+{
+  public:
+    /**
+     * Constructor
+     */
+    FirstOrderBuildingsAwareScenarioTestCase();
+
+  private:
+    /**
+     * Generates each layout twice from the same seed
+     */
+    void DoRun() override;
+};
+
+FirstOrderBuildingsAwareScenarioTestCase::FirstOrderBuildingsAwareScenarioTestCase()
+    : TestCase("Generated cities are reproducible and their nodes outdoor")
+{
+}
+
+void
+FirstOrderBuildingsAwareScenarioTestCase::DoRun()
+{
+    NS_LOG_FUNCTION(this);
+
+    const uint32_t nBuildings = 30;
+    const uint32_t nNodes = 200;
+    for (auto layout : {FobaScenarioHelper::MANHATTAN,
+                        FobaScenarioHelper::RANDOM_FOOTPRINT,
+                        FobaScenarioHelper::MIXED_HEIGHT,
+                        FobaScenarioHelper::STREET_CANYON})
+    {
+        FobaScenarioHelper scenario;
+        scenario.SetLayout(layout);
+        scenario.SetSeed(7);
+        std::vector<Ptr<Building>> buildings = scenario.CreateBuildings(nBuildings);
+        std::vector<Vector> nodes = scenario.GetNodePositions(nNodes);
+        NS_TEST_ASSERT_MSG_EQ(buildings.size(), nBuildings, "Wrong number of buildings");
+        NS_TEST_ASSERT_MSG_EQ(BuildingList::GetNBuildings(),
+                              nBuildings,
+                              "The buildings are not in the BuildingList");
+        NS_TEST_ASSERT_MSG_EQ(nodes.size(), nNodes, "Wrong number of nodes");
+
+        Box area = scenario.GetArea();
+        for (uint32_t i = 0; i < nBuildings; ++i)
+        {
+            Box a = buildings[i]->GetBoundaries();
+            NS_TEST_ASSERT_MSG_EQ((a.xMin >= area.xMin) && (a.xMax <= area.xMax) &&
+                                      (a.yMin >= area.yMin) && (a.yMax <= area.yMax),
+                                  true,
+                                  "Building " << i << " out of the area");
+            for (uint32_t j = i + 1; j < nBuildings; ++j)
+            {
+                Box b = buildings[j]->GetBoundaries();
+                bool apart = (a.xMax < b.xMin) || (b.xMax < a.xMin) || (a.yMax < b.yMin) ||
+                             (b.yMax < a.yMin);
+                NS_TEST_ASSERT_MSG_EQ(apart, true, "Buildings " << i << " and " << j << " overlap");
+            }
+        }
+        for (const auto& node : nodes)
+        {
+            NS_TEST_ASSERT_MSG_EQ(area.IsInside(node), true, "Node " << node << " out of the area");
+            for (const auto& building : buildings)
+            {
+                Box box = building->GetBoundaries();
+                bool inside = (node.x >= box.xMin) && (node.x <= box.xMax) &&
+                              (node.y >= box.yMin) && (node.y <= box.yMax);
+                NS_TEST_ASSERT_MSG_EQ(inside, false, "Node " << node << " in a building");
+            }
+        }
+
+        // The same seed gives the same city and nodes
+        Simulator::Destroy();
+        std::vector<Ptr<Building>> again = scenario.CreateBuildings(nBuildings);
+        std::vector<Vector> nodesAgain = scenario.GetNodePositions(nNodes);
+        for (uint32_t i = 0; i < nBuildings; ++i)
+        {
+            Box a = buildings[i]->GetBoundaries();
+            Box b = again[i]->GetBoundaries();
+            NS_TEST_ASSERT_MSG_EQ((a.xMin == b.xMin) && (a.xMax == b.xMax) &&
+                                      (a.yMin == b.yMin) && (a.yMax == b.yMax) &&
+                                      (a.zMax == b.zMax),
+                                  true,
+                                  "Building " << i << " differs with the same seed");
+        }
+        for (uint32_t i = 0; i < nNodes; ++i)
+        {
+            NS_TEST_ASSERT_MSG_EQ(nodes[i], nodesAgain[i], "Node " << i << " differs");
+        }
+        Simulator::Destroy();
+    }
+}
+
 /**
  * @ingroup propagation-tests
  *
@@ -178,6 +2443,26 @@ FirstOrderBuildingsAwarePropagationLossModelTestSuite::
 
     AddTestCase(new FirstOrderBuildingsAwarePropagationLossModelTestCase,
                 TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareSpatialIndexTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareCitySnapshotTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareLinkCacheTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareLossBatchTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareReentrancyTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareCullingTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwarePhiloxNoiseTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareItuR1411TestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareDiffractionTableTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareDiffractionCorridorTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareReflectionTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwarePruningTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareStatisticsTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareLossBreakdownTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareLossMatrixTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareLossFileTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareRadioMapTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareRemTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareSegmentBoxTestCase, TestCase::QUICK);
+    AddTestCase(new FirstOrderBuildingsAwareScenarioTestCase, TestCase::QUICK);
 }
 
 /// Static variable for test initialization